@@ -0,0 +1,41 @@
+// A translation unit to measure the compile time of `Permutations` with a
+// large value pack. `bench/compile_time_bench.sh` compiles it for several
+// shapes.
+//
+// - KOMOPERM_BENCH_N: The number of values
+// - KOMOPERM_BENCH_K: The number of unique values. The i-th value is `i % K`.
+#include <cstddef>
+#include <utility>
+
+#include "komoperm/komoperm.hpp"
+
+#ifndef KOMOPERM_BENCH_N
+#define KOMOPERM_BENCH_N 64
+#endif  // KOMOPERM_BENCH_N
+
+#ifndef KOMOPERM_BENCH_K
+#define KOMOPERM_BENCH_K 2
+#endif  // KOMOPERM_BENCH_K
+
+namespace {
+template <typename S>
+struct MakeBenchPermutations;
+
+template <std::size_t... Is>
+struct MakeBenchPermutations<std::index_sequence<Is...>> {
+  using type = komoperm::PermutationsWithIndex<unsigned __int128, std::size_t,
+                                               (Is % KOMOPERM_BENCH_K)...>;
+};
+
+using BenchPermutations = typename MakeBenchPermutations<
+    std::make_index_sequence<KOMOPERM_BENCH_N>>::type;
+
+constexpr BenchPermutations kPerms;
+
+// Evaluate `Get()` and `Index()` at compile time as well.
+static_assert(kPerms.Index(kPerms.Get(kPerms.Size() - 1)) ==
+                  kPerms.Size() - 1,
+              "");
+}  // namespace
+
+int main() { return 0; }
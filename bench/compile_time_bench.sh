@@ -0,0 +1,31 @@
+#!/bin/bash
+# Measure the compile time of `bench/compile_time_bench.cpp` for several shapes.
+#
+# usage: bench/compile_time_bench.sh [N:K ...]
+#
+# The compiler and the flags can be changed by $CXX and $CXXFLAGS.
+set -eu
+
+cd "$(dirname "$0")/.."
+
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:--std=c++17}
+SHAPES=${*:-"40:2 64:2 80:2 128:2 40:4 50:5 72:3 30:30"}
+
+# `komoperm/komoperm.hpp` is resolved in the same way as `//:komoperm_lib`.
+INCLUDE_DIR=$(mktemp -d)
+trap 'rm -rf "${INCLUDE_DIR}"' EXIT
+ln -s "$(pwd)/src" "${INCLUDE_DIR}/komoperm"
+
+printf "%-8s %-8s %s\n" "N" "K" "time[ms]"
+for shape in ${SHAPES}; do
+  n=${shape%:*}
+  k=${shape#*:}
+  start=$(date +%s%N)
+  # shellcheck disable=SC2086
+  ${CXX} ${CXXFLAGS} -fsyntax-only -I"${INCLUDE_DIR}" \
+    -DKOMOPERM_BENCH_N="${n}" -DKOMOPERM_BENCH_K="${k}" \
+    bench/compile_time_bench.cpp
+  end=$(date +%s%N)
+  printf "%-8s %-8s %d\n" "${n}" "${k}" $(((end - start) / 1000000))
+done
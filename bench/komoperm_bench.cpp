@@ -0,0 +1,560 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+#include "komoperm/dynamic.hpp"
+#include "komoperm/komoperm.hpp"
+#include "komoperm/product.hpp"
+#include "komoperm/tabulated.hpp"
+
+using namespace komoperm;
+
+namespace {
+/// The number of random inputs used in each benchmark
+constexpr std::size_t kNumInputs = 1024;
+/// The number of steps in each sequential sweep
+constexpr std::size_t kNumSteps = 1 << 16;
+
+// N = 16, K = 4: Each value appears 4 times.
+using ManyDuplicates = Permutations<int, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3,
+                                    3, 3, 3>;
+// N = 12, K = 12
+using AllDistinct = Permutations<int, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11>;
+// N = 32, K = 3
+using LargeN =
+    Permutations<int, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+                 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2>;
+// N = 20, K = 20
+using LargeK = Permutations<int, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13,
+                            14, 15, 16, 17, 18, 19>;
+
+// N = 10, K = 4: Size() = 25200 fits in `TabulatedPermutations`.
+using Small = Permutations<int, 0, 0, 0, 1, 1, 1, 2, 2, 3, 3>;
+using SmallTabulated =
+    TabulatedPermutations<int, 0, 0, 0, 1, 1, 1, 2, 2, 3, 3>;
+
+// N = 32, K = 4: The blank (0) appears last but fills most of the slots.
+using Blanks = Permutations<int, 1, 1, 1, 2, 2, 2, 3, 3, 0, 0, 0, 0, 0, 0, 0, 0,
+                            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0>;
+using BlanksDescending = PermutationsWithOrder<
+    ItemOrder::kDescendingCount, std::size_t, int, 1, 1, 1, 2, 2, 2, 3, 3, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0>;
+
+// N = 16 x 6 x 2: A board, pieces in hand and the side to move
+using StateBoard = Permutations<int, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 2, 2, 3,
+                                3, 4>;
+using StateHand = Permutations<int, 0, 0, 0, 1, 1, 2>;
+using StateTurn = Permutations<int, 0, 1>;
+using State = ProductPermutations<StateBoard, StateHand, StateTurn>;
+
+template <typename Perms>
+std::vector<std::size_t> RandomIndices(const Perms& perms) {
+  std::mt19937_64 mt(0x6b6f6d6f);
+  std::uniform_int_distribution<std::size_t> dist(0, perms.Size() - 1);
+  std::vector<std::size_t> ret(kNumInputs);
+  for (auto& x : ret) {
+    x = dist(mt);
+  }
+  return ret;
+}
+
+template <typename Perms>
+void BM_Get(benchmark::State& state) {
+  constexpr Perms kPerms;
+  const auto indices = RandomIndices(kPerms);
+  for (auto _ : state) {
+    for (auto index : indices) {
+      benchmark::DoNotOptimize(kPerms.Get(index));
+    }
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() *
+                                                    indices.size()));
+}
+
+template <typename Perms>
+void BM_GetInto(benchmark::State& state) {
+  constexpr Perms kPerms;
+  const auto indices = RandomIndices(kPerms);
+  using T = std::decay_t<decltype(kPerms.Get(0)[0])>;
+  std::vector<T> out(kPerms.Spaces());
+  for (auto _ : state) {
+    for (auto index : indices) {
+      kPerms.GetInto(index, out.data());
+      benchmark::DoNotOptimize(out.data());
+      benchmark::ClobberMemory();
+    }
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() *
+                                                    indices.size()));
+}
+
+template <typename Perms>
+void BM_Index(benchmark::State& state) {
+  constexpr Perms kPerms;
+  const auto indices = RandomIndices(kPerms);
+  std::vector<decltype(kPerms.Get(0))> perms;
+  for (auto index : indices) {
+    perms.push_back(kPerms.Get(index));
+  }
+
+  for (auto _ : state) {
+    for (const auto& perm : perms) {
+      benchmark::DoNotOptimize(kPerms.Index(perm));
+    }
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() *
+                                                    perms.size()));
+}
+
+template <typename Perms>
+void BM_IndexRange(benchmark::State& state) {
+  constexpr Perms kPerms;
+  const auto indices = RandomIndices(kPerms);
+  std::vector<decltype(kPerms.Get(0))> perms;
+  for (auto index : indices) {
+    perms.push_back(kPerms.Get(index));
+  }
+
+  for (auto _ : state) {
+    for (const auto& perm : perms) {
+      benchmark::DoNotOptimize(kPerms.Index(perm.begin(), perm.end()));
+    }
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() *
+                                                    perms.size()));
+}
+
+void BM_ProductGet(benchmark::State& state) {
+  constexpr State kState;
+  const auto indices = RandomIndices(kState);
+  for (auto _ : state) {
+    for (auto index : indices) {
+      benchmark::DoNotOptimize(kState.Get(index));
+    }
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() *
+                                                    indices.size()));
+}
+
+// The hand-written mixed radix arithmetic which `ProductPermutations` replaces
+void BM_ProductGetByComponents(benchmark::State& state) {
+  constexpr StateBoard kBoard;
+  constexpr StateHand kHand;
+  constexpr StateTurn kTurn;
+  const auto indices = RandomIndices(State{});
+  for (auto _ : state) {
+    for (auto index : indices) {
+      benchmark::DoNotOptimize(kBoard.Get(index % kBoard.Size()));
+      index /= kBoard.Size();
+      benchmark::DoNotOptimize(kHand.Get(index % kHand.Size()));
+      index /= kHand.Size();
+      benchmark::DoNotOptimize(kTurn.Get(index));
+    }
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() *
+                                                    indices.size()));
+}
+
+template <typename Perms>
+void BM_IndexUnchecked(benchmark::State& state) {
+  constexpr Perms kPerms;
+  const auto indices = RandomIndices(kPerms);
+  std::vector<decltype(kPerms.Get(0))> perms;
+  for (auto index : indices) {
+    perms.push_back(kPerms.Get(index));
+  }
+
+  for (auto _ : state) {
+    for (const auto& perm : perms) {
+      benchmark::DoNotOptimize(kPerms.IndexUnchecked(perm));
+    }
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() *
+                                                    perms.size()));
+}
+
+template <typename Perms>
+void BM_GetBatch(benchmark::State& state) {
+  constexpr Perms kPerms;
+  constexpr std::size_t kN = decltype(kPerms.Get(0)){}.size();
+  const auto indices = RandomIndices(kPerms);
+  std::vector<int> out(indices.size() * kN);
+  for (auto _ : state) {
+    kPerms.GetBatch(indices.data(), indices.size(), out.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() *
+                                                    indices.size()));
+}
+
+// `GetInto()` for each index into the same contiguous output as `GetBatch()`
+template <typename Perms>
+void BM_GetLoop(benchmark::State& state) {
+  constexpr Perms kPerms;
+  constexpr std::size_t kN = decltype(kPerms.Get(0)){}.size();
+  const auto indices = RandomIndices(kPerms);
+  std::vector<int> out(indices.size() * kN);
+  for (auto _ : state) {
+    for (std::size_t i = 0; i < indices.size(); ++i) {
+      kPerms.GetInto(indices[i], out.data() + i * kN);
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() *
+                                                    indices.size()));
+}
+
+template <typename Perms>
+void BM_IndexBatch(benchmark::State& state) {
+  constexpr Perms kPerms;
+  const auto indices = RandomIndices(kPerms);
+  std::vector<int> in;
+  for (auto index : indices) {
+    const auto perm = kPerms.Get(index);
+    in.insert(in.end(), perm.begin(), perm.end());
+  }
+  std::vector<std::size_t> out(indices.size());
+
+  for (auto _ : state) {
+    kPerms.IndexBatch(in.data(), indices.size(), out.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() *
+                                                    indices.size()));
+}
+
+// `Index()` for each row of the same contiguous input as `IndexBatch()`
+template <typename Perms>
+void BM_IndexLoop(benchmark::State& state) {
+  constexpr Perms kPerms;
+  constexpr std::size_t kN = decltype(kPerms.Get(0)){}.size();
+  const auto indices = RandomIndices(kPerms);
+  std::vector<int> in;
+  for (auto index : indices) {
+    const auto perm = kPerms.Get(index);
+    in.insert(in.end(), perm.begin(), perm.end());
+  }
+  std::vector<std::size_t> out(indices.size());
+
+  for (auto _ : state) {
+    for (std::size_t i = 0; i < indices.size(); ++i) {
+      out[i] = kPerms.Index(in.data() + i * kN, in.data() + (i + 1) * kN);
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() *
+                                                    indices.size()));
+}
+
+// `Get()` of a uniformly random index, for comparison with `Sample()`
+template <typename Perms>
+void BM_GetRandom(benchmark::State& state) {
+  constexpr Perms kPerms;
+  std::mt19937_64 mt(0x6b6f6d6f);
+  std::uniform_int_distribution<std::size_t> dist(0, kPerms.Size() - 1);
+  for (auto _ : state) {
+    for (std::size_t i = 0; i < kNumInputs; ++i) {
+      benchmark::DoNotOptimize(kPerms.Get(dist(mt)));
+    }
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() *
+                                                    kNumInputs));
+}
+
+template <typename Perms>
+void BM_Sample(benchmark::State& state) {
+  constexpr Perms kPerms;
+  std::mt19937_64 mt(0x6b6f6d6f);
+  for (auto _ : state) {
+    for (std::size_t i = 0; i < kNumInputs; ++i) {
+      benchmark::DoNotOptimize(kPerms.Sample(mt));
+    }
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() *
+                                                    kNumInputs));
+}
+
+template <typename Perms>
+void BM_SampleBatch(benchmark::State& state) {
+  constexpr Perms kPerms;
+  constexpr std::size_t kN = decltype(kPerms.Get(0)){}.size();
+  std::mt19937_64 mt(0x6b6f6d6f);
+  std::vector<int> out(kNumInputs * kN);
+  for (auto _ : state) {
+    kPerms.SampleBatch(mt, kNumInputs, out.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() *
+                                                    kNumInputs));
+}
+
+template <typename Perms>
+void BM_IteratorSweep(benchmark::State& state) {
+  constexpr Perms kPerms;
+  for (auto _ : state) {
+    std::size_t steps = 0;
+    for (auto itr = kPerms.begin(); steps < kNumSteps; ++steps) {
+      benchmark::DoNotOptimize(*itr);
+      if (++itr == kPerms.end()) {
+        itr = kPerms.begin();
+      }
+    }
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() *
+                                                    kNumSteps));
+}
+
+template <typename Perms>
+void BM_GetSweep(benchmark::State& state) {
+  constexpr Perms kPerms;
+  for (auto _ : state) {
+    for (std::size_t i = 0; i < kNumSteps; ++i) {
+      benchmark::DoNotOptimize(kPerms.Get(i % kPerms.Size()));
+    }
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() *
+                                                    kNumSteps));
+}
+
+template <typename Perms>
+void BM_GraySweep(benchmark::State& state) {
+  constexpr Perms kPerms;
+  for (auto _ : state) {
+    std::size_t steps = 0;
+    for (auto itr = kPerms.GrayBegin(); steps < kNumSteps; ++steps) {
+      benchmark::DoNotOptimize(*itr);
+      if (++itr == kPerms.GrayEnd()) {
+        itr = kPerms.GrayBegin();
+      }
+    }
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() *
+                                                    kNumSteps));
+}
+
+template <typename Perms>
+void BM_IndexAfterSwap(benchmark::State& state) {
+  constexpr Perms kPerms;
+  const auto indices = RandomIndices(kPerms);
+  std::vector<decltype(kPerms.Get(0))> perms;
+  for (auto index : indices) {
+    perms.push_back(kPerms.Get(index));
+  }
+  const std::size_t n = perms[0].size();
+
+  for (auto _ : state) {
+    for (std::size_t k = 0; k < perms.size(); ++k) {
+      benchmark::DoNotOptimize(kPerms.IndexAfterSwap(
+          indices[k], perms[k], k % n, (k * 7 + 3) % n));
+    }
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() *
+                                                    perms.size()));
+}
+
+template <typename Perms>
+void BM_LexGet(benchmark::State& state) {
+  constexpr Perms kPerms;
+  const auto indices = RandomIndices(kPerms);
+  for (auto _ : state) {
+    for (auto index : indices) {
+      benchmark::DoNotOptimize(kPerms.LexGet(index));
+    }
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() *
+                                                    indices.size()));
+}
+
+template <typename Perms>
+void BM_LexIndex(benchmark::State& state) {
+  constexpr Perms kPerms;
+  const auto indices = RandomIndices(kPerms);
+  std::vector<decltype(kPerms.LexGet(0))> perms;
+  for (auto index : indices) {
+    perms.push_back(kPerms.LexGet(index));
+  }
+
+  for (auto _ : state) {
+    for (const auto& perm : perms) {
+      benchmark::DoNotOptimize(kPerms.LexIndex(perm));
+    }
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() *
+                                                    perms.size()));
+}
+
+/// Pack `perm` by `B` bits per slot
+template <std::size_t B, std::size_t W, typename Perm>
+void Pack(const Perm& perm, std::uint64_t (&words)[W]) {
+  constexpr std::size_t kSlots = 64 / B;
+  for (auto& word : words) {
+    word = 0;
+  }
+  for (std::size_t j = 0; j < perm.size(); ++j) {
+    words[j / kSlots] |= static_cast<std::uint64_t>(perm[j])
+                         << (j % kSlots * B);
+  }
+}
+
+template <typename Perms, std::size_t B>
+void BM_IndexPacked(benchmark::State& state) {
+  constexpr Perms kPerms;
+  constexpr std::size_t kWords = Perms::template PackedWords<B>();
+  struct Packed {
+    std::uint64_t words[kWords];
+  };
+  const auto indices = RandomIndices(kPerms);
+  std::vector<Packed> packed(indices.size());
+  for (std::size_t i = 0; i < indices.size(); ++i) {
+    Pack<B>(kPerms.Get(indices[i]), packed[i].words);
+  }
+
+  for (auto _ : state) {
+    for (const auto& x : packed) {
+      benchmark::DoNotOptimize(kPerms.template IndexPacked<B>(x.words));
+    }
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() *
+                                                    packed.size()));
+}
+
+template <typename Perms, std::size_t B>
+void BM_GetPacked(benchmark::State& state) {
+  constexpr Perms kPerms;
+  const auto indices = RandomIndices(kPerms);
+  std::uint64_t words[Perms::template PackedWords<B>()]{};
+  for (auto _ : state) {
+    for (auto index : indices) {
+      kPerms.template GetPacked<B>(index, words);
+      benchmark::DoNotOptimize(words);
+    }
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() *
+                                                    indices.size()));
+}
+
+/// `DynamicPermutations` with the same input sequence as `Perms`
+template <typename Perms>
+DynamicPermutations<int> MakeDynamic(const Perms& perms) {
+  const auto first = perms.Get(0);
+  return DynamicPermutations<int>(first.begin(), first.end());
+}
+
+template <typename Perms>
+void BM_DynamicGet(benchmark::State& state) {
+  constexpr Perms kPerms;
+  const auto dynamic = MakeDynamic(kPerms);
+  const auto indices = RandomIndices(kPerms);
+  std::vector<int> out(dynamic.Spaces());
+  for (auto _ : state) {
+    for (auto index : indices) {
+      dynamic.Get(index, out.data());
+      benchmark::DoNotOptimize(out.data());
+    }
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() *
+                                                    indices.size()));
+}
+
+template <typename Perms>
+void BM_DynamicIndex(benchmark::State& state) {
+  constexpr Perms kPerms;
+  const auto dynamic = MakeDynamic(kPerms);
+  const auto indices = RandomIndices(kPerms);
+  std::vector<std::vector<int>> perms;
+  for (auto index : indices) {
+    perms.push_back(dynamic.Get(index));
+  }
+
+  for (auto _ : state) {
+    for (const auto& perm : perms) {
+      benchmark::DoNotOptimize(dynamic.Index(perm));
+    }
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() *
+                                                    perms.size()));
+}
+
+/// Look up (n choose m) for random (n, m) from `Table`
+template <typename Table>
+void BM_ChooseLookup(benchmark::State& state) {
+  constexpr Table kTable;
+  std::mt19937_64 mt(0x6b6f6d6f);
+  std::vector<std::size_t> ns(kNumInputs);
+  std::vector<std::size_t> ms(kNumInputs);
+  for (std::size_t i = 0; i < kNumInputs; ++i) {
+    ns[i] = 1 + mt() % Table::MaxN();
+    const std::size_t max_m = ns[i] < Table::MaxM() ? ns[i] : Table::MaxM();
+    ms[i] = mt() % (max_m + 1);
+  }
+
+  for (auto _ : state) {
+    std::uint64_t sum = 0;
+    for (std::size_t i = 0; i < kNumInputs; ++i) {
+      sum += kTable.GetUnchecked(ns[i], ms[i]);
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() *
+                                                    kNumInputs));
+  state.counters["bytes"] = sizeof(Table);
+}
+}  // namespace
+
+#define KOMOPERM_BENCH_SHAPES(func)              \
+  BENCHMARK_TEMPLATE(func, ManyDuplicates);      \
+  BENCHMARK_TEMPLATE(func, AllDistinct);         \
+  BENCHMARK_TEMPLATE(func, LargeN);              \
+  BENCHMARK_TEMPLATE(func, LargeK)
+
+KOMOPERM_BENCH_SHAPES(BM_Get);
+KOMOPERM_BENCH_SHAPES(BM_GetInto);
+KOMOPERM_BENCH_SHAPES(BM_Index);
+KOMOPERM_BENCH_SHAPES(BM_IndexRange);
+KOMOPERM_BENCH_SHAPES(BM_IndexUnchecked);
+KOMOPERM_BENCH_SHAPES(BM_GetLoop);
+KOMOPERM_BENCH_SHAPES(BM_GetBatch);
+KOMOPERM_BENCH_SHAPES(BM_IndexLoop);
+KOMOPERM_BENCH_SHAPES(BM_IndexBatch);
+KOMOPERM_BENCH_SHAPES(BM_GetRandom);
+KOMOPERM_BENCH_SHAPES(BM_Sample);
+KOMOPERM_BENCH_SHAPES(BM_SampleBatch);
+KOMOPERM_BENCH_SHAPES(BM_IteratorSweep);
+KOMOPERM_BENCH_SHAPES(BM_GetSweep);
+KOMOPERM_BENCH_SHAPES(BM_GraySweep);
+KOMOPERM_BENCH_SHAPES(BM_IndexAfterSwap);
+KOMOPERM_BENCH_SHAPES(BM_LexGet);
+KOMOPERM_BENCH_SHAPES(BM_LexIndex);
+BENCHMARK_TEMPLATE(BM_IndexPacked, ManyDuplicates, 4);
+BENCHMARK_TEMPLATE(BM_IndexPacked, AllDistinct, 4);
+BENCHMARK_TEMPLATE(BM_IndexPacked, LargeN, 2);
+BENCHMARK_TEMPLATE(BM_IndexPacked, LargeK, 5);
+BENCHMARK_TEMPLATE(BM_GetPacked, ManyDuplicates, 4);
+BENCHMARK_TEMPLATE(BM_GetPacked, AllDistinct, 4);
+BENCHMARK_TEMPLATE(BM_GetPacked, LargeN, 2);
+BENCHMARK_TEMPLATE(BM_GetPacked, LargeK, 5);
+BENCHMARK_TEMPLATE(BM_Get, Small);
+BENCHMARK_TEMPLATE(BM_Get, SmallTabulated);
+BENCHMARK_TEMPLATE(BM_Index, Small);
+BENCHMARK_TEMPLATE(BM_Index, SmallTabulated);
+BENCHMARK_TEMPLATE(BM_Get, Blanks);
+BENCHMARK_TEMPLATE(BM_Get, BlanksDescending);
+BENCHMARK_TEMPLATE(BM_Index, Blanks);
+BENCHMARK_TEMPLATE(BM_Index, BlanksDescending);
+BENCHMARK(BM_ProductGet);
+BENCHMARK(BM_ProductGetByComponents);
+KOMOPERM_BENCH_SHAPES(BM_DynamicGet);
+KOMOPERM_BENCH_SHAPES(BM_DynamicIndex);
+
+// The dense table vs. the packed table used by `Permutations`, whose entries
+// are narrowed to 32 bits for (32, 16) and (40, 8), and to 16 bits for (40, 3)
+BENCHMARK_TEMPLATE(BM_ChooseLookup, detail::Choose<std::uint64_t, 32, 16>);
+BENCHMARK_TEMPLATE(BM_ChooseLookup,
+                   detail::PackedChoose<std::uint64_t, 32, 16>);
+BENCHMARK_TEMPLATE(BM_ChooseLookup, detail::Choose<std::uint64_t, 40, 8>);
+BENCHMARK_TEMPLATE(BM_ChooseLookup, detail::PackedChoose<std::uint64_t, 40, 8>);
+BENCHMARK_TEMPLATE(BM_ChooseLookup, detail::Choose<std::uint64_t, 40, 3>);
+BENCHMARK_TEMPLATE(BM_ChooseLookup, detail::PackedChoose<std::uint64_t, 40, 3>);
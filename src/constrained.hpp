@@ -0,0 +1,514 @@
+// MIT License
+//
+// Copyright (c) 2022 komori-n(Toshinori Tsuboi)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef KOMORI_CONSTRAINED_HPP_
+#define KOMORI_CONSTRAINED_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <initializer_list>
+#include <stdexcept>
+#include <vector>
+
+#include "komoperm.hpp"
+
+namespace komoperm {
+namespace detail {
+/// The maximum number of count vectors of `ConstrainedPermutations`
+constexpr std::size_t kMaxConstrainedStates = std::size_t{1} << 24;
+
+/**
+ * @brief A class that enumerates permutations with constrained slots
+ *
+ * See `ConstrainedPermutations` for details.
+ */
+template <typename Perms>
+class ConstrainedImpl;
+
+template <typename T, typename I, std::size_t N, std::size_t M,
+          typename... ICs>
+class ConstrainedImpl<PermutationsImpl<T, I, N, M, ICs...>> {
+  using Perms = PermutationsImpl<T, I, N, M, ICs...>;
+  using Levels = ValueLevels<T, ICs...>;
+
+  /// The number of distinct values
+  static constexpr std::size_t kLevels = sizeof...(ICs);
+
+  /**
+   * @brief The number of count vectors, i.e. (`ICs::Count()` + 1)...
+   *
+   * It saturates at `kMaxConstrainedStates + 1`.
+   */
+  static constexpr std::size_t States() noexcept {
+    const std::size_t counts[] = {ICs::Count()...};
+    std::size_t ret = 1;
+    for (auto c : counts) {  // NOLINT
+      ret = ret > kMaxConstrainedStates / (c + 1) ? kMaxConstrainedStates + 1
+                                                  : ret * (c + 1);
+    }
+    return ret;
+  }
+
+  static_assert(kLevels <= 64, "ConstrainedPermutations supports K <= 64");
+  static_assert(States() <= kMaxConstrainedStates,
+                "The product of (count + 1) of all values must be at most "
+                "2^24");
+
+ public:
+  /// The index type
+  using index_type = I;
+
+  /**
+   * @brief Construct the view of all permutations of `perms`
+   */
+  explicit ConstrainedImpl(const Perms& /* perms */)
+      : allowed_(N, LowMask(kLevels)), free_(&FreeCounts()) {
+    const T vals[] = {ICs::Value()...};
+    for (std::size_t k = 0; k < kLevels; ++k) {
+      vals_[Levels::kRanks.levels[k]] = vals[k];
+    }
+    Layout(remains_, strides_);
+  }
+
+  /**
+   * @brief Allow only `val` at `slot`.
+   */
+  ConstrainedImpl& Fix(std::size_t slot, T val) {
+    if (slot >= N) {
+      KOMOPERM_THROW(std::runtime_error("Index out of range"));
+    }
+
+    std::size_t end = 0;
+    Allow(slot, std::uint64_t{1} << RankOf(val), end);
+    Update(end);
+    return *this;
+  }
+
+  /**
+   * @brief Fix the first `prefix.size()` slots to `prefix`.
+   */
+  template <typename Container>
+  ConstrainedImpl& FixPrefix(const Container& prefix) {
+    if (prefix.size() > N) {
+      KOMOPERM_THROW(std::runtime_error("The size of `vals` is illegal"));
+    }
+
+    std::size_t slot = 0;
+    std::size_t end = 0;
+    for (const auto& val : prefix) {
+      Allow(slot++, std::uint64_t{1} << RankOf(val), end);
+    }
+    Update(end);
+    return *this;
+  }
+
+  /**
+   * @brief Fix the first `prefix.size()` slots to `prefix`.
+   */
+  ConstrainedImpl& FixPrefix(std::initializer_list<T> prefix) {
+    return FixPrefix<std::initializer_list<T>>(prefix);
+  }
+
+  /**
+   * @brief Allow `val` only at `slots`.
+   */
+  template <typename Container>
+  ConstrainedImpl& Restrict(T val, const Container& slots) {
+    std::vector<bool> keep(N);
+    for (const auto& s : slots) {
+      const auto slot = static_cast<std::size_t>(s);
+      if (slot >= N) {
+        KOMOPERM_THROW(std::runtime_error("Index out of range"));
+      }
+      keep[slot] = true;
+    }
+
+    const std::uint64_t bit = std::uint64_t{1} << RankOf(val);
+    std::size_t end = 0;
+    for (std::size_t slot = 0; slot < N; ++slot) {
+      if (!keep[slot]) {
+        Allow(slot, ~bit, end);
+      }
+    }
+    Update(end);
+    return *this;
+  }
+
+  /**
+   * @brief Allow `val` only at `slots`.
+   */
+  ConstrainedImpl& Restrict(T val, std::initializer_list<std::size_t> slots) {
+    return Restrict<std::initializer_list<std::size_t>>(val, slots);
+  }
+
+  /**
+   * @brief The number of spaces
+   */
+  static constexpr std::size_t Spaces() noexcept { return N; }
+
+  /**
+   * @brief The number of admissible permutations
+   */
+  I Size() const noexcept { return CountAt(0, free_->size() - 1, 0); }
+
+  /**
+   * @brief Get `index` for the given admissible permutation
+   */
+  template <typename Container>
+  I Index(const Container& vals) const {
+    if (vals.size() != N) {
+      KOMOPERM_THROW(std::runtime_error("The size of `vals` is illegal"));
+    }
+
+    std::size_t remains[kLevels]{};
+    Copy(std::begin(remains_), std::end(remains_), std::begin(remains));
+    std::size_t state = free_->size() - 1;
+    std::size_t local = 0;
+    I ret = 0;
+    std::size_t i = 0;
+    for (const auto& val : vals) {
+      const std::size_t level = Levels::Of(val);
+      const std::size_t rank =
+          level == Levels::kNone ? kLevels : Levels::kRanks.levels[level];
+      if (rank == kLevels || remains[rank] == 0 ||
+          ((allowed_[i] >> rank) & 1) == 0) {
+        KOMOPERM_THROW(std::runtime_error("Input is illegal"));
+      }
+
+      for (std::size_t r = 0; r < rank; ++r) {
+        if (remains[r] > 0 && ((allowed_[i] >> r) & 1)) {
+          ret += CountAt(i + 1, state - strides_[r], local + lstrides_[r]);
+        }
+      }
+      state -= strides_[rank];
+      local += lstrides_[rank];
+      remains[rank]--;
+      ++i;
+    }
+    return ret;
+  }
+
+  /**
+   * @brief Get `index` for the given admissible permutation
+   */
+  I Index(std::initializer_list<T> vals) const {
+    return Index<std::initializer_list<T>>(vals);
+  }
+
+  /**
+   * @brief Get `index`'th admissible permutation.
+   */
+  Array<T, N> Get(I index) const {
+    if (index >= Size()) {
+      KOMOPERM_THROW(std::runtime_error("Index out of range"));
+    }
+
+    std::size_t remains[kLevels]{};
+    Copy(std::begin(remains_), std::end(remains_), std::begin(remains));
+    std::size_t state = free_->size() - 1;
+    std::size_t local = 0;
+    Array<T, N> ret{};
+    for (std::size_t i = 0; i < N; ++i) {
+      for (std::size_t r = 0;; ++r) {
+        if (remains[r] == 0 || ((allowed_[i] >> r) & 1) == 0) {
+          continue;
+        }
+
+        const I block =
+            CountAt(i + 1, state - strides_[r], local + lstrides_[r]);
+        if (index < block) {
+          ret[i] = vals_[r];
+          state -= strides_[r];
+          local += lstrides_[r];
+          remains[r]--;
+          break;
+        }
+        index -= block;
+      }
+    }
+    return ret;
+  }
+
+  /**
+   * @brief Get `index`'th admissible permutation.
+   */
+  Array<T, N> operator[](I index) const { return Get(index); }
+
+  /**
+   * @brief Call `fn(perm)` for all admissible permutations in index order.
+   *
+   * Only the prefixes which have an admissible permutation are visited, so
+   * it costs O(`Size() * N * K`) regardless of `Perms::Size()`.
+   */
+  template <typename Fn>
+  void ForEach(Fn&& fn) const {
+    if (Size() == 0) {
+      return;
+    }
+
+    std::size_t remains[kLevels]{};
+    Copy(std::begin(remains_), std::end(remains_), std::begin(remains));
+    Array<T, N> perm{};
+    ForEachImpl(0, free_->size() - 1, 0, remains, perm, fn);
+  }
+
+ private:
+  std::size_t RankOf(T val) const {
+    const std::size_t level = Levels::Of(val);
+    if (level == Levels::kNone) {
+      KOMOPERM_THROW(std::runtime_error("Input is illegal"));
+    }
+    return Levels::kRanks.levels[level];
+  }
+
+  /**
+   * @brief Set the counts of the values in rank order and their strides in
+   * the encoding of count vectors.
+   */
+  static void Layout(std::size_t (&remains)[kLevels],
+                     std::size_t (&strides)[kLevels]) noexcept {
+    const std::size_t counts[] = {ICs::Count()...};
+    for (std::size_t k = 0; k < kLevels; ++k) {
+      remains[Levels::kRanks.levels[k]] = counts[k];
+    }
+    std::size_t stride = 1;
+    for (std::size_t r = 0; r < kLevels; ++r) {
+      strides[r] = stride;
+      stride *= remains[r] + 1;
+    }
+  }
+
+  /**
+   * @brief The number of ways to fill the last `n` slots without constraints
+   * for each count vector
+   *
+   * `FreeCounts()[state]` is the multinomial coefficient of the remaining
+   * counts encoded in `state`, and `n` is the sum of them. The table depends
+   * only on `Perms`, so it is built on the first construction and shared by
+   * all objects.
+   */
+  static const std::vector<I>& FreeCounts() {
+    static const std::vector<I> counts = MakeFreeCounts();
+    return counts;
+  }
+
+  static std::vector<I> MakeFreeCounts() {
+    std::size_t counts[kLevels]{};
+    std::size_t strides[kLevels]{};
+    Layout(counts, strides);
+
+    // Removing a value decreases `state`, so `ret` is filled in ascending
+    // order of `state`.
+    std::vector<I> ret(States());
+    std::size_t remains[kLevels]{};
+    ret[0] = 1;
+    for (std::size_t state = 1; state < ret.size(); ++state) {
+      // Increment the mixed-radix digits of `state`.
+      for (std::size_t r = 0; remains[r]++ == counts[r]; ++r) {
+        remains[r] = 0;
+      }
+
+      I sum = 0;
+      for (std::size_t r = 0; r < kLevels; ++r) {
+        if (remains[r] > 0) {
+          sum += ret[state - strides[r]];
+        }
+      }
+      ret[state] = sum;
+    }
+    return ret;
+  }
+
+  /**
+   * @brief The number of admissible ways to fill the slots from `i`th
+   *
+   * `state` encodes the remaining counts by `strides_`, and `local` encodes
+   * the used counts by `lstrides_`. Only the first `bound_` slots have
+   * constraints, so the counts after them are looked up in `FreeCounts()`.
+   */
+  I CountAt(std::size_t i, std::size_t state, std::size_t local) const
+      noexcept {
+    return i < bound_ ? counts_[local] : (*free_)[state];
+  }
+
+  /**
+   * @brief Intersect the allowed values at `slot` with `mask`.
+   *
+   * `end` is raised to `slot + 1` if the allowed values have changed.
+   */
+  void Allow(std::size_t slot, std::uint64_t mask, std::size_t& end) noexcept {
+    const std::uint64_t allowed = allowed_[slot] & mask;
+    if (allowed != allowed_[slot]) {
+      allowed_[slot] = allowed;
+      end = std::max(end, slot + 1);
+    }
+  }
+
+  /**
+   * @brief Update the counts after the allowed values of some of the first
+   * `end` slots have changed.
+   *
+   * The counts from the `i`th slot depend only on the allowed values of the
+   * `i`th and later slots, so only the counts of the first `end` slots are
+   * recomputed. If `end` exceeds `bound_`, the local table is enlarged and
+   * recomputed as a whole.
+   */
+  void Update(std::size_t end) {
+    if (end > bound_) {
+      bound_ = end;
+      std::size_t stride = 1;
+      for (std::size_t r = 0; r < kLevels; ++r) {
+        lstrides_[r] = stride;
+        stride *= std::min(remains_[r], bound_) + 1;
+      }
+      counts_.assign(stride, 0);
+    }
+    Count(end);
+  }
+
+  /**
+   * @brief Count the admissible permutations for each used count vector
+   * whose sum is less than `end`.
+   *
+   * `counts_[local]` is the number of ways to fill the slots from `i`th,
+   * where `local` encodes the used counts of the values by `lstrides_` and `i`
+   * is the sum of them. Using a value increases `local`, so `counts_` is
+   * filled in descending order of `local`.
+   */
+  void Count(std::size_t end) noexcept {
+    std::size_t used[kLevels]{};
+    std::size_t i = 0;
+    std::size_t state = free_->size() - 1;
+    for (std::size_t r = 0; r < kLevels; ++r) {
+      used[r] = std::min(remains_[r], bound_);
+      i += used[r];
+      state -= used[r] * strides_[r];
+    }
+
+    for (std::size_t local = counts_.size(); local-- > 0;) {
+      if (i < end) {
+        const std::uint64_t allowed = allowed_[i];
+        I sum = 0;
+        for (std::size_t r = 0; r < kLevels; ++r) {
+          if (used[r] < remains_[r] && ((allowed >> r) & 1)) {
+            sum += CountAt(i + 1, state - strides_[r], local + lstrides_[r]);
+          }
+        }
+        counts_[local] = sum;
+      }
+
+      if (local > 0) {
+        // Decrement the mixed-radix digits of `local`.
+        std::size_t r = 0;
+        for (; used[r] == 0; ++r) {
+          used[r] = std::min(remains_[r], bound_);
+          i += used[r];
+          state -= used[r] * strides_[r];
+        }
+        used[r]--;
+        i--;
+        state += strides_[r];
+      }
+    }
+  }
+
+  template <typename Fn>
+  void ForEachImpl(std::size_t i, std::size_t state, std::size_t local,
+                   std::size_t (&remains)[kLevels], Array<T, N>& perm,
+                   Fn& fn) const {
+    if (i == N) {
+      fn(static_cast<const Array<T, N>&>(perm));
+      return;
+    }
+
+    for (std::size_t r = 0; r < kLevels; ++r) {
+      if (remains[r] > 0 && ((allowed_[i] >> r) & 1) &&
+          CountAt(i + 1, state - strides_[r], local + lstrides_[r]) > 0) {
+        perm[i] = vals_[r];
+        remains[r]--;
+        ForEachImpl(i + 1, state - strides_[r], local + lstrides_[r], remains,
+                    perm, fn);
+        remains[r]++;
+      }
+    }
+  }
+
+  /// `vals_[r]` is the `r`th smallest value.
+  T vals_[kLevels]{};
+  /// The count of `vals_[r]`
+  std::size_t remains_[kLevels]{};
+  /// The stride of `vals_[r]` in the encoding of count vectors
+  std::size_t strides_[kLevels]{};
+  /// The stride of `vals_[r]` in the encoding of used count vectors
+  std::size_t lstrides_[kLevels]{};
+  /// `allowed_[i] >> r & 1` iff `vals_[r]` is allowed at the `i`th slot
+  std::vector<std::uint64_t> allowed_;
+  /// All values are allowed at the `bound_`th and later slots.
+  std::size_t bound_{0};
+  /// `FreeCounts()`
+  const std::vector<I>* free_;
+  /// The number of admissible permutations for each used count vector
+  std::vector<I> counts_;
+};
+}  // namespace detail
+
+/**
+ * @brief A view of the permutations of `Perms` that satisfy constraints on
+ * the slots
+ *
+ * `Fix(slot, val)`, `FixPrefix(prefix)` and `Restrict(val, slots)` narrow the
+ * values allowed at each slot. Then `Get()`, `Index()` and `ForEach()` access
+ * only the admissible permutations in the lexicographic order, i.e. the same
+ * order as `Perms::LexGet()`.
+ *
+ * The admissible permutations are counted by the dynamic programming over the
+ * count vectors of the values. Let S be the product of (count + 1) of all
+ * values, which must be at most 2^24, and B be one plus the last slot with a
+ * constraint.
+ *
+ * - The counts after the B'th slot do not depend on the constraints. They are
+ *   kept in a table of S entries of `I`, which is built on the first
+ *   construction and shared by all objects of the same `Perms`.
+ * - Each object keeps the counts of the first B slots, whose table has the
+ *   product of (min(count, B) + 1) entries of `I`. It is at most S and much
+ *   smaller for a short prefix.
+ * - A constraint at the `i`th slot recomputes only the counts of the slots up
+ *   to `i`, which costs O(L * K) at most, where L is the size of the local
+ *   table.
+ *
+ * # Example
+ *
+ * ```
+ * constexpr Permutations<int, 0, 0, 1, 1, 2> p;
+ * ConstrainedPermutations<decltype(p)> c(p);
+ * c.FixPrefix({1}).Restrict(2, {0, 1});  // {1, 2, *, *, *}
+ *
+ * c.Size();  // 3
+ * c.Get(0);  // {1, 2, 0, 0, 1}
+ * c.ForEach([](const auto& perm) { Evaluate(perm); });
+ * ```
+ */
+template <typename Perms>
+using ConstrainedPermutations = detail::ConstrainedImpl<Perms>;
+}  // namespace komoperm
+
+#endif  // KOMORI_CONSTRAINED_HPP_
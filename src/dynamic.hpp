@@ -0,0 +1,354 @@
+// MIT License
+//
+// Copyright (c) 2022 komori-n(Toshinori Tsuboi)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef KOMORI_DYNAMIC_HPP_
+#define KOMORI_DYNAMIC_HPP_
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <initializer_list>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "komoperm.hpp"
+
+namespace komoperm {
+namespace detail {
+/**
+ * @brief A runtime counterpart of `PackedChoose`
+ *
+ * It holds (n choose m) for n in [0, `max_n`] and m in [0, min(n, `max_m`)].
+ * Entries which overflow `I` are saturated to `std::numeric_limits<I>::max()`.
+ */
+template <typename I>
+class DynamicChoose {
+ public:
+  DynamicChoose() = default;
+
+  DynamicChoose(std::size_t max_n, std::size_t max_m)
+      : max_m_{max_m}, vals_((max_n + 1) * (max_m + 1)) {
+    constexpr I kMax = std::numeric_limits<I>::max();
+    for (std::size_t n = 0; n <= max_n; ++n) {
+      vals_[Offset(n)] = 1;
+      for (std::size_t m = 1; m <= (n < max_m ? n : max_m); ++m) {
+        const I upper = (m < n) ? vals_[Offset(n - 1) + m] : I{0};
+        const I upper_left = vals_[Offset(n - 1) + m - 1];
+        vals_[Offset(n) + m] =
+            (upper > kMax - upper_left) ? kMax : upper + upper_left;
+      }
+    }
+  }
+
+  /**
+   * @brief Calculate (n choose m) without any checks. precondition:
+   * (n <= max_n && m <= min(n, max_m)).
+   */
+  I GetUnchecked(std::size_t n, std::size_t m) const noexcept {
+    return vals_[Offset(n) + m];
+  }
+
+ private:
+  std::size_t Offset(std::size_t n) const noexcept { return n * (max_m_ + 1); }
+
+  std::size_t max_m_{0};
+  /// vals_[n * (max_m_ + 1) + m] = nCm
+  std::vector<I> vals_;
+};
+
+/**
+ * @brief A temporary array of `U` which avoids heap allocations for short
+ * sequences
+ */
+template <typename U, std::size_t S = 64>
+class LocalBuffer {
+ public:
+  explicit LocalBuffer(std::size_t n)
+      : heap_{n > S ? new U[n]() : nullptr} {}
+
+  U* data() noexcept { return heap_ ? heap_.get() : local_; }
+
+ private:
+  U local_[S]{};
+  std::unique_ptr<U[]> heap_;
+};
+}  // namespace detail
+
+/**
+ * @brief A class that handles permutation of duplicates given at runtime
+ *
+ * Different from `Permutations`, the input sequence is a constructor argument
+ * instead of a template parameter pack. So many input sequences share one
+ * instantiation, at the cost of runtime divisions and a heap allocated
+ * `Choose` table. The indices are the same as `Permutations` with the same
+ * input sequence.
+ *
+ * # Example
+ *
+ * ```
+ * const std::vector<int> vals = LoadFromConfig();  // e.g. {0, 0, 0, 1, 1, 2}
+ * const DynamicPermutations<int> p(vals.begin(), vals.end());
+ *
+ * const auto perm = p.Get(10);  // {1, 0, 0, 0, 1, 2}
+ * const auto index = p.Index(perm);  // 10
+ * ```
+ *
+ * @tparam T  The type to be placed. It should be an integer or an enum type
+ * @tparam I  The index type. (See `detail::IsIndexType`)
+ */
+template <typename T, typename I = std::size_t>
+class DynamicPermutations {
+ public:
+  /// The index type
+  using index_type = I;
+
+  /**
+   * @brief Construct permutations of [`first`, `last`)
+   *
+   * It throws if the input sequence is empty or the number of permutations is
+   * not representable by I.
+   */
+  template <typename InputIterator>
+  DynamicPermutations(InputIterator first, InputIterator last) {
+    Summarize(std::vector<T>(first, last));
+  }
+
+  /**
+   * @brief Construct permutations of `vals`
+   */
+  DynamicPermutations(std::initializer_list<T> vals) {
+    Summarize(std::vector<T>(vals));
+  }
+
+  /**
+   * @brief The number of spaces
+   */
+  std::size_t Spaces() const noexcept { return spaces_[0]; }
+
+  /**
+   * @brief The number of possible permutations
+   */
+  I Size() const noexcept { return size_; }
+
+  /**
+   * @brief Get `index` for the given permutation
+   */
+  template <typename Container>
+  I Index(const Container& vals) const {
+    if (vals.size() != Spaces()) {
+      KOMOPERM_THROW(std::runtime_error("The size of `vals` is illegal"));
+    }
+
+    detail::LocalBuffer<T> tmp_vals(Spaces());
+    std::copy(vals.begin(), vals.end(), tmp_vals.data());
+    if (!IsValid(tmp_vals.data())) {
+      KOMOPERM_THROW(std::runtime_error("Input is illegal"));
+    }
+    return IndexImpl(tmp_vals.data());
+  }
+
+  /**
+   * @brief Get `index` for the given permutation
+   */
+  I Index(std::initializer_list<T> vals) const {
+    return Index<std::initializer_list<T>>(vals);
+  }
+
+  /**
+   * @brief Get `index` for the given permutation without validation
+   *
+   * `vals` must be a possible permutation, e.g. a result of `Get()`. It is not
+   * `noexcept` because a sequence longer than 64 spaces is copied into a heap
+   * buffer, which may throw `std::bad_alloc`.
+   */
+  template <typename Container>
+  I IndexUnchecked(const Container& vals) const {
+    assert(static_cast<std::size_t>(vals.size()) == Spaces());
+
+    detail::LocalBuffer<T> tmp_vals(Spaces());
+    std::copy(vals.begin(), vals.end(), tmp_vals.data());
+    return IndexImpl(tmp_vals.data());
+  }
+
+  /**
+   * @brief Get `index`'th permutation.
+   */
+  std::vector<T> Get(I index) const {
+    std::vector<T> ret(Spaces());
+    Get(index, ret.data());
+    return ret;
+  }
+
+  /**
+   * @brief Write `index`'th permutation to [`out`, `out + Spaces()`).
+   *
+   * Different from the above overload, it never allocates memory for short
+   * sequences.
+   */
+  void Get(I index, T* out) const {
+    if (index >= Size()) {
+      KOMOPERM_THROW(std::runtime_error("Index out of range"));
+    }
+
+    detail::LocalBuffer<bool> filled_buf(Spaces());
+    bool* filled = filled_buf.data();
+    for (std::size_t k = 0; k < values_.size(); ++k) {
+      detail::CombinationGet(choose_, values_[k], spaces_[k], counts_[k],
+                             index % sizes_[k], out, filled, Spaces());
+      index /= sizes_[k];
+    }
+  }
+
+  /**
+   * @brief Get `index`'th permutation.
+   */
+  std::vector<T> operator[](I index) const { return Get(index); }
+
+ private:
+  void Summarize(std::vector<T> vals) {
+    const std::size_t n = vals.size();
+    if (n == 0) {
+      KOMOPERM_THROW(
+          std::runtime_error("The input sequence must not be empty"));
+    }
+
+    // Group the same values by sorting, and then order the groups by their
+    // first occurrences in the same way as `detail::MakeItemCountsImplCalc()`.
+    std::vector<std::pair<T, std::size_t>> items(n);
+    for (std::size_t i = 0; i < n; ++i) {
+      items[i] = {vals[i], i};
+    }
+    std::sort(items.begin(), items.end());
+
+    // groups[g] = (first occurrence, the position of the first item in `items`)
+    std::vector<std::pair<std::size_t, std::size_t>> groups;
+    for (std::size_t i = 0; i < n; ++i) {
+      if (i == 0 || items[i - 1].first != items[i].first) {
+        groups.emplace_back(items[i].second, i);
+      }
+    }
+    std::sort(groups.begin(), groups.end());
+
+    std::size_t max_count = 0;
+    std::size_t remains = n;
+    for (const auto& group : groups) {
+      std::size_t count = 1;
+      const std::size_t first = group.second;
+      while (first + count < n &&
+             !(items[first].first != items[first + count].first)) {
+        count++;
+      }
+
+      values_.push_back(items[first].first);
+      spaces_.push_back(remains);
+      counts_.push_back(count);
+      sorted_.emplace_back(items[first].first, values_.size() - 1);
+      max_count = count > max_count ? count : max_count;
+      remains -= count;
+    }
+    std::sort(sorted_.begin(), sorted_.end());
+
+    choose_ = detail::DynamicChoose<I>(n, max_count);
+    size_ = 1;
+    for (std::size_t k = 0; k < values_.size(); ++k) {
+      const I size = choose_.GetUnchecked(spaces_[k], counts_[k]);
+      if (size == std::numeric_limits<I>::max() ||
+          size > std::numeric_limits<I>::max() / size_) {
+        KOMOPERM_THROW(std::runtime_error(
+            "The number of permutations must be representable by I"));
+      }
+      sizes_.push_back(size);
+      size_ *= size;
+    }
+  }
+
+  /**
+   * @brief The level of `val`, or `values_.size()` if `val` does not appear
+   */
+  std::size_t LevelOf(T val) const noexcept {
+    const auto itr = std::lower_bound(
+        sorted_.begin(), sorted_.end(), val,
+        [](const std::pair<T, std::size_t>& lhs, T rhs) {
+          return lhs.first < rhs;
+        });
+    if (itr == sorted_.end() || itr->first != val) {
+      return values_.size();
+    }
+    return itr->second;
+  }
+
+  bool IsValid(const T* vals) const {
+    const std::size_t levels = values_.size();
+    detail::LocalBuffer<std::size_t> counts_buf(levels);
+    std::size_t* counts = counts_buf.data();
+    for (std::size_t i = 0; i < Spaces(); ++i) {
+      const std::size_t level = LevelOf(vals[i]);
+      if (level == levels) {
+        return false;
+      }
+      counts[level]++;
+    }
+
+    for (std::size_t k = 0; k < levels; ++k) {
+      if (counts[k] != counts_[k]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  I IndexImpl(T* tmp_vals) const noexcept {
+    I index = 0;
+    I base = 1;
+    for (std::size_t k = 0; k < values_.size(); ++k) {
+      index += base * detail::CombinationIndex<I>(choose_, values_[k],
+                                                  spaces_[k], counts_[k],
+                                                  tmp_vals);
+      base *= sizes_[k];
+    }
+    return index;
+  }
+
+  /// values_[k] = `ICs[k]::Value()` of the corresponding `Permutations`
+  std::vector<T> values_;
+  /// spaces_[k] = `ICs[k]::Spaces()`
+  std::vector<std::size_t> spaces_;
+  /// counts_[k] = `ICs[k]::Count()`
+  std::vector<std::size_t> counts_;
+  /// sizes_[k] = `ICs[k]::Size()`
+  std::vector<I> sizes_;
+  /// The pairs of (value, level) sorted by value
+  std::vector<std::pair<T, std::size_t>> sorted_;
+  I size_{1};
+  detail::DynamicChoose<I> choose_;
+
+  static_assert(detail::IsIndexType<I>::value,
+                "I must be an unsigned integer type not narrower than "
+                "unsigned");
+};
+}  // namespace komoperm
+
+#endif  // KOMORI_DYNAMIC_HPP_
@@ -27,11 +27,143 @@
 #include <array>
 #include <cassert>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
 #include <limits>
+#include <random>
 #include <stdexcept>
 #include <type_traits>
 
+#if defined(__BMI2__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif  // defined(__BMI2__) || defined(__AVX2__)
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif  // defined(__aarch64__) && defined(__ARM_NEON)
+
+// `KOMOPERM_HAS_IS_CONSTANT_EVALUATED` is defined iff
+// `__builtin_is_constant_evaluated()` is available even in C++14.
+#if defined(__has_builtin)
+#if __has_builtin(__builtin_is_constant_evaluated)
+#define KOMOPERM_HAS_IS_CONSTANT_EVALUATED
+#endif
+#elif defined(__GNUC__) && __GNUC__ >= 9
+#define KOMOPERM_HAS_IS_CONSTANT_EVALUATED
+#endif
+
+// `KOMOPERM_THROW(e)` throws `e` if exceptions are enabled. Otherwise, it
+// aborts, which also fails the compilation in constant evaluations. So the
+// library compiles with `-fno-exceptions`.
+#if defined(__cpp_exceptions) || defined(__EXCEPTIONS) || defined(_CPPUNWIND)
+#define KOMOPERM_THROW(e) throw e
+#else
+#define KOMOPERM_THROW(e) std::abort()
+#endif
+
+// `KOMOPERM_SIMD_BYTES` is the width of the vector registers for
+// `detail::SimdEqualMasks()`. It is defined iff AVX2 or AArch64 NEON is
+// available and `KOMOPERM_HAS_IS_CONSTANT_EVALUATED` is defined.
+#if defined(KOMOPERM_HAS_IS_CONSTANT_EVALUATED)
+#if defined(__AVX2__)
+#define KOMOPERM_SIMD_BYTES 32
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define KOMOPERM_SIMD_BYTES 16
+#endif
+#endif  // defined(KOMOPERM_HAS_IS_CONSTANT_EVALUATED)
+
+// If `KOMOPERM_ENABLE_STATS` is defined, `PermutationsImpl::Counters()` counts
+// the calls and the loop iterations at runtime. Otherwise, the hooks are empty
+// and compiled out. It must be defined consistently in all translation units.
+#if defined(KOMOPERM_ENABLE_STATS) && \
+    !defined(KOMOPERM_HAS_IS_CONSTANT_EVALUATED)
+#error "KOMOPERM_ENABLE_STATS requires __builtin_is_constant_evaluated()"
+#endif
+
 namespace komoperm {
+/**
+ * @brief The order of `ItemCount`s, i.e. the digits of the index from the
+ * lowest one
+ *
+ * Each `ItemCount` scans and compacts the slots that the previous ones left.
+ * The last one owns all the remaining slots, so its digit is always 0.
+ * `Index()` skips it, and `Get()` fills the remaining slots without the
+ * `Choose` table.
+ * So the work of `Index()` and `Get()` is the sum of the remaining slots over
+ * all `ItemCount`s but the last. `kDescendingCount` minimizes it, and the
+ * skipped one is the rarest value.
+ */
+enum class ItemOrder {
+  /// The order of the first occurrences in the input sequence (default)
+  kFirstOccurrence,
+  /**
+   * The descending order of the counts, which minimizes the remaining slots.
+   * Ties are broken by the first occurrences.
+   */
+  kDescendingCount,
+};
+
+/**
+ * @brief The reason why `TryIndex()` or `TryGet()` fails
+ */
+enum class Error {
+  /// No error
+  kOk,
+  /// The size of the input is not the number of spaces
+  kIllegalSize,
+  /// The input is not a possible permutation
+  kIllegalInput,
+  /// The index is not less than `Size()`
+  kOutOfRange,
+};
+
+/**
+ * @brief The result of `TryIndex()` and `TryGet()`
+ *
+ * `value` is meaningful only if `error == Error::kOk`. It is a minimal
+ * alternative to `std::optional` and `std::expected`, which are not available
+ * in C++14.
+ */
+template <typename V>
+struct Result {
+  /// The result value
+  V value{};
+  /// The reason of the failure
+  Error error{Error::kOk};
+
+  /// `true` iff it succeeded
+  constexpr bool ok() const noexcept { return error == Error::kOk; }
+  /// `true` iff it succeeded
+  constexpr explicit operator bool() const noexcept { return ok(); }
+};
+
+/**
+ * @brief The counters of `PermutationsImpl::Counters()`
+ *
+ * @tparam K  The number of `ItemCount`s
+ */
+template <std::size_t K>
+struct Stats {
+  /// The counters of an `ItemCount`, attributed by `Index()` and `Get()`
+  struct Level {
+    /// The iterations of the loops over the slots
+    std::uint64_t iterations{};
+    /// The lookups of the `Choose` table
+    std::uint64_t lookups{};
+  };
+
+  /// The calls of `Index()`, `TryIndex()` and `IndexUnchecked()`
+  std::uint64_t index_calls{};
+  /// The calls of them which failed the validation
+  std::uint64_t index_failures{};
+  /// The calls of `Get()`, `TryGet()`, `GetUnchecked()` and `GetAndDivide()`
+  std::uint64_t get_calls{};
+  /// The calls of them with `index` out of range
+  std::uint64_t get_failures{};
+  /// The counters of `ICs[k]` in the digit order
+  Level levels[K]{};
+};
+
 namespace detail {
 /**
  * @brief A utility template type for SFINAE
@@ -153,7 +285,8 @@ using Array = std::array<T, N>;
  */
 template <typename T, std::size_t N, std::size_t M = N>
 class Choose {
-  static_assert(std::is_integral<T>::value, "T must be an integer type");
+  static_assert(std::numeric_limits<T>::is_integer,
+                "T must be an integer type");
   static_assert(M <= N, "M must be equal to or less than N");
 
  public:
@@ -178,369 +311,3918 @@ class Choose {
     if (m > n) {
       return 0;
     } else if (n > N || m > M) {
-      throw std::runtime_error("index out of range");
+      KOMOPERM_THROW(std::runtime_error("index out of range"));
     }
 
     return vals_[n - 1][m];
   }
 
+  /**
+   * @brief Calculate (n choose m) without any checks. precondition:
+   * (1 <= n <= N && m <= min(n, M)).
+   */
+  constexpr T GetUnchecked(std::size_t n, std::size_t m) const noexcept {
+    return vals_[n - 1][m];
+  }
+
+  /// The maximum `n` for `Get()`
+  static constexpr std::size_t MaxN() noexcept { return N; }
+  /// The maximum `m` for `Get()`
+  static constexpr std::size_t MaxM() noexcept { return M; }
+
+  /**
+   * @brief `true` iff the table holds (n' choose m') for all 1 <= n' <= n and
+   * m' <= min(n', m)
+   */
+  static constexpr bool Covers(std::size_t n, std::size_t m) noexcept {
+    return n <= N && (n < m ? n : m) <= M;
+  }
+
  private:
   /// vals_[n-1][m] = nCm
   T vals_[N][M + 1]{};
 };
 
 /**
- * @brief Calculate (N choose M) at compile time
- *
- * Whereas `Choose` class may calculate the results at runtime, this meta
- * function definitely calculates it at compile time.
- */
-template <std::size_t N, std::size_t M>
-struct ChooseMetaFunc
-    : std::integral_constant<std::size_t,
-                             ChooseMetaFunc<N - 1, M>::value +
-                                 ChooseMetaFunc<N - 1, M - 1>::value> {};
-
-template <std::size_t N>
-struct ChooseMetaFunc<N, 0> : std::integral_constant<std::size_t, 1> {};
-
-template <std::size_t M>
-struct ChooseMetaFunc<0, M> : std::integral_constant<std::size_t, 0> {};
-template <std::size_t N>
-struct ChooseMetaFunc<N, N> : std::integral_constant<std::size_t, 1> {};
-
-/**
- * @brief Copy [in_begin, in_end)
- *             to [out_begin, out_begin + (in_end - in_begin))
- *
- * As `std::copy()` is not constexpr in C++14, we prepare a similar function.
+ * @brief The maximum value in (0 choose 0), ..., (N choose M). If it overflows,
+ * returns `std::numeric_limits<I>::max()`.
  */
-template <typename InputIterator, typename OutputIterator>
-inline constexpr void Copy(InputIterator in_begin, InputIterator in_end,
-                           OutputIterator out_begin) noexcept {
-  while (in_begin != in_end) {
-    *(out_begin++) = *(in_begin++);
+template <typename I, std::size_t N, std::size_t M>
+inline constexpr I SaturatedMaxChoose() noexcept {
+  // (N choose min(M, N/2)) is the maximum. Calculate the N-th row of the Pascal
+  // triangle with saturation.
+  constexpr std::size_t kM = M < N / 2 ? M : N / 2;
+  constexpr I kMax = std::numeric_limits<I>::max();
+  I row[kM + 1]{1};
+  for (std::size_t n = 1; n <= N; ++n) {
+    for (std::size_t m = (n < kM ? n : kM); m > 0; --m) {
+      row[m] = (row[m] > kMax - row[m - 1]) ? kMax : row[m] + row[m - 1];
+    }
   }
+  return row[kM];
 }
 
 /**
- * @brief `true` iff `list` has at least one `true`
- *
- * As `std::any_of()` is not constexpr in C++14, we prepare a similar function.
+ * @brief The narrowest unsigned integer type that can hold `Max`
  */
-inline constexpr bool AnyOf(std::initializer_list<bool> list) noexcept {
-  for (auto x : list) {  // NOLINT
-    if (x) {
-      return true;
-    }
-  }
-  return false;
-}
+template <typename I, I Max>
+using NarrowestUnsigned = std::conditional_t<
+    (Max <= std::numeric_limits<std::uint8_t>::max()), std::uint8_t,
+    std::conditional_t<
+        (Max <= std::numeric_limits<std::uint16_t>::max()), std::uint16_t,
+        std::conditional_t<
+            (Max <= std::numeric_limits<std::uint32_t>::max()), std::uint32_t,
+            std::conditional_t<
+                (Max <= std::numeric_limits<std::uint64_t>::max()),
+                std::uint64_t, I>>>>;
 
 /**
- * @brief A constexpr sort function.
+ * @brief The offsets of the rows of `PackedChoose<I, N, M>`
  *
- * Due to the constraints of merge sorts, this function requires a temporary
- * region which is greater than or equal to `end - begin`.
+ * `operator[](n)` is the offset of the row for `n`. Looking it up is faster
+ * than calculating it from `n`, which takes a branch or multiplications on the
+ * critical path of each lookup of `PackedChoose`.
  */
-template <typename Iterator>
-inline constexpr void MergeSort(Iterator begin, Iterator end,
-                                Iterator tmp_begin) noexcept {
-  const auto len = end - begin;
-  if (len <= 1) {
-    return;
+template <std::size_t N, std::size_t M>
+class PackedChooseRows {
+ public:
+  /// Calculate the offset of the row for `n`
+  static constexpr std::size_t Calc(std::size_t n) noexcept {
+    // The rows for n <= M have n+1 entries, and the others have M+1 entries.
+    return n <= M ? n * (n + 1) / 2
+                  : (M + 1) * (M + 2) / 2 + (n - M - 1) * (M + 1);
   }
 
-  Iterator mid = begin + len / 2;
-
-  MergeSort(begin, mid, tmp_begin);
-  MergeSort(mid, end, tmp_begin);
+  /// The type of the offsets
+  using value_type = NarrowestUnsigned<std::size_t, Calc(N + 1)>;
 
-  Iterator li = begin;
-  Iterator ri = mid;
-  Iterator oi = tmp_begin;
-  while (li < mid && ri < end) {
-    if (*li < *ri) {
-      *(oi++) = *(li++);
-    } else {
-      *(oi++) = *(ri++);
+  constexpr PackedChooseRows() noexcept {
+    for (std::size_t n = 0; n <= N + 1; ++n) {
+      offsets_[n] = static_cast<value_type>(Calc(n));
     }
   }
 
-  if (li == mid) {
-    while (ri < end) {
-      *(oi++) = *(ri++);
-    }
-  } else {
-    while (li < mid) {
-      *(oi++) = *(li++);
-    }
+  /// The offset of the row for `n`. precondition: (n <= N + 1).
+  constexpr std::size_t operator[](std::size_t n) const noexcept {
+    return offsets_[n];
   }
 
-  auto tmp_end = tmp_begin + len;
-  Copy(tmp_begin, tmp_end, begin);
-}
+ private:
+  value_type offsets_[N + 2]{};
+};
 
 /**
- * @brief This function counts # of unique values in `Vals...`
+ * @brief A compact version of `Choose` that stores only (n choose m) for m <=
+ * min(n, M)
+ *
+ * The rows of the Pascal triangle are packed in a one-dimensional array, and
+ * each entry is stored in the narrowest unsigned integer type that can hold
+ * all entries. Compared to `Choose<I, N, M>`, which holds N x (M+1) entries of
+ * `I`, the table is several times smaller and fits in fewer cache lines.
+ *
+ * Different from `Choose`, `n == 0` is also accepted.
+ *
+ * # Example
+ *
+ * ```
+ * constexpr PackedChoose<std::size_t, 4, 2> choose{};
+ * EXPECT_EQ(choose.Get(4, 2), 6);
+ * static_assert(sizeof(choose) == 12);  // 12 entries of std::uint8_t
+ * ```
+ *
+ * @tparam I  The result type
  */
-template <typename T, T... Vals>
-inline constexpr std::size_t UniqueCount() noexcept {
-  if (sizeof...(Vals) == 0) {
-    return 0;
-  }
-
-  T vals[sizeof...(Vals)]{Vals...};
-  T tmp[sizeof...(Vals)]{};
+template <typename I, std::size_t N, std::size_t M = N>
+class PackedChoose {
+  static_assert(M <= N, "M must be equal to or less than N");
 
-  // Sort the input values to reduce time complexity
-  MergeSort(std::begin(vals), std::end(vals), std::begin(tmp));
+ public:
+  /// The type of the entries
+  using value_type = NarrowestUnsigned<I, SaturatedMaxChoose<I, N, M>()>;
 
-  T prev = vals[0];
-  std::size_t count = 1;
-  for (std::size_t i = 1; i < sizeof...(Vals); ++i) {
-    if (prev != vals[i]) {
-      prev = vals[i];
-      count++;
+  constexpr PackedChoose() noexcept {
+    for (std::size_t n = 0; n <= N; ++n) {
+      vals_[Offset(n)] = 1;
+      for (std::size_t m = 1; m <= (n < M ? n : M); ++m) {
+        const I upper =
+            (m < n) ? static_cast<I>(vals_[Offset(n - 1) + m]) : I{0};
+        const I upper_left = vals_[Offset(n - 1) + m - 1];
+        vals_[Offset(n) + m] = static_cast<value_type>(upper + upper_left);
+      }
     }
   }
-  return count;
-}
 
-/**
- * @brief A helper class for permutation of 'C' of  `Val` in `N` spaces.
- */
-template <typename T, T Val, std::size_t N, std::size_t C>
-struct ItemCount {
   /**
-   * @brief The number of possible permutations
+   * @brief Calculate (n choose m). precondition: (n <= N && m <= M).
    */
-  static constexpr std::size_t Size() noexcept {
-    return ChooseMetaFunc<N, C>::value;
+  constexpr I Get(std::size_t n, std::size_t m) const {
+    if (m > n) {
+      return 0;
+    } else if (n > N || m > M) {
+      KOMOPERM_THROW(std::runtime_error("index out of range"));
+    }
+
+    return GetUnchecked(n, m);
   }
 
   /**
-   * @brief Get `index` for the given 'Val' permutation, and remove it from the
-   * sequence.
+   * @brief Calculate (n choose m) without any checks. precondition:
+   * (n <= N && m <= min(n, M)).
    */
-  template <std::size_t N2, std::size_t M2, typename Iterator,
-            Constraints<std::enable_if_t<N2 >= N && M2 >= C>> = nullptr>
-  static constexpr std::size_t IndexImpl(
-      const Choose<std::size_t, N2, M2>& choose, Iterator buffer) noexcept {
-    std::size_t ret = 0;
-    std::size_t remain_cnt = C;
-    Iterator out_itr = buffer;
-    for (std::size_t i = 0; i < N; ++i, ++buffer) {
-      if (*buffer == Val) {
-        remain_cnt--;
-      } else {
-        if (remain_cnt > 0) {
-          ret += choose.Get(N - i - 1, remain_cnt - 1);
-        }
-        *(out_itr++) = *buffer;
-      }
-    }
-    return ret;
+  constexpr I GetUnchecked(std::size_t n, std::size_t m) const noexcept {
+    return vals_[Offset(n) + m];
   }
 
+  /// The maximum `n` for `Get()`
+  static constexpr std::size_t MaxN() noexcept { return N; }
+  /// The maximum `m` for `Get()`
+  static constexpr std::size_t MaxM() noexcept { return M; }
+
   /**
-   * @brief Get `index`'th permutation.
-   *
-   * @param array   The output region for permutation.
-   * @param filled  If `filled[i]` is true, the slot of `array` (`array[i]`) is
-   * just ignored.
+   * @brief `true` iff the table holds (n' choose m') for all n' <= n and m' <=
+   * min(n', m)
    */
-  template <std::size_t N2, std::size_t M2, std::size_t L>
-  static constexpr void Get(const Choose<std::size_t, N2, M2>& choose,
-                            std::size_t index, Array<T, L>& array,
-                            Array<bool, L>& filled) noexcept {
-    std::size_t remain_cnt = C;
-    for (std::size_t i = 0, j = 0; j < L; ++j) {
-      if (filled[j]) {
-        continue;
-      }
-
-      if (remain_cnt > 0) {
-        if (remain_cnt >= N - i ||
-            index < choose.Get(N - i - 1, remain_cnt - 1)) {
-          array[j] = Val;
-          filled[j] = true;
-          remain_cnt--;
-        } else {
-          index -= choose.Get(N - i - 1, remain_cnt - 1);
-        }
-      }
-
-      ++i;
-    }
-
-    assert(remain_cnt == 0);
+  static constexpr bool Covers(std::size_t n, std::size_t m) noexcept {
+    return n <= N && (n < m ? n : m) <= M;
   }
 
-  /**
-   * @brief Check if the input sequence is a possible permutation.
-   */
-  template <typename Iterator>
-  static constexpr bool IsOk(Iterator begin, Iterator end) noexcept {
-    std::size_t cnt = 0;
-    for (auto itr = begin; itr != end; ++itr) {
-      if (*itr == Val) {
-        cnt++;
-      }
-    }
+ private:
+  /// The offsets of the rows in `vals_`
+  static constexpr PackedChooseRows<N, M> kRows{};
 
-    return cnt == C;
+  /// The offset of the row for `n` in `vals_`
+  static constexpr std::size_t Offset(std::size_t n) noexcept {
+    return kRows[n];
   }
+
+  /// vals_[Offset(n) + m] = nCm
+  value_type vals_[PackedChooseRows<N, M>::Calc(N + 1)]{};
 };
 
+// The out-of-class definition is required if `kRows` is odr-used in C++14.
+template <typename I, std::size_t N, std::size_t M>
+constexpr PackedChooseRows<N, M> PackedChoose<I, N, M>::kRows;
+
 /**
- * @brief A class that realizes the main features for permutation with
- * duplicates
+ * @brief A compact table of (n choose m) for n <= N whose entries are `W`
  *
- * @tparam T    The type to be placed. It should be an integer or an enum type
- * @tparam N    The number of spaces
- * @tparam M    The maximum number of same values
- * @tparam ICs  The parameter pack of ItemCount
+ * The row for `n` holds (n choose m) for m <= `RowMax(n)`, i.e. the longest
+ * prefix of the row which fits in `W`. So the rows are complete while their
+ * middle entries fit in `W`, and only the first few entries are kept beyond
+ * that. Compared to `PackedChoose<I, N, N>`, the table of a narrow `W` is
+ * much smaller, but it only serves the lookups which `Covers()`.
+ *
+ * # Example
+ *
+ * ```
+ * constexpr FittedChoose<std::size_t, std::uint8_t, 64> choose{};
+ * EXPECT_EQ(choose.Get(10, 5), 252);
+ * EXPECT_EQ(choose.Get(40, 1), 40);
+ * EXPECT_EQ(choose.RowMax(40), 1);  // (40 choose 2) > 255
+ * ```
+ *
+ * @tparam I  The result type
+ * @tparam W  The type of the entries
  */
-template <typename T, std::size_t N, std::size_t M, typename... ICs>
-class PermutationsImpl {
+template <typename I, typename W, std::size_t N>
+class FittedChoose {
+  // (n choose m) never overflows `std::uint64_t` if n <= 64.
+  static_assert(N <= 64, "N must be at most 64");
+
  public:
+  /// The type of the entries
+  using value_type = W;
+
   /**
-   * @brief The number of possible permutations
+   * @brief The largest `m` such that (n choose m') fits in `W` for all m' <=
+   * m
    */
-  constexpr std::size_t Size() const noexcept { return SizeImpl(); }
-  constexpr std::size_t Index(const T (&vals)[N]) const {
-    T tmp_vals[N]{};
-    Copy(std::begin(vals), std::end(vals), std::begin(tmp_vals));
-    return IndexImpl(tmp_vals);
+  static constexpr std::size_t RowMax(std::size_t n) noexcept {
+    std::uint64_t c = 1;
+    for (std::size_t m = 0; m < n; ++m) {
+      // (n choose m+1) = (n choose m) * (n - m) / (m + 1) without overflow
+      c = c / (m + 1) * (n - m) + c % (m + 1) * (n - m) / (m + 1);
+      if (c > std::numeric_limits<W>::max()) {
+        return m;
+      }
+    }
+    return n;
   }
 
   /**
-   * @brief Get `index` for the given permutation
+   * @brief `true` iff the table holds (n' choose m') for all n' <= n and m' <=
+   * min(n', m)
    */
-  template <typename Container>
-  constexpr std::size_t Index(const Container& vals) const {
-    if (vals.size() != N) {
-      throw std::runtime_error("The size of `vals` is illegal");
+  static constexpr bool Covers(std::size_t n, std::size_t m) noexcept {
+    if (n > N) {
+      return false;
+    }
+    for (std::size_t k = 0; k <= n; ++k) {
+      if ((k < m ? k : m) > RowMax(k)) {
+        return false;
+      }
     }
+    return true;
+  }
 
-    T tmp_vals[N]{};
-    Copy(vals.begin(), vals.end(), std::begin(tmp_vals));
-    return IndexImpl(tmp_vals);
+  constexpr FittedChoose() noexcept {
+    // The `n`th row of the Pascal triangle
+    std::uint64_t row[N + 1]{1};
+    std::size_t offset = 0;
+    for (std::size_t n = 0; n <= N; ++n) {
+      for (std::size_t m = n; m > 0; --m) {
+        row[m] += row[m - 1];
+      }
+
+      const std::size_t len = RowMax(n) + 1;
+      offsets_[n] = static_cast<Offset>(offset);
+      for (std::size_t m = 0; m < len; ++m) {
+        vals_[offset + m] = static_cast<W>(row[m]);
+      }
+      offset += len;
+    }
+    offsets_[N + 1] = static_cast<Offset>(offset);
   }
 
   /**
-   * @brief Get `index`'th permutation.
+   * @brief Calculate (n choose m). precondition: (n <= N && m <= RowMax(n)).
    */
-  constexpr Array<T, N> Get(std::size_t index) const {
-    if (index >= Size()) {
-      throw std::runtime_error("Index out of range");
+  constexpr I Get(std::size_t n, std::size_t m) const {
+    if (m > n) {
+      return 0;
+    } else if (n > N || offsets_[n] + m >= offsets_[n + 1]) {
+      KOMOPERM_THROW(std::runtime_error("index out of range"));
     }
 
-    Array<T, N> ret{};
-    Array<bool, N> filled{};
-    ConsumeValues({(ICs::Get(choose_, index % ICs::Size(), ret, filled),
-                    index /= ICs::Size())...});
-
-    return ret;
+    return GetUnchecked(n, m);
   }
 
   /**
-   * @brief Get `index`'th permutation.
+   * @brief Calculate (n choose m) without any checks. precondition:
+   * (n <= N && m <= RowMax(n)).
    */
-  constexpr auto operator[](std::size_t index) const { return Get(index); }
-
- private:
-  static constexpr std::size_t SizeImpl() noexcept {
-    std::size_t ret = 1;
-
-    // Calculate all multiplication of ICs::Size().
-    //
-    // [Notes]
-    // - As fold expression (ICs::Size() * ...) is not available in C++14, we
-    //   adopts `ConsumeValues()` to realize a loop without recursion.
-    // - In order to prevent overflow, we check it at every iteration.
-    ConsumeValues(
-        {(assert(std::numeric_limits<std::size_t>::max() / ret > ICs::Size()),
-          ret *= ICs::Size())...});
-    return ret;
+  constexpr I GetUnchecked(std::size_t n, std::size_t m) const noexcept {
+    return vals_[offsets_[n] + m];
   }
 
-  constexpr std::size_t IndexImpl(T (&tmp_vals)[N]) const {
-    if (AnyOf({!ICs::IsOk(std::begin(tmp_vals), std::end(tmp_vals))...})) {
-      throw std::runtime_error("Input is illegal");
-    }
+  /// The maximum `n` for `Get()`
+  static constexpr std::size_t MaxN() noexcept { return N; }
 
-    // The output index can be splitted as follows.
-    //
-    //     index = (index of ICs[0]) x (index of ICs[1]) x ...
-    //                   ∈                   ∈             ...
-    //             [0, ICs[0]::Size())  [0, ICs[1]::Size())   ...
-    //       x: Cartesian Product
-    std::size_t index = 0;
-    std::size_t base = 1;
-    ConsumeValues(
-        {(index += base * ICs::IndexImpl(choose_, std::begin(tmp_vals)),
-          base *= ICs::Size())...});
-    return index;
+ private:
+  /// The number of entries
+  static constexpr std::size_t Entries() noexcept {
+    std::size_t ret = 0;
+    for (std::size_t n = 0; n <= N; ++n) {
+      ret += RowMax(n) + 1;
+    }
+    return ret;
   }
 
-  Choose<std::size_t, N, M> choose_{};
+  /// The type of the offsets
+  using Offset = NarrowestUnsigned<std::size_t, Entries()>;
 
-  static_assert(SizeImpl() < std::numeric_limits<std::size_t>::max(),
-                "Total size must be finite");
+  /// The offsets of the rows in `vals_`
+  Offset offsets_[N + 2]{};
+  /// vals_[offsets_[n] + m] = nCm
+  W vals_[Entries()]{};
 };
 
 /**
- * @brief An array that summarize the input sequence `Vals...`
+ * @brief `value` is `true` iff `I` can be used as the index type.
+ *
+ * The index type must be an unsigned integer type which is not narrower than
+ * `unsigned int` (to avoid the promotion to `int`). `unsigned __int128` is also
+ * accepted if the compiler supports it.
  */
-template <typename T, std::size_t N>
-struct ItemArray {
-  T values[N];
-  std::size_t remains[N];
-  std::size_t counts[N];
-};
+template <typename I>
+struct IsIndexType
+    : std::integral_constant<bool, std::numeric_limits<I>::is_integer &&
+                                       !std::numeric_limits<I>::is_signed &&
+                                       sizeof(I) >= sizeof(unsigned int)> {};
 
 /**
- * @brief Summarize the input sequence `Vals...`
+ * @brief Calculate (N choose M) at compile time
  *
- * # Example
+ * Whereas `Choose` class may calculate the results at runtime, this meta
+ * function definitely calculates it at compile time.
  *
- * MakeItemCountsImplCalc<int, 3, 3, 4, 2, 6, 4>
- * => ItemArray{
- *   values[] = {3, 4, 2, 6},
- *   remains[] = {4, 2, 1, 0},   // The sum of counts[i+1]..counts[Max]
- *   counts[] = {2, 2, 1, 0},    // The number of values[i]
- * }
+ * @tparam I  The type of the result.
  */
-template <typename T, T... Vals>
-inline constexpr auto MakeItemCountsImplCalc() noexcept {
-  ItemArray<T, UniqueCount<T, Vals...>()> ret{};
-  T vals[sizeof...(Vals)]{Vals...};
-  bool visited[sizeof...(Vals)]{};
-
-  std::size_t remains = sizeof...(Vals);
-  std::size_t max_idx = 0;
-  for (std::size_t i = 0; i < sizeof...(Vals); ++i) {
-    if (!visited[i]) {
-      visited[i] = true;
-      ret.values[max_idx] = vals[i];
-      std::size_t count = 1;
-      for (std::size_t j = i + 1; j < sizeof...(Vals); ++j) {
-        if (vals[i] == vals[j]) {
-          count++;
-          visited[j] = true;
-        }
+template <std::size_t N, std::size_t M, typename I = std::size_t>
+struct ChooseMetaFunc
+    : std::integral_constant<I, ChooseMetaFunc<N - 1, M, I>::value +
+                                    ChooseMetaFunc<N - 1, M - 1, I>::value> {
+  static_assert(ChooseMetaFunc<N - 1, M, I>::value +
+                        ChooseMetaFunc<N - 1, M - 1, I>::value >=
+                    ChooseMetaFunc<N - 1, M, I>::value,
+                "(N choose M) must be representable by I");
+};
+
+template <std::size_t N, typename I>
+struct ChooseMetaFunc<N, 0, I> : std::integral_constant<I, 1> {};
+
+template <std::size_t M, typename I>
+struct ChooseMetaFunc<0, M, I> : std::integral_constant<I, 0> {};
+template <std::size_t N, typename I>
+struct ChooseMetaFunc<N, N, I> : std::integral_constant<I, 1> {};
+
+/**
+ * @brief floor(log2(`x`)). precondition: `x > 0`
+ */
+template <typename I>
+inline constexpr std::size_t FloorLog2(I x) noexcept {
+  std::size_t ret = 0;
+  while (x > 1) {
+    x >>= 1;
+    ret++;
+  }
+  return ret;
+}
+
+/**
+ * @brief ceil(log2(`x`)). precondition: `x > 0`
+ */
+template <typename I>
+inline constexpr std::size_t CeilLog2(I x) noexcept {
+  return x == 1 ? 0 : FloorLog2(static_cast<I>(x - 1)) + 1;
+}
+
+/**
+ * @brief The upper half of `a * b` for `Bits`-bit integers
+ *
+ * The product is calculated by the half width multiplications, or by a wider
+ * integer type if available.
+ */
+template <std::size_t Bits>
+struct MulHiImpl {
+  template <typename I>
+  static constexpr I Calc(I a, I b) noexcept {
+    constexpr std::size_t kHalf = Bits / 2;
+    constexpr I kMask = (static_cast<I>(1) << kHalf) - 1;
+
+    const I a0 = a & kMask;
+    const I a1 = a >> kHalf;
+    const I b0 = b & kMask;
+    const I b1 = b >> kHalf;
+
+    const I lo_lo = a0 * b0;
+    const I hi_lo = a1 * b0;
+    const I lo_hi = a0 * b1;
+    const I hi_hi = a1 * b1;
+    const I cross = (lo_lo >> kHalf) + (hi_lo & kMask) + lo_hi;
+    return hi_hi + (hi_lo >> kHalf) + (cross >> kHalf);
+  }
+};
+
+template <>
+struct MulHiImpl<32> {
+  template <typename I>
+  static constexpr I Calc(I a, I b) noexcept {
+    return static_cast<I>(
+        (static_cast<std::uint64_t>(a) * static_cast<std::uint64_t>(b)) >> 32);
+  }
+};
+
+#ifdef __SIZEOF_INT128__
+template <>
+struct MulHiImpl<64> {
+  template <typename I>
+  static constexpr I Calc(I a, I b) noexcept {
+    __extension__ using Uint128 = unsigned __int128;
+    return static_cast<I>((static_cast<Uint128>(a) * static_cast<Uint128>(b)) >>
+                          64);
+  }
+};
+#endif  // __SIZEOF_INT128__
+
+/**
+ * @brief The upper half of `a * b`
+ */
+template <typename I>
+inline constexpr I MulHi(I a, I b) noexcept {
+  return MulHiImpl<std::numeric_limits<I>::digits>::Calc(a, b);
+}
+
+/**
+ * @brief A uniformly random 64-bit word drawn from `urbg`
+ *
+ * If `urbg` returns 64-bit words, they are used as they are. Otherwise,
+ * `std::uniform_int_distribution` combines several outputs.
+ */
+template <typename Urbg>
+inline std::uint64_t RandomWord(Urbg& urbg) {
+  return std::uniform_int_distribution<std::uint64_t>{}(urbg);
+}
+
+/**
+ * @brief Shuffle [`first`, `first + N`) uniformly by Fisher-Yates.
+ *
+ * The random positions of consecutive steps are drawn from one random word
+ * as mixed-radix digits. The word is multiplied by each bound, and the upper
+ * half of the product is the digit (Lemire's multiply-shift). The steps are
+ * grouped while the product of their bounds is at most 2^32, and a group is
+ * redrawn only if the remaining lower half is less than 2^64 mod the product
+ * of the bounds, which removes the bias. So a redraw happens with probability
+ * less than 2^-32, and e.g. only two words are drawn if `N == 16`.
+ */
+template <std::size_t N, typename RandomIt, typename Urbg>
+inline void Shuffle(RandomIt first, Urbg& urbg) {
+  constexpr std::uint64_t kMaxProduct = std::uint64_t{1} << 32;
+  // The bounds are at least 2, so a group has at most 32 steps.
+  std::size_t picks[32]{};
+  for (std::size_t i = N; i > 1;) {
+    std::uint64_t product = i;
+    std::size_t len = 1;
+    while (len < 32 && i - len > 1 && product * (i - len) <= kMaxProduct) {
+      product *= i - len;
+      ++len;
+    }
+
+    for (;;) {
+      std::uint64_t word = RandomWord(urbg);
+      for (std::size_t j = 0; j < len; ++j) {
+        const std::uint64_t bound = i - j;
+        picks[j] = static_cast<std::size_t>(MulHi(word, bound));
+        word *= bound;
+      }
+      if (word >= product || word >= (0 - product) % product) {
+        break;
+      }
+    }
+
+    for (std::size_t j = 0; j < len; ++j) {
+      using std::swap;
+      swap(first[i - 1 - j], first[picks[j]]);
+    }
+    i -= len;
+  }
+}
+
+/**
+ * @brief A division by the constant `D` without division instructions
+ *
+ * Although compilers usually lower a division by a constant to a
+ * multiplication, it is not the case for wide types such as `unsigned
+ * __int128`. This class explicitly calculates the magic number at compile time,
+ * and divides by a multiplication, an addition, and shifts. (The branch-free
+ * algorithm in libdivide)
+ *
+ *     m = floor(2^(W + l) / D) * 2 + 1 (+ 1) - 2^W  (l = floor(log2(D)))
+ *     n / D = (((n - MulHi(m, n)) >> 1) + MulHi(m, n)) >> l
+ *
+ * If `D` is a power of two, it is just a shift.
+ */
+template <typename I, I D>
+class ConstantDivider {
+  static_assert(D > 0, "D must be positive");
+
+ public:
+  static constexpr I Div(I n) noexcept {
+    if (IsPowerOfTwo()) {
+      return n >> kShift;
+    }
+
+    const I q = MulHi(std::integral_constant<I, Magic()>::value, n);
+    return (((n - q) >> 1) + q) >> kShift;
+  }
+
+  static constexpr I Mod(I n) noexcept {
+    if (IsPowerOfTwo()) {
+      return n & (D - 1);
+    }
+    return n - Div(n) * D;
+  }
+
+ private:
+  static constexpr std::size_t kBits = std::numeric_limits<I>::digits;
+  static constexpr std::size_t kShift = FloorLog2(D);
+
+  static constexpr bool IsPowerOfTwo() noexcept { return (D & (D - 1)) == 0; }
+
+  static constexpr I Magic() noexcept {
+    if (IsPowerOfTwo()) {
+      return 0;
+    }
+
+    // quot = floor(2^(kBits + kShift) / D), rem = 2^(kBits + kShift) % D by
+    // the long division. The quotient fits in `I` because D > 2^kShift.
+    I quot = 0;
+    I rem = 0;
+    for (std::size_t i = kBits + kShift + 1; i-- > 0;) {
+      const bool carry = (rem >> (kBits - 1)) != 0;
+      rem = (rem << 1) | (i == kBits + kShift ? 1 : 0);
+      quot <<= 1;
+      if (carry || rem >= D) {
+        rem -= D;
+        quot |= 1;
+      }
+    }
+
+    I magic = quot + quot;
+    const bool rem_carry = (rem >> (kBits - 1)) != 0;
+    const I twice_rem = rem + rem;
+    if (rem_carry || twice_rem >= D) {
+      magic += 1;
+    }
+    return magic + 1;
+  }
+};
+
+/**
+ * @brief The number of set bits in `x`
+ */
+inline constexpr std::size_t PopCount(std::uint64_t x) noexcept {
+#ifdef __GNUC__
+  return static_cast<std::size_t>(__builtin_popcountll(x));
+#else   // __GNUC__
+  std::size_t ret = 0;
+  for (; x != 0; x &= x - 1) {
+    ret++;
+  }
+  return ret;
+#endif  // __GNUC__
+}
+
+/**
+ * @brief The position of the lowest set bit in `x`. precondition: `x != 0`
+ */
+inline constexpr std::size_t LowestBit(std::uint64_t x) noexcept {
+#ifdef __GNUC__
+  return static_cast<std::size_t>(__builtin_ctzll(x));
+#else   // __GNUC__
+  std::size_t ret = 0;
+  for (; (x & 1) == 0; x >>= 1) {
+    ret++;
+  }
+  return ret;
+#endif  // __GNUC__
+}
+
+/**
+ * @brief The position of the highest set bit in `x`. precondition: `x != 0`
+ */
+inline constexpr std::size_t HighestBit(std::uint64_t x) noexcept {
+#ifdef __GNUC__
+  return static_cast<std::size_t>(63 - __builtin_clzll(x));
+#else   // __GNUC__
+  return FloorLog2(x);
+#endif  // __GNUC__
+}
+
+/**
+ * @brief The lowest `n` bits. precondition: `n <= 64`
+ */
+inline constexpr std::uint64_t LowMask(std::size_t n) noexcept {
+  return n >= 64 ? ~std::uint64_t{0} : (std::uint64_t{1} << n) - 1;
+}
+
+/**
+ * @brief Gather the bits of `x` at the set bits of `mask` to the low bits.
+ * (PEXT)
+ *
+ * If BMI2 is available, a PEXT instruction is used at runtime.
+ */
+inline constexpr std::uint64_t ParallelExtract(std::uint64_t x,
+                                               std::uint64_t mask) noexcept {
+#if defined(__BMI2__) && defined(KOMOPERM_HAS_IS_CONSTANT_EVALUATED)
+  if (!__builtin_is_constant_evaluated()) {
+    return _pext_u64(x, mask);
+  }
+#endif  // defined(__BMI2__) && defined(KOMOPERM_HAS_IS_CONSTANT_EVALUATED)
+
+  // The destination of a bit is the number of the lower bits in `mask`.
+  std::uint64_t ret = 0;
+  for (x &= mask; x != 0; x &= x - 1) {
+    ret |= std::uint64_t{1} << PopCount(mask & ((x & (~x + 1)) - 1));
+  }
+  return ret;
+}
+
+/**
+ * @brief Scatter the low bits of `x` to the set bits of `mask`. (PDEP)
+ *
+ * If BMI2 is available, a PDEP instruction is used at runtime.
+ */
+inline constexpr std::uint64_t ParallelDeposit(std::uint64_t x,
+                                               std::uint64_t mask) noexcept {
+#if defined(__BMI2__) && defined(KOMOPERM_HAS_IS_CONSTANT_EVALUATED)
+  if (!__builtin_is_constant_evaluated()) {
+    return _pdep_u64(x, mask);
+  }
+#endif  // defined(__BMI2__) && defined(KOMOPERM_HAS_IS_CONSTANT_EVALUATED)
+
+  std::uint64_t ret = 0;
+  for (std::uint64_t bit = 1; mask != 0; mask &= mask - 1, bit <<= 1) {
+    if ((x & bit) != 0) {
+      ret |= mask & (~mask + 1);
+    }
+  }
+  return ret;
+}
+
+/**
+ * @brief `true` iff `SimdEqualMasks<S>()` is available.
+ */
+template <std::size_t S>
+inline constexpr bool HasSimdEqualMasks() noexcept {
+#if defined(KOMOPERM_SIMD_BYTES)
+  return S == 1 || S == 2 || S == 4;
+#else   // defined(KOMOPERM_SIMD_BYTES)
+  return false;
+#endif  // defined(KOMOPERM_SIMD_BYTES)
+}
+
+/**
+ * @brief The unsigned integer type of `S` bytes
+ */
+template <std::size_t S>
+using SimdWord = std::conditional_t<
+    S == 1, std::uint8_t,
+    std::conditional_t<S == 2, std::uint16_t, std::uint32_t>>;
+
+#if defined(KOMOPERM_SIMD_BYTES)
+/**
+ * @brief The bitmap of the `S`-byte lanes of the vector at `block` which are
+ * equal to `code`. The `i`th bit is set iff the `i`th lane is equal to `code`.
+ */
+template <std::size_t S>
+inline std::uint64_t SimdEqualBits(const unsigned char* block,
+                                   SimdWord<S> code) noexcept;
+
+#if defined(__AVX2__)
+template <>
+inline std::uint64_t SimdEqualBits<1>(const unsigned char* block,
+                                      std::uint8_t code) noexcept {
+  const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+  const __m256i eq =
+      _mm256_cmpeq_epi8(v, _mm256_set1_epi8(static_cast<char>(code)));
+  return static_cast<std::uint32_t>(_mm256_movemask_epi8(eq));
+}
+
+template <>
+inline std::uint64_t SimdEqualBits<2>(const unsigned char* block,
+                                      std::uint16_t code) noexcept {
+  const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+  const __m256i eq =
+      _mm256_cmpeq_epi16(v, _mm256_set1_epi16(static_cast<short>(code)));
+  // Narrow the 16-bit lanes to bytes. The saturation keeps -1 and 0.
+  const __m128i packed = _mm_packs_epi16(_mm256_castsi256_si128(eq),
+                                         _mm256_extracti128_si256(eq, 1));
+  return static_cast<std::uint16_t>(_mm_movemask_epi8(packed));
+}
+
+template <>
+inline std::uint64_t SimdEqualBits<4>(const unsigned char* block,
+                                      std::uint32_t code) noexcept {
+  const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+  const __m256i eq =
+      _mm256_cmpeq_epi32(v, _mm256_set1_epi32(static_cast<int>(code)));
+  return static_cast<std::uint8_t>(_mm256_movemask_ps(_mm256_castsi256_ps(eq)));
+}
+#else   // defined(__AVX2__)
+// NEON has no movemask. The matched lanes are masked by their bit weights and
+// summed horizontally instead.
+template <>
+inline std::uint64_t SimdEqualBits<1>(const unsigned char* block,
+                                      std::uint8_t code) noexcept {
+  static const std::uint8_t kWeights[16] = {1, 2, 4, 8, 16, 32, 64, 128,
+                                            1, 2, 4, 8, 16, 32, 64, 128};
+  const uint8x16_t eq = vceqq_u8(vld1q_u8(block), vdupq_n_u8(code));
+  const uint8x16_t bits = vandq_u8(eq, vld1q_u8(kWeights));
+  return std::uint64_t{vaddv_u8(vget_low_u8(bits))} |
+         (std::uint64_t{vaddv_u8(vget_high_u8(bits))} << 8);
+}
+
+template <>
+inline std::uint64_t SimdEqualBits<2>(const unsigned char* block,
+                                      std::uint16_t code) noexcept {
+  static const std::uint16_t kWeights[8] = {1, 2, 4, 8, 16, 32, 64, 128};
+  const uint16x8_t v = vreinterpretq_u16_u8(vld1q_u8(block));
+  const uint16x8_t eq = vceqq_u16(v, vdupq_n_u16(code));
+  return vaddvq_u16(vandq_u16(eq, vld1q_u16(kWeights)));
+}
+
+template <>
+inline std::uint64_t SimdEqualBits<4>(const unsigned char* block,
+                                      std::uint32_t code) noexcept {
+  static const std::uint32_t kWeights[4] = {1, 2, 4, 8};
+  const uint32x4_t v = vreinterpretq_u32_u8(vld1q_u8(block));
+  const uint32x4_t eq = vceqq_u32(v, vdupq_n_u32(code));
+  return vaddvq_u32(vandq_u32(eq, vld1q_u32(kWeights)));
+}
+#endif  // defined(__AVX2__)
+
+/**
+ * @brief Set `eq[k]` to the slots equal to `codes[k]` in `blocks[]`, which
+ * holds `S`-byte slots in `num_blocks` vectors.
+ *
+ * Each vector is compared with all codes while it is in a register, so the
+ * input is read only once. `num_blocks * KOMOPERM_SIMD_BYTES / S` must be at
+ * most 64.
+ */
+template <std::size_t S>
+inline void SimdEqualMasks(const unsigned char* blocks, std::size_t num_blocks,
+                           const SimdWord<S>* codes, std::size_t num_codes,
+                           std::uint64_t* eq) noexcept {
+  constexpr std::size_t kLanes = KOMOPERM_SIMD_BYTES / S;
+  for (std::size_t b = 0; b < num_blocks; ++b) {
+    const unsigned char* block = blocks + b * KOMOPERM_SIMD_BYTES;
+    for (std::size_t k = 0; k < num_codes; ++k) {
+      eq[k] |= SimdEqualBits<S>(block, codes[k]) << (b * kLanes);
+    }
+  }
+}
+#endif  // defined(KOMOPERM_SIMD_BYTES)
+
+/**
+ * @brief The layout of 64-bit words in which each slot occupies `B` bits
+ *
+ * The `i`th slot is stored in the bits [`(i % S) * B`, `(i % S + 1) * B`) of
+ * the `(i / S)`th word, where `S = SlotsPerWord()`. The remaining high bits of
+ * each word are unused.
+ */
+template <std::size_t B>
+struct PackedLayout {
+  static_assert(1 <= B && B <= 32, "B must be in [1, 32]");
+
+  /// The number of slots in a word
+  static constexpr std::size_t SlotsPerWord() noexcept { return 64 / B; }
+
+  /// The number of words for `n` slots
+  static constexpr std::size_t Words(std::size_t n) noexcept {
+    return (n + SlotsPerWord() - 1) / SlotsPerWord();
+  }
+
+  /// 1 in all fields of a word
+  static constexpr std::uint64_t Ones() noexcept {
+    std::uint64_t ret = 0;
+    for (std::size_t i = 0; i < SlotsPerWord(); ++i) {
+      ret |= std::uint64_t{1} << (i * B);
+    }
+    return ret;
+  }
+
+  /// `v` in all fields of a word. precondition: `v < 2^B`
+  static constexpr std::uint64_t Broadcast(std::uint64_t v) noexcept {
+    return v * Ones();
+  }
+
+  /**
+   * @brief The slots of `word` whose fields are `v`, i.e. the `i`th bit of the
+   * result is set iff the `i`th field of `word` is `v`.
+   *
+   * The fields are compared at once without carries between them: the highest
+   * bit of a field of `y` is set iff the field of `t` is zero.
+   */
+  static constexpr std::uint64_t EqualSlots(std::uint64_t word,
+                                            std::uint64_t v) noexcept {
+    const std::uint64_t low = Broadcast(LowMask(B - 1));
+    const std::uint64_t t = word ^ Broadcast(v);
+    const std::uint64_t y = ~(((t & low) + low) | t | low);
+    return ParallelExtract(y, Broadcast(std::uint64_t{1} << (B - 1)));
+  }
+
+  /// The word with the fields `v` at the set bits of `slots`
+  static constexpr std::uint64_t Fill(std::uint64_t slots,
+                                      std::uint64_t v) noexcept {
+    return ParallelDeposit(slots, Ones()) * v;
+  }
+};
+
+/**
+ * @brief The counters of the loops over the slots
+ *
+ * They are shared by all types in a thread, and `PermutationsImpl` attributes
+ * their differences to each `ItemCount`.
+ */
+struct LoopCounters {
+  /// The iterations of the loops
+  std::uint64_t iterations;
+  /// The lookups of the `Choose` table
+  std::uint64_t lookups;
+};
+
+#if defined(KOMOPERM_ENABLE_STATS)
+/// The `LoopCounters` of the calling thread
+inline LoopCounters& ThreadLoopCounters() noexcept {
+  static thread_local LoopCounters counters{};
+  return counters;
+}
+#endif  // defined(KOMOPERM_ENABLE_STATS)
+
+/// Count an iteration of a loop over the slots if `KOMOPERM_ENABLE_STATS`
+inline constexpr void CountIteration() noexcept {
+#if defined(KOMOPERM_ENABLE_STATS)
+  if (!__builtin_is_constant_evaluated()) {
+    ThreadLoopCounters().iterations++;
+  }
+#endif  // defined(KOMOPERM_ENABLE_STATS)
+}
+
+/// Count a lookup of the `Choose` table if `KOMOPERM_ENABLE_STATS`
+inline constexpr void CountLookup() noexcept {
+#if defined(KOMOPERM_ENABLE_STATS)
+  if (!__builtin_is_constant_evaluated()) {
+    ThreadLoopCounters().lookups++;
+  }
+#endif  // defined(KOMOPERM_ENABLE_STATS)
+}
+
+/**
+ * @brief Get the index of the placement of `c` of a value in `n` spaces, where
+ * the `i`th bit of `mask` is set iff the value is placed at the `i`th space.
+ *
+ * The result is the same as `CombinationIndex()`. `size` must be (n choose c),
+ * and `choose` must hold (n - 1 choose c).
+ *
+ * The index is the sum over the spaces without the value before the last one.
+ * Conversely, it is `size - 1` minus the sum over the spaces with the value,
+ * which is the index in the order the value is the largest. The shorter one of
+ * them is summed up.
+ */
+template <typename I, typename Table>
+inline constexpr I MaskCombinationIndex(const Table& choose, std::size_t n,
+                                        std::size_t c, I size,
+                                        std::uint64_t mask) noexcept {
+  if (mask == 0) {
+    return 0;
+  }
+
+  I ret = 0;
+  if (2 * c <= n) {
+    for (std::uint64_t rest = mask; rest != 0; rest &= rest - 1) {
+      CountIteration();
+      const std::size_t i = LowestBit(rest);
+      const std::size_t remain_cnt = c - PopCount(mask & LowMask(i));
+      if (n - i > remain_cnt) {
+        // The others can be placed at `i` if any of them remains.
+        CountLookup();
+        ret += choose.GetUnchecked(n - i - 1, remain_cnt);
+      }
+    }
+    return size - 1 - ret;
+  }
+
+  for (std::uint64_t rest = ~mask & LowMask(HighestBit(mask)); rest != 0;
+       rest &= rest - 1) {
+    CountIteration();
+    CountLookup();
+    const std::size_t i = LowestBit(rest);
+    const std::size_t remain_cnt = c - PopCount(mask & LowMask(i));
+    ret += choose.GetUnchecked(n - i - 1, remain_cnt - 1);
+  }
+  return ret;
+}
+
+/**
+ * @brief The inverse of `MaskCombinationIndex()`
+ */
+template <typename Table, typename I>
+inline constexpr std::uint64_t MaskCombinationGet(const Table& choose,
+                                                  std::size_t n, std::size_t c,
+                                                  I index) noexcept {
+  std::uint64_t ret = 0;
+  std::size_t remain_cnt = c;
+  for (std::size_t i = 0; remain_cnt > 0; ++i) {
+    CountIteration();
+    // If `must_fill` is false, `remain_cnt - 1 <= n - i - 1` holds.
+    const bool must_fill = remain_cnt >= n - i;
+    if (!must_fill) {
+      CountLookup();
+    }
+    const I skip =
+        must_fill ? I{0} : choose.GetUnchecked(n - i - 1, remain_cnt - 1);
+    if (must_fill || index < skip) {
+      ret |= std::uint64_t{1} << i;
+      remain_cnt--;
+    } else {
+      index -= skip;
+    }
+  }
+  return ret;
+}
+
+/**
+ * @brief Copy [in_begin, in_end)
+ *             to [out_begin, out_begin + (in_end - in_begin))
+ *
+ * As `std::copy()` is not constexpr in C++14, we prepare a similar function.
+ */
+template <typename InputIterator, typename OutputIterator>
+inline constexpr void Copy(InputIterator in_begin, InputIterator in_end,
+                           OutputIterator out_begin) noexcept {
+  while (in_begin != in_end) {
+    *(out_begin++) = *(in_begin++);
+  }
+}
+
+/**
+ * @brief `true` iff `list` has at least one `true`
+ *
+ * As `std::any_of()` is not constexpr in C++14, we prepare a similar function.
+ */
+inline constexpr bool AnyOf(std::initializer_list<bool> list) noexcept {
+  for (auto x : list) {  // NOLINT
+    if (x) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief A constexpr stable sort function.
+ *
+ * Due to the constraints of merge sorts, this function requires a temporary
+ * region which is greater than or equal to `end - begin`.
+ *
+ * The runs are merged bottom-up so that the depth of constexpr calls does not
+ * grow with the input length.
+ */
+template <typename Iterator>
+inline constexpr void MergeSort(Iterator begin, Iterator end,
+                                Iterator tmp_begin) noexcept {
+  const auto len = end - begin;
+  for (decltype(end - begin) width = 1; width < len; width *= 2) {
+    for (auto lo = decltype(end - begin){0}; lo + width < len;
+         lo += 2 * width) {
+      const auto hi = (len - lo > 2 * width) ? lo + 2 * width : len;
+
+      Iterator li = begin + lo;
+      Iterator mid = begin + lo + width;
+      Iterator ri = mid;
+      Iterator re = begin + hi;
+      Iterator oi = tmp_begin;
+      while (li < mid && ri < re) {
+        if (*ri < *li) {
+          *(oi++) = *(ri++);
+        } else {
+          *(oi++) = *(li++);
+        }
+      }
+      Copy(li, mid, oi);
+      oi += mid - li;
+      Copy(ri, re, oi);
+
+      Copy(tmp_begin, tmp_begin + (hi - lo), begin + lo);
+    }
+  }
+}
+
+/**
+ * @brief This function counts # of unique values in `Vals...`
+ */
+template <typename T, T... Vals>
+inline constexpr std::size_t UniqueCount() noexcept {
+  if (sizeof...(Vals) == 0) {
+    return 0;
+  }
+
+  T vals[sizeof...(Vals)]{Vals...};
+  T tmp[sizeof...(Vals)]{};
+
+  // Sort the input values to reduce time complexity
+  MergeSort(std::begin(vals), std::end(vals), std::begin(tmp));
+
+  T prev = vals[0];
+  std::size_t count = 1;
+  for (std::size_t i = 1; i < sizeof...(Vals); ++i) {
+    if (prev != vals[i]) {
+      prev = vals[i];
+      count++;
+    }
+  }
+  return count;
+}
+
+/**
+ * @brief (n choose m) which also accepts `n == 0`
+ */
+template <typename Table>
+inline constexpr auto ChooseOrZero(const Table& choose, std::size_t n,
+                                   std::size_t m) {
+  using Result = decltype(choose.Get(n, m));
+  return n == 0 ? static_cast<Result>(m == 0) : choose.Get(n, m);
+}
+
+/**
+ * @brief Get `rank`'th combination of `z` zeros in `n` slots in the minimal
+ * change order.
+ *
+ * The order is the Eades-McKay sequence, which is defined recursively as
+ * follows (`E(n, z)` is the sequence of the bit strings with `z` zeros).
+ *
+ *     E(n, z) = E(n-1, z-1)0, reverse(E(n-2, z-1))01, E(n-2, z)11
+ *
+ * Any two consecutive bit strings differ by moving one `1` across `0`s only.
+ * Thus, if `1` represents the other values, their relative order is kept
+ * through the sequence.
+ *
+ * @param bits  The output. `bits[i]` is `false` iff the slot is zero.
+ */
+template <typename Table, typename I, std::size_t L>
+inline constexpr void MinimalChangeCombination(const Table& choose,
+                                               std::size_t n, std::size_t z,
+                                               I rank, Array<bool, L>& bits) {
+  while (0 < z && z < n) {
+    const I a = ChooseOrZero(choose, n - 1, z - 1);
+    if (rank < a) {
+      bits[n - 1] = false;
+      n -= 1;
+      z -= 1;
+      continue;
+    }
+
+    rank -= a;
+    const I b = ChooseOrZero(choose, n - 2, z - 1);
+    bits[n - 1] = true;
+    if (rank < b) {
+      bits[n - 2] = false;
+      rank = b - 1 - rank;
+      z -= 1;
+    } else {
+      bits[n - 2] = true;
+      rank -= b;
+    }
+    n -= 2;
+  }
+
+  for (std::size_t i = 0; i < n; ++i) {
+    bits[i] = (z == 0);
+  }
+}
+
+/**
+ * @brief The inverse function of `MinimalChangeCombination()`
+ */
+template <typename Table, std::size_t L,
+          typename I = decltype(std::declval<const Table&>().Get(0, 0))>
+inline constexpr I MinimalChangeCombinationRank(const Table& choose,
+                                                std::size_t n, std::size_t z,
+                                                const Array<bool, L>& bits) {
+  // rank = reversed ? offset - (rank of the rest) : offset + (rank of the rest)
+  I offset = 0;
+  bool reversed = false;
+  while (0 < z && z < n) {
+    if (!bits[n - 1]) {
+      n -= 1;
+      z -= 1;
+      continue;
+    }
+
+    I skip = ChooseOrZero(choose, n - 1, z - 1);
+    const I b = ChooseOrZero(choose, n - 2, z - 1);
+    if (!bits[n - 2]) {
+      skip += b - 1;
+      offset = reversed ? offset - skip : offset + skip;
+      reversed = !reversed;
+      z -= 1;
+    } else {
+      skip += b;
+      offset = reversed ? offset - skip : offset + skip;
+    }
+    n -= 2;
+  }
+  return offset;
+}
+
+/**
+ * @brief A pair of positions swapped between two consecutive permutations
+ *
+ * `first == second` means that no slots are swapped.
+ */
+struct Transposition {
+  std::size_t first;
+  std::size_t second;
+};
+
+/**
+ * @brief An input iterator which visits every `stride`th element from `base`
+ *
+ * Iterators are compared by the number of steps, so the past-the-end iterator
+ * never points beyond the input.
+ */
+template <typename T>
+class StridedIterator {
+ public:
+  using iterator_category = std::input_iterator_tag;
+  using value_type = T;
+  using difference_type = std::ptrdiff_t;
+  using pointer = const T*;
+  using reference = const T&;
+
+  constexpr StridedIterator(const T* base, std::ptrdiff_t stride,
+                            std::size_t step) noexcept
+      : base_(base), stride_(stride), step_(step) {}
+
+  constexpr reference operator*() const noexcept {
+    return base_[static_cast<std::ptrdiff_t>(step_) * stride_];
+  }
+  constexpr StridedIterator& operator++() noexcept {
+    ++step_;
+    return *this;
+  }
+  constexpr bool operator==(const StridedIterator& rhs) const noexcept {
+    return step_ == rhs.step_;
+  }
+  constexpr bool operator!=(const StridedIterator& rhs) const noexcept {
+    return step_ != rhs.step_;
+  }
+
+ private:
+  const T* base_;
+  std::ptrdiff_t stride_;
+  std::size_t step_;
+};
+
+/**
+ * @brief Get the index of the placement of `c` of `val` in [`buffer`,
+ * `buffer + n`), and remove them from the sequence.
+ *
+ * It is the implementation of `ItemCount::IndexImpl()`, where `n` and `c` are
+ * compile time constants. It also accepts them at runtime for
+ * `DynamicPermutations`.
+ */
+template <typename I, typename Table, typename T, typename Iterator>
+inline constexpr I CombinationIndex(const Table& choose, T val, std::size_t n,
+                                    std::size_t c, Iterator buffer) noexcept {
+  I ret = 0;
+  std::size_t remain_cnt = c;
+  Iterator out_itr = buffer;
+  for (std::size_t i = 0; i < n; ++i, ++buffer) {
+    CountIteration();
+    if (*buffer == val) {
+      remain_cnt--;
+    } else {
+      if (remain_cnt > 0) {
+        CountLookup();
+        ret += choose.GetUnchecked(n - i - 1, remain_cnt - 1);
+      }
+      *(out_itr++) = *buffer;
+    }
+  }
+  return ret;
+}
+
+/**
+ * @brief Place `c` of `val` in `n` spaces of `array` according to `index`.
+ *
+ * It is the implementation of `ItemCount::Get()`. The slots `array[j]` with
+ * `filled[j] == true` (`j` in [0, `len`)) are skipped.
+ */
+template <typename Table, typename T, typename I, typename Values,
+          typename Flags>
+inline constexpr void CombinationGet(const Table& choose, T val, std::size_t n,
+                                     std::size_t c, I index, Values& array,
+                                     Flags& filled, std::size_t len) noexcept {
+  std::size_t remain_cnt = c;
+  for (std::size_t i = 0, j = 0; j < len; ++j) {
+    CountIteration();
+    if (filled[j]) {
+      continue;
+    }
+
+    if (remain_cnt > 0) {
+      // If `must_fill` is false, `remain_cnt - 1 <= n - i - 1` holds.
+      const bool must_fill = remain_cnt >= n - i;
+      if (!must_fill) {
+        CountLookup();
+      }
+      const I skip =
+          must_fill ? I{0} : choose.GetUnchecked(n - i - 1, remain_cnt - 1);
+      if (must_fill || index < skip) {
+        array[j] = val;
+        filled[j] = true;
+        remain_cnt--;
+      } else {
+        index -= skip;
+      }
+    }
+
+    ++i;
+  }
+
+  assert(remain_cnt == 0);
+}
+
+/**
+ * @brief Place `c` of `val` in the `n` slots of `out` whose bits are set in
+ * `rest` according to `index`, and clear their bits.
+ *
+ * It is the same as `CombinationGet()` with `filled` as a bitmask, and it only
+ * visits the remaining slots until all `c` values are placed.
+ */
+template <typename Table, typename T, typename I, typename Out>
+inline constexpr void CombinationGetMask(const Table& choose, T val,
+                                         std::size_t n, std::size_t c, I index,
+                                         Out& out,
+                                         std::uint64_t& rest) noexcept {
+  std::size_t remain_cnt = c;
+  std::uint64_t slots = rest;
+  for (std::size_t i = 0; remain_cnt > 0; ++i, slots &= slots - 1) {
+    CountIteration();
+    // If `must_fill` is false, `remain_cnt - 1 <= n - i - 1` holds.
+    const bool must_fill = remain_cnt >= n - i;
+    if (!must_fill) {
+      CountLookup();
+    }
+    const I skip =
+        must_fill ? I{0} : choose.GetUnchecked(n - i - 1, remain_cnt - 1);
+    if (must_fill || index < skip) {
+      const std::size_t j = LowestBit(slots);
+      out[j] = val;
+      rest &= ~(std::uint64_t{1} << j);
+      remain_cnt--;
+    } else {
+      index -= skip;
+    }
+  }
+}
+
+/**
+ * @brief A helper class for permutation of 'C' of  `Val` in `N` spaces.
+ *
+ * @tparam I  The index type
+ */
+template <typename T, T Val, std::size_t N, std::size_t C,
+          typename I = std::size_t>
+struct ItemCount {
+ private:
+  /// min(C, N - C). (N choose C) == (N choose kM)
+  static constexpr std::size_t kM = C < N - C ? C : N - C;
+
+  // (N choose C) is calculated by a constexpr loop rather than
+  // `ChooseMetaFunc`, which instantiates a template for every entry of the
+  // Pascal triangle.
+  static_assert(C <= N, "C must not be greater than N");
+  static_assert(SaturatedMaxChoose<I, N, kM>() < std::numeric_limits<I>::max(),
+                "(N choose C) must be representable by I");
+
+ public:
+  /**
+   * @brief The number of possible permutations
+   */
+  static constexpr I Size() noexcept { return SaturatedMaxChoose<I, N, kM>(); }
+
+  /// The value placed by this class
+  static constexpr T Value() noexcept { return Val; }
+  /// The number of spaces
+  static constexpr std::size_t Spaces() noexcept { return N; }
+  /// The number of `Val`
+  static constexpr std::size_t Count() noexcept { return C; }
+  /// The number of bits to represent an index in [0, `Size()`)
+  static constexpr std::size_t Bits() noexcept { return CeilLog2(Size()); }
+
+  /**
+   * @brief Get `index` for the given 'Val' permutation, and remove it from the
+   * sequence.
+   */
+  template <typename Table, typename Iterator,
+            Constraints<std::enable_if_t<Table::Covers(N - 1, C - 1)>> =
+                nullptr>
+  static constexpr I IndexImpl(const Table& choose, Iterator buffer) noexcept {
+    return CombinationIndex<I>(choose, Val, N, C, buffer);
+  }
+
+  /**
+   * @brief Get `index`'th permutation.
+   *
+   * @param array   The output region for permutation.
+   * @param filled  If `filled[i]` is true, the slot of `array` (`array[i]`) is
+   * just ignored.
+   */
+  template <typename Table, std::size_t L,
+            Constraints<std::enable_if_t<Table::Covers(N - 1, C - 1)>> =
+                nullptr>
+  static constexpr void Get(const Table& choose, I index, Array<T, L>& array,
+                            Array<bool, L>& filled) noexcept {
+    CombinationGet(choose, Val, N, C, index, array, filled, L);
+  }
+
+  /**
+   * @brief Check if the input sequence is a possible permutation.
+   */
+  template <typename Iterator>
+  static constexpr bool IsOk(Iterator begin, Iterator end) noexcept {
+    std::size_t cnt = 0;
+    for (auto itr = begin; itr != end; ++itr) {
+      if (*itr == Val) {
+        cnt++;
+      }
+    }
+
+    return cnt == C;
+  }
+};
+
+/// The maximum `n` of `SharedChoose`
+constexpr std::size_t kSharedChooseMaxN = 64;
+
+/**
+ * @brief The `FittedChoose` table of the entries `W` shared by all
+ * permutations with the index type `I` and at most `kSharedChooseMaxN + 1`
+ * spaces
+ *
+ * Each permutation uses the narrowest `W` which holds all the entries it
+ * looks up, so there are at most four shared tables per `I`. For
+ * `std::size_t`, the tables of 8, 16, 32 and 64-bit entries are about 0.3,
+ * 0.9, 3.9 and 17 KB, respectively . The default `W` holds the full triangle.
+ */
+template <typename I,
+          typename W = NarrowestUnsigned<
+              I, SaturatedMaxChoose<I, kSharedChooseMaxN, kSharedChooseMaxN>()>>
+struct SharedChoose {
+  static constexpr FittedChoose<I, W, kSharedChooseMaxN> kTable{};
+};
+
+// The out-of-class definition is required if `kTable` is odr-used in C++14.
+template <typename I, typename W>
+constexpr FittedChoose<I, W, kSharedChooseMaxN> SharedChoose<I, W>::kTable;
+
+/**
+ * @brief The `PackedChoose` table for permutations which do not fit in
+ * `SharedChoose`
+ */
+template <typename I, std::size_t N, std::size_t M>
+struct ShapedChoose {
+  static constexpr PackedChoose<I, N, M> kTable{};
+};
+
+// The out-of-class definition is required if `kTable` is odr-used in C++14.
+template <typename I, std::size_t N, std::size_t M>
+constexpr PackedChoose<I, N, M> ShapedChoose<I, N, M>::kTable;
+
+/**
+ * @brief The integer type that represents `T`. (`T` itself or the underlying
+ * type of the enum `T`)
+ */
+template <typename T, bool = std::is_enum<T>::value>
+struct IntegerOf {
+  using type = T;
+};
+
+template <typename T>
+struct IntegerOf<T, true> {
+  using type = std::underlying_type_t<T>;
+};
+
+/**
+ * @brief A table that maps (value - min value) to the level of the value
+ */
+template <typename L, std::size_t R>
+struct LevelTable {
+  L levels[R];
+};
+
+/**
+ * @brief The compile time calculations for `ValueLevels`
+ *
+ * They are separated from `ValueLevels` as a class must be complete to be
+ * used in the initializer of its own static member.
+ */
+template <typename T, typename... ICs>
+struct ValueLevelsBase {
+  using Integer = typename IntegerOf<T>::type;
+  using Unsigned = std::make_unsigned_t<Integer>;
+  using Level = NarrowestUnsigned<std::size_t, sizeof...(ICs)>;
+
+  /// The level of values not in `ICs...`
+  static constexpr std::size_t kNone = sizeof...(ICs);
+  /// The maximum number of entries of the lookup table
+  static constexpr std::size_t kMaxTableSize = 1024;
+
+  static constexpr Integer MinValue() noexcept {
+    const Integer vals[] = {static_cast<Integer>(ICs::Value())...};
+    Integer ret = vals[0];
+    for (auto v : vals) {  // NOLINT
+      ret = v < ret ? v : ret;
+    }
+    return ret;
+  }
+
+  /**
+   * @brief The distance from `MinValue()` to `val` in `Unsigned`
+   *
+   * The subtraction is done in `Unsigned` so that it never overflows.
+   */
+  static constexpr Unsigned Distance(T val) noexcept {
+    return static_cast<Unsigned>(
+        static_cast<Unsigned>(static_cast<Integer>(val)) -
+        static_cast<Unsigned>(MinValue()));
+  }
+
+  /// `true` iff the table lookup is used
+  static constexpr bool UseTable() noexcept {
+    const T vals[] = {ICs::Value()...};
+    for (auto v : vals) {  // NOLINT
+      if (Distance(v) >= kMaxTableSize) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  static constexpr std::size_t TableSize() noexcept {
+    std::size_t ret = 1;
+    const T vals[] = {ICs::Value()...};
+    for (auto v : vals) {  // NOLINT
+      if (UseTable() && Distance(v) >= ret) {
+        ret = static_cast<std::size_t>(Distance(v)) + 1;
+      }
+    }
+    return ret;
+  }
+
+  /// The rank of each level in the ascending order of the values
+  static constexpr LevelTable<Level, kNone> MakeRanks() noexcept {
+    LevelTable<Level, kNone> ret{};
+    const Integer vals[] = {static_cast<Integer>(ICs::Value())...};
+    for (std::size_t k = 0; k < kNone; ++k) {
+      std::size_t rank = 0;
+      for (auto v : vals) {  // NOLINT
+        rank += v < vals[k] ? 1 : 0;
+      }
+      ret.levels[k] = static_cast<Level>(rank);
+    }
+    return ret;
+  }
+
+  static constexpr LevelTable<Level, TableSize()> MakeTable() noexcept {
+    LevelTable<Level, TableSize()> ret{};
+    for (auto& l : ret.levels) {  // NOLINT
+      l = static_cast<Level>(kNone);
+    }
+    const T vals[] = {ICs::Value()...};
+    for (std::size_t k = 0; k < kNone && UseTable(); ++k) {
+      ret.levels[Distance(vals[k])] = static_cast<Level>(k);
+    }
+    return ret;
+  }
+};
+
+/**
+ * @brief Map each value of `ICs...` to its level, i.e. the position in
+ * `ICs...`
+ *
+ * If the values lie in a range narrower than `kMaxTableSize`, the level is
+ * looked up from a table indexed by the value. Otherwise, it falls back to
+ * the linear search over `ICs...`.
+ */
+template <typename T, typename... ICs>
+struct ValueLevels : ValueLevelsBase<T, ICs...> {
+  using Base = ValueLevelsBase<T, ICs...>;
+  using typename Base::Level;
+  using typename Base::Unsigned;
+  using Base::kNone;
+  using Table = LevelTable<Level, Base::TableSize()>;
+
+  /**
+   * @brief The level of `val`, or `kNone` if `val` is not in `ICs...`
+   */
+  static constexpr std::size_t Of(T val) noexcept {
+    if (Base::UseTable()) {
+      const Unsigned d = Base::Distance(val);
+      return d < Base::TableSize() ? kTable.levels[d] : kNone;
+    }
+
+    const T vals[] = {ICs::Value()...};
+    for (std::size_t k = 0; k < kNone; ++k) {
+      if (vals[k] == val) {
+        return k;
+      }
+    }
+    return kNone;
+  }
+
+  static constexpr Table kTable = Base::MakeTable();
+
+  using Ranks = LevelTable<Level, kNone>;
+
+  /// `kRanks.levels[k]` is the rank of the `k`th value in ascending order.
+  static constexpr Ranks kRanks = Base::MakeRanks();
+};
+
+// The out-of-class definition is required if `kTable` is odr-used in C++14.
+template <typename T, typename... ICs>
+constexpr typename ValueLevels<T, ICs...>::Table ValueLevels<T, ICs...>::kTable;
+
+// The out-of-class definition is required if `kRanks` is odr-used in C++14.
+template <typename T, typename... ICs>
+constexpr typename ValueLevels<T, ICs...>::Ranks ValueLevels<T, ICs...>::kRanks;
+
+/**
+ * @brief A class that realizes the main features for permutation with
+ * duplicates
+ *
+ * @tparam T    The type to be placed. It should be an integer or an enum type
+ * @tparam I    The index type. (See `IsIndexType`)
+ * @tparam N    The number of spaces
+ * @tparam M    The maximum number of same values
+ * @tparam ICs  The parameter pack of ItemCount
+ */
+template <typename T, typename I, std::size_t N, std::size_t M,
+          typename... ICs>
+class PermutationsImpl {
+  /// The number of `ItemCount`s
+  static constexpr std::size_t kLevels = sizeof...(ICs);
+
+ public:
+  /// The index type
+  using index_type = I;
+
+  /**
+   * @brief A bidirectional iterator which visits permutations in index order
+   *
+   * The iterator holds the remaining sequence of each `ItemCount`, i.e.
+   * `res_[k]` is the permutation after removing the values of `ICs[0]`, ...,
+   * `ICs[k-1]`, and `zeros_[k]` is the positions of `ICs[k]::Value()` in
+   * `res_[k]`. Incrementing the index advances `res_[0]` to the next
+   * combination, and `res_[k+1]` only when `res_[k]` wraps around. As the
+   * values of the other `ItemCount`s keep their relative order, only the
+   * moved slots are rewritten. It costs O(1) in most steps, and O(N) when
+   * the trailing run of a value moves or a carry occurs.
+   */
+  class Iterator {
+   public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = Array<T, N>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const Array<T, N>*;
+    using reference = const Array<T, N>&;
+
+    /// Construct an iterator that points to the first permutation.
+    constexpr Iterator() noexcept { SetFirst(); }
+
+    constexpr reference operator*() const noexcept { return res_[0]; }
+    constexpr pointer operator->() const noexcept { return &res_[0]; }
+
+    constexpr Iterator& operator++() noexcept {
+      if (++index_ >= SizeImpl()) {
+        return *this;
+      }
+
+      std::size_t k = 0;
+      while (!Advance(k)) {
+        ++k;
+      }
+      while (k-- > 0) {
+        ResetFirst(k);
+      }
+      return *this;
+    }
+
+    constexpr Iterator operator++(int) noexcept {
+      Iterator ret = *this;
+      ++*this;
+      return ret;
+    }
+
+    constexpr Iterator& operator--() noexcept {
+      if (index_-- >= SizeImpl()) {
+        // `end()` does not hold any permutation.
+        SetLast();
+        return *this;
+      }
+
+      std::size_t k = 0;
+      while (!Retreat(k)) {
+        ++k;
+      }
+      while (k-- > 0) {
+        ResetLast(k);
+      }
+      return *this;
+    }
+
+    constexpr Iterator operator--(int) noexcept {
+      Iterator ret = *this;
+      --*this;
+      return ret;
+    }
+
+    /// The index of the current permutation
+    constexpr I Index() const noexcept { return index_; }
+
+    constexpr bool operator==(const Iterator& rhs) const noexcept {
+      return index_ == rhs.index_;
+    }
+    constexpr bool operator!=(const Iterator& rhs) const noexcept {
+      return !(*this == rhs);
+    }
+
+   private:
+    friend class PermutationsImpl;
+
+    /// A tag type to construct a past-the-end iterator without any permutation
+    struct EndTag {};
+
+    explicit constexpr Iterator(EndTag) noexcept : index_{SizeImpl()} {}
+
+    /// Construct an iterator that points to `perm`, whose index is `index`.
+    constexpr Iterator(I index, const Array<T, N>& perm) noexcept
+        : index_{index} {
+      res_[0] = perm;
+      for (std::size_t k = 0; k < kLevels; ++k) {
+        for (std::size_t i = 0, j = 0, l = 0; i < LevelSpaces(k); ++i) {
+          if (res_[k][i] == LevelValue(k)) {
+            zeros_[k][j++] = i;
+          } else {
+            res_[k + 1][l++] = res_[k][i];
+          }
+        }
+      }
+    }
+
+    /// Set `res_` and `zeros_` to the first permutation
+    constexpr void SetFirst() noexcept {
+      const std::size_t last = kLevels - 1;
+      for (std::size_t i = 0; i < LevelSpaces(last); ++i) {
+        res_[last][i] = LevelValue(last);
+        zeros_[last][i] = i;
+      }
+      for (std::size_t k = last; k-- > 0;) {
+        ResetFirst(k);
+      }
+    }
+
+    /// Set `res_` and `zeros_` to the last permutation
+    constexpr void SetLast() noexcept {
+      SetFirst();
+      for (std::size_t k = kLevels - 1; k-- > 0;) {
+        ResetLast(k);
+      }
+    }
+
+    /// Put all `LevelValue(k)` at the beginning of `res_[k]`
+    constexpr void ResetFirst(std::size_t k) noexcept {
+      const std::size_t n = LevelSpaces(k);
+      const std::size_t c = LevelCount(k);
+      for (std::size_t i = 0; i < c; ++i) {
+        res_[k][i] = LevelValue(k);
+        zeros_[k][i] = i;
+      }
+      for (std::size_t i = c; i < n; ++i) {
+        res_[k][i] = res_[k + 1][i - c];
+      }
+    }
+
+    /// Put all `LevelValue(k)` at the end of `res_[k]`
+    constexpr void ResetLast(std::size_t k) noexcept {
+      const std::size_t n = LevelSpaces(k);
+      const std::size_t c = LevelCount(k);
+      for (std::size_t i = 0; i < n - c; ++i) {
+        res_[k][i] = res_[k + 1][i];
+      }
+      for (std::size_t i = 0; i < c; ++i) {
+        res_[k][n - c + i] = LevelValue(k);
+        zeros_[k][i] = n - c + i;
+      }
+    }
+
+    /**
+     * @brief Move `res_[k]` to the next combination.
+     *
+     * @return `false` iff `res_[k]` is already the last combination. In this
+     * case, `res_[k]` is not changed.
+     */
+    constexpr bool Advance(std::size_t k) noexcept {
+      const std::size_t n = LevelSpaces(k);
+      const std::size_t c = LevelCount(k);
+      auto& s = res_[k];
+      auto& z = zeros_[k];
+
+      // Skip the trailing run of the value, and find the rightmost value which
+      // is followed by another value.
+      std::size_t i = c;
+      std::size_t tail = n;
+      while (i > 0 && z[i - 1] + 1 == tail) {
+        --i;
+        --tail;
+      }
+      if (i-- == 0) {
+        return false;
+      }
+
+      // s[p..n) = (v, r[q], ..., r[q+ones-1], v, ..., v)
+      //        -> (r[q], v, ..., v, r[q+1], ..., r[q+ones-1])
+      const auto& r = res_[k + 1];
+      const std::size_t p = z[i];
+      const std::size_t q = p - i;
+      const std::size_t trailing = c - 1 - i;
+      const std::size_t ones = tail - p - 1;
+      s[p] = r[q];
+      for (std::size_t j = 0; j <= trailing; ++j) {
+        s[p + 1 + j] = LevelValue(k);
+        z[i + j] = p + 1 + j;
+      }
+      if (trailing > 0) {
+        for (std::size_t j = 1; j < ones; ++j) {
+          s[p + 1 + trailing + j] = r[q + j];
+        }
+      }
+      return true;
+    }
+
+    /**
+     * @brief Move `res_[k]` to the previous combination.
+     *
+     * @return `false` iff `res_[k]` is already the first combination. In this
+     * case, `res_[k]` is not changed.
+     */
+    constexpr bool Retreat(std::size_t k) noexcept {
+      const std::size_t n = LevelSpaces(k);
+      const std::size_t c = LevelCount(k);
+      auto& s = res_[k];
+      auto& z = zeros_[k];
+
+      // Find the beginning of the last run of the value.
+      std::size_t i = c - 1;
+      while (i > 0 && z[i - 1] + 1 == z[i]) {
+        --i;
+      }
+      if (z[i] == 0) {
+        return false;
+      }
+
+      // s[p..n) = (r[q], v, ..., v, r[q+1], ..., r[q+ones])
+      //        -> (v, r[q], ..., r[q+ones], v, ..., v)
+      const auto& r = res_[k + 1];
+      const std::size_t p = z[i] - 1;
+      const std::size_t q = p - i;
+      const std::size_t run = c - i;
+      const std::size_t ones = n - z[c - 1] - 1;
+      s[p] = LevelValue(k);
+      z[i] = p;
+      if (run > 1) {
+        for (std::size_t j = 0; j <= ones; ++j) {
+          s[p + 1 + j] = r[q + j];
+        }
+        for (std::size_t j = 1; j < run; ++j) {
+          s[p + 1 + ones + j] = LevelValue(k);
+          z[i + j] = p + 1 + ones + j;
+        }
+      } else {
+        s[p + 1] = r[q];
+      }
+      return true;
+    }
+
+    /// The index of the current permutation
+    I index_{0};
+    /// res_[k] = The remaining sequence for `ICs[k]`
+    Array<T, N> res_[kLevels]{};
+    /// zeros_[k] = The positions of `LevelValue(k)` in `res_[k]`
+    std::size_t zeros_[kLevels][M]{};
+  };
+
+  /**
+   * @brief The number of spaces
+   */
+  static constexpr std::size_t Spaces() noexcept { return N; }
+
+  /**
+   * @brief The distinct values in the order of the digits of the index, from
+   * the lowest one
+   *
+   * The order is decided by the input sequence and `ItemOrder`, and tables
+   * indexed by `Index()` depend on it.
+   */
+  static constexpr Array<T, kLevels> DigitValues() noexcept {
+    return Array<T, kLevels>{{ICs::Value()...}};
+  }
+
+  /**
+   * @brief The number of possible permutations
+   */
+  constexpr I Size() const noexcept { return SizeImpl(); }
+  constexpr I Index(const T (&vals)[N]) const {
+    T tmp_vals[N]{};
+    Copy(std::begin(vals), std::end(vals), std::begin(tmp_vals));
+    return IndexImpl(tmp_vals);
+  }
+
+  /**
+   * @brief Get `index` for the given permutation
+   */
+  template <typename Container>
+  constexpr I Index(const Container& vals) const {
+    if (vals.size() != N) {
+      CountIndex(false);
+      KOMOPERM_THROW(std::runtime_error("The size of `vals` is illegal"));
+    }
+
+    T tmp_vals[N]{};
+    Copy(vals.begin(), vals.end(), std::begin(tmp_vals));
+    return IndexImpl(tmp_vals);
+  }
+
+  /**
+   * @brief Get `index` for the permutation in [`first`, `last`).
+   *
+   * If `N <= 64`, each value is read once into the slot masks, and the input
+   * is neither copied nor modified. So it accepts any input range, e.g. a
+   * column of a board or a field of a struct-of-arrays, without gathering it.
+   * Otherwise, the input is copied as `Index(vals)` does.
+   */
+  template <typename InputIt>
+  constexpr I Index(InputIt first, InputIt last) const {
+    const Result<I> ret = TryIndex(first, last);
+    if (ret.error == Error::kIllegalSize) {
+      KOMOPERM_THROW(std::runtime_error("The size of `vals` is illegal"));
+    } else if (!ret.ok()) {
+      KOMOPERM_THROW(std::runtime_error("Input is illegal"));
+    }
+    return ret.value;
+  }
+
+  /**
+   * @brief Get `index` for the permutation `first[0]`, `first[stride]`, ...,
+   * `first[(N - 1) * stride]`.
+   */
+  constexpr I IndexStrided(const T* first, std::ptrdiff_t stride) const {
+    return Index(StridedIterator<T>{first, stride, 0},
+                 StridedIterator<T>{first, stride, N});
+  }
+
+  /**
+   * @brief Get `index` for the given permutation without validation
+   *
+   * `vals` must be a possible permutation, e.g. a result of `Get()`. It is
+   * faster than `Index()` for trusted inputs, but the result is unspecified
+   * (and `assert()` fails in debug builds) for illegal inputs.
+   */
+  constexpr I IndexUnchecked(const T (&vals)[N]) const noexcept {
+    CountIndex(true);
+    T tmp_vals[N]{};
+    Copy(std::begin(vals), std::end(vals), std::begin(tmp_vals));
+    return IndexUncheckedImpl(tmp_vals);
+  }
+
+  /**
+   * @brief Get `index` for the given permutation without validation
+   *
+   * `vals.size()` must be `N`. See the above overload for details.
+   */
+  template <typename Container>
+  constexpr I IndexUnchecked(const Container& vals) const noexcept {
+    assert(vals.size() == N);
+    CountIndex(true);
+
+    T tmp_vals[N]{};
+    Copy(vals.begin(), vals.end(), std::begin(tmp_vals));
+    return IndexUncheckedImpl(tmp_vals);
+  }
+
+  /**
+   * @brief Get `index`'th permutation.
+   */
+  constexpr Array<T, N> Get(I index) const {
+    if (index >= Size()) {
+      CountGet(false);
+      KOMOPERM_THROW(std::runtime_error("Index out of range"));
+    }
+
+    return GetUnchecked(index);
+  }
+
+  /**
+   * @brief Get `index`'th permutation.
+   */
+  constexpr auto operator[](I index) const { return Get(index); }
+
+  /**
+   * @brief Get `index`'th permutation without validation
+   *
+   * `index` must be less than `Size()`. Otherwise, the result is unspecified
+   * (and `assert()` fails in debug builds).
+   */
+  constexpr Array<T, N> GetUnchecked(I index) const noexcept {
+    assert(index < Size());
+    CountGet(true);
+    return UseMaskBackend() ? MaskGetImpl(index) : GetImpl(index);
+  }
+
+  /**
+   * @brief Write `index`'th permutation to [`out`, `out + N`), and return
+   * `out + N`.
+   *
+   * It is the same as `Get()`, but the values are written directly into the
+   * caller's memory, e.g. a row of a board in a larger struct, without
+   * building an `Array<T, N>`.
+   */
+  constexpr T* GetInto(I index, T* out) const {
+    if (index >= Size()) {
+      CountGet(false);
+      KOMOPERM_THROW(std::runtime_error("Index out of range"));
+    }
+
+    CountGet(true);
+    GetIntoImpl(index, out);
+    return out + N;
+  }
+
+  /**
+   * @brief Write `index`'th permutation to `out`, and return the iterator past
+   * the last written value.
+   *
+   * A random access iterator is written in place. Otherwise, the values are
+   * built in a local buffer of `N` values, and written to `out` in order.
+   */
+  template <typename OutputIt>
+  constexpr OutputIt GetInto(I index, OutputIt out) const {
+    if (index >= Size()) {
+      CountGet(false);
+      KOMOPERM_THROW(std::runtime_error("Index out of range"));
+    }
+
+    CountGet(true);
+    using Category = typename std::iterator_traits<OutputIt>::iterator_category;
+    return GetIntoIterator(
+        index, out,
+        std::is_base_of<std::random_access_iterator_tag, Category>{});
+  }
+
+  /**
+   * @brief Get the permutation of `index % Size()`, and replace `index` with
+   * `index / Size()`.
+   *
+   * The digits are decoded by the same chain of constant divisions as `Get()`,
+   * and the quotient is what remains. So an index over the product of several
+   * permutations is decoded by a single chain. (See `ProductPermutations`)
+   */
+  constexpr Array<T, N> GetAndDivide(I& index) const noexcept {
+    CountGet(true);
+    return UseMaskBackend() ? MaskGetImpl(index) : GetImpl(index);
+  }
+
+  /**
+   * @brief Get `index` for the given permutation, or `Error::kIllegalInput` if
+   * `vals` is not a possible permutation.
+   *
+   * It is the same as `Index()` except that it never throws.
+   */
+  constexpr Result<I> TryIndex(const T (&vals)[N]) const noexcept {
+    T tmp_vals[N]{};
+    Copy(std::begin(vals), std::end(vals), std::begin(tmp_vals));
+    return TryIndexImpl(tmp_vals);
+  }
+
+  /**
+   * @brief Get `index` for the given permutation, or `Error::kIllegalSize` if
+   * `vals.size()` is not `N`.
+   */
+  template <typename Container>
+  constexpr Result<I> TryIndex(const Container& vals) const noexcept {
+    if (vals.size() != N) {
+      CountIndex(false);
+      return Result<I>{0, Error::kIllegalSize};
+    }
+
+    T tmp_vals[N]{};
+    Copy(vals.begin(), vals.end(), std::begin(tmp_vals));
+    return TryIndexImpl(tmp_vals);
+  }
+
+  /**
+   * @brief Get `index` for the permutation in [`first`, `last`), or the reason
+   * why it is not a possible permutation.
+   */
+  template <typename InputIt>
+  constexpr Result<I> TryIndex(InputIt first, InputIt last) const noexcept {
+    if (N > 64) {
+      T tmp_vals[N]{};
+      std::size_t i = 0;
+      for (; first != last; ++first, ++i) {
+        if (i == N) {
+          CountIndex(false);
+          return Result<I>{0, Error::kIllegalSize};
+        }
+        tmp_vals[i] = *first;
+      }
+      if (i != N) {
+        CountIndex(false);
+        return Result<I>{0, Error::kIllegalSize};
+      }
+      return TryIndexImpl(tmp_vals);
+    }
+
+    std::uint64_t eq[kLevels]{};
+    bool ok = true;
+    std::size_t i = 0;
+    for (; first != last; ++first, ++i) {
+      if (i == N) {
+        CountIndex(false);
+        return Result<I>{0, Error::kIllegalSize};
+      }
+      const std::size_t level = Levels::Of(*first);
+      if (level == Levels::kNone) {
+        ok = false;
+      } else {
+        eq[level] |= std::uint64_t{1} << (i % 64);
+      }
+    }
+    if (i != N) {
+      CountIndex(false);
+      return Result<I>{0, Error::kIllegalSize};
+    }
+
+    for (std::size_t k = 0; k < kLevels; ++k) {
+      ok = ok && PopCount(eq[k]) == LevelCount(k);
+    }
+    CountIndex(ok);
+    return ok ? Result<I>{MaskIndexImpl(eq), Error::kOk}
+              : Result<I>{0, Error::kIllegalInput};
+  }
+
+  /**
+   * @brief Get `index`'th permutation, or `Error::kOutOfRange` if `index` is
+   * not less than `Size()`.
+   *
+   * It is the same as `Get()` except that it never throws.
+   */
+  constexpr Result<Array<T, N>> TryGet(I index) const noexcept {
+    if (index >= Size()) {
+      CountGet(false);
+      return Result<Array<T, N>>{Array<T, N>{}, Error::kOutOfRange};
+    }
+    return Result<Array<T, N>>{GetUnchecked(index), Error::kOk};
+  }
+
+  /**
+   * @brief The counters of this type in the calling thread
+   *
+   * They are collected only if `KOMOPERM_ENABLE_STATS` is defined, and stay
+   * zero otherwise. Assign `{}` to reset them.
+   */
+  static Stats<kLevels>& Counters() noexcept {
+    static thread_local Stats<kLevels> stats{};
+    return stats;
+  }
+
+  /**
+   * @brief The number of bits of the padded index
+   *
+   * In the padded index, the index of each `ItemCount` occupies its own
+   * `ICs::Bits()` bits. The padded index space is sparse, but it can be decoded
+   * only by shifts and masks. (See `PaddedGet()`)
+   */
+  static constexpr std::size_t PaddedBits() noexcept {
+    std::size_t ret = 0;
+    ConsumeValues({(ret += ICs::Bits())...});
+    return ret;
+  }
+
+  /**
+   * @brief The size of the padded index space. All padded indices are less than
+   * it.
+   */
+  constexpr I PaddedSize() const noexcept {
+    static_assert(PaddedBits() < std::numeric_limits<I>::digits,
+                  "The padded index must be representable by I");
+    return static_cast<I>(1) << PaddedBits();
+  }
+
+  /**
+   * @brief Get the padded index for the given permutation
+   */
+  constexpr I PaddedIndex(const T (&vals)[N]) const {
+    T tmp_vals[N]{};
+    Copy(std::begin(vals), std::end(vals), std::begin(tmp_vals));
+    return PaddedIndexImpl(tmp_vals);
+  }
+
+  /**
+   * @brief Get the padded index for the given permutation
+   */
+  template <typename Container>
+  constexpr I PaddedIndex(const Container& vals) const {
+    if (vals.size() != N) {
+      KOMOPERM_THROW(std::runtime_error("The size of `vals` is illegal"));
+    }
+
+    T tmp_vals[N]{};
+    Copy(vals.begin(), vals.end(), std::begin(tmp_vals));
+    return PaddedIndexImpl(tmp_vals);
+  }
+
+  /**
+   * @brief Get the permutation for the padded index `padded`.
+   *
+   * It throws if `padded` is not a result of `PaddedIndex()`, i.e. a field of
+   * an `ItemCount` is out of range.
+   */
+  constexpr Array<T, N> PaddedGet(I padded) const {
+    if (padded >= PaddedSize()) {
+      KOMOPERM_THROW(std::runtime_error("Index out of range"));
+    }
+
+    Array<T, N> ret{};
+    Array<bool, N> filled{};
+    ConsumeValues({(PaddedGetField<ICs>(padded, ret, filled),
+                    padded >>= ICs::Bits())...});
+
+    return ret;
+  }
+
+  /**
+   * @brief `true` iff `Index()` and `Get()` use the bitmask backend.
+   *
+   * If `N <= 64` and BMI2 is available, the slots of each value are held in a
+   * 64-bit mask instead of the compacted array and `filled[]`, and they are
+   * compressed and expanded by PEXT/PDEP. Otherwise, `ItemCount::IndexImpl()`
+   * and `ItemCount::Get()` are used. Both return the same results.
+   */
+  static constexpr bool UseMaskBackend() noexcept {
+#if defined(__BMI2__) && defined(KOMOPERM_HAS_IS_CONSTANT_EVALUATED)
+    return N <= 64;
+#else   // defined(__BMI2__) && defined(KOMOPERM_HAS_IS_CONSTANT_EVALUATED)
+    return false;
+#endif  // defined(__BMI2__) && defined(KOMOPERM_HAS_IS_CONSTANT_EVALUATED)
+  }
+
+  /**
+   * @brief `true` iff `Index()` compares the input with all values by SIMD
+   * instructions.
+   *
+   * If `N <= 64`, `T` is 1, 2 or 4 bytes, and AVX2 or AArch64 NEON is
+   * available, the slot masks of all values are built by vector compares and
+   * ranked by the bitmask backend, even without BMI2. Otherwise, `Index()` is
+   * the same as `UseMaskBackend()` tells. Both return the same results.
+   */
+  static constexpr bool UseSimdIndex() noexcept {
+    return N <= 64 && HasSimdEqualMasks<sizeof(T)>();
+  }
+
+  /**
+   * @brief The number of 64-bit words for a permutation packed by `B` bits
+   * per slot. (See `PackedLayout`)
+   */
+  template <std::size_t B>
+  static constexpr std::size_t PackedWords() noexcept {
+    return PackedLayout<B>::Words(N);
+  }
+
+  /**
+   * @brief Get the index for the permutation packed in `words`.
+   *
+   * The `i`th slot holds the value whose integer representation is stored in
+   * the `i`th `B`-bit field of `words`. (See `PackedLayout`) For each value,
+   * the fields of a word are compared at once, and the matched slots are
+   * gathered into a bit mask. So the permutation is never unpacked into an
+   * array. The unused bits of `words` are ignored.
+   *
+   * It is available if `N <= 64` and all values are in [0, 2^`B`).
+   */
+  template <std::size_t B>
+  constexpr I IndexPacked(
+      const std::uint64_t (&words)[PackedLayout<B>::Words(N)]) const {
+    static_assert(N <= 64, "The packed representation supports N <= 64");
+    static_assert(AreCodesPackable<B>(),
+                  "All values must be representable by B bits");
+
+    constexpr std::size_t kSlots = PackedLayout<B>::SlotsPerWord();
+    std::uint64_t eq[kLevels]{};
+    for (std::size_t w = 0; w < PackedLayout<B>::Words(N); ++w) {
+      for (std::size_t k = 0; k < kLevels; ++k) {
+        eq[k] |= PackedLayout<B>::EqualSlots(words[w], Code(k)) << (w * kSlots);
+      }
+    }
+
+    // As the values are distinct, `eq[k]` are disjoint. So if all counts are
+    // correct, every slot has a value.
+    for (std::size_t k = 0; k < kLevels; ++k) {
+      eq[k] &= LowMask(N);
+      if (PopCount(eq[k]) != LevelCount(k)) {
+        KOMOPERM_THROW(std::runtime_error("Input is illegal"));
+      }
+    }
+
+    return MaskIndexImpl(eq);
+  }
+
+  /**
+   * @brief Get the index for the permutation packed in a word.
+   */
+  template <std::size_t B, Constraints<std::enable_if_t<
+                               PackedLayout<B>::Words(N) == 1>> = nullptr>
+  constexpr I IndexPacked(std::uint64_t word) const {
+    const std::uint64_t words[1] = {word};
+    return IndexPacked<B>(words);
+  }
+
+  /**
+   * @brief Write `index`'th permutation to `words` packed by `B` bits per slot.
+   *
+   * The positions of each value are decoded into a bit mask, and then the
+   * value is written to all of them at once. The unused bits are zero.
+   */
+  template <std::size_t B>
+  constexpr void GetPacked(
+      I index, std::uint64_t (&words)[PackedLayout<B>::Words(N)]) const {
+    static_assert(N <= 64, "The packed representation supports N <= 64");
+    static_assert(AreCodesPackable<B>(),
+                  "All values must be representable by B bits");
+    if (index >= Size()) {
+      KOMOPERM_THROW(std::runtime_error("Index out of range"));
+    }
+
+    for (auto& word : words) {  // NOLINT
+      word = 0;
+    }
+    std::uint64_t rest = LowMask(N);
+    std::size_t k = 0;
+    ConsumeValues({(PlacePacked<B>(k++,
+                                   MaskCombinationGet(Table(), ICs::Spaces(),
+                                                      ICs::Count(),
+                                                      Divider<ICs>::Mod(index)),
+                                   rest, words),
+                    index = Divider<ICs>::Div(index))...});
+  }
+
+  /**
+   * @brief Get `index`'th permutation packed in a word.
+   */
+  template <std::size_t B, Constraints<std::enable_if_t<
+                               PackedLayout<B>::Words(N) == 1>> = nullptr>
+  constexpr std::uint64_t GetPacked(I index) const {
+    std::uint64_t words[1]{};
+    GetPacked<B>(index, words);
+    return words[0];
+  }
+
+  /**
+   * @brief Get indices for `count` permutations at once.
+   *
+   * `in` must point to `count * N` values, where the `i`th permutation is
+   * stored in [`in + i * N`, `in + (i + 1) * N`). The index of the `i`th
+   * permutation is written to `out[i]`.
+   *
+   * The results are the same as `Index()` for each row, and so is the speed.
+   * The permutations are processed by blocks of `kBatchBlockSize` rows. If
+   * `N <= 64`, the slot masks of all the rows in a block are built first, and
+   * then each `ItemCount` ranks all the rows before moving to the next one.
+   * Otherwise, each row is validated and ranked as `Index()`.
+   */
+  constexpr void IndexBatch(const T* in, std::size_t count,
+                            I* out) const {
+    for (std::size_t offset = 0; offset < count; offset += kBatchBlockSize) {
+      const std::size_t len = BlockLength(count - offset);
+      if (N <= 64) {
+        std::uint64_t eq[kBatchBlockSize][kLevels]{};
+        for (std::size_t r = 0; r < len; ++r) {
+          if (!SlotMasks(in + (offset + r) * N, eq[r])) {
+            KOMOPERM_THROW(std::runtime_error("Input is illegal"));
+          }
+        }
+        MaskIndexBlock(eq, len, out + offset);
+        continue;
+      }
+
+      for (std::size_t r = 0; r < len; ++r) {
+        T tmp_vals[N]{};
+        const T* row = in + (offset + r) * N;
+        Copy(row, row + N, std::begin(tmp_vals));
+        if (!IsValid(tmp_vals)) {
+          KOMOPERM_THROW(std::runtime_error("Input is illegal"));
+        }
+        out[offset + r] = IndexUncheckedImpl(tmp_vals);
+      }
+    }
+  }
+
+  /**
+   * @brief Get `idx[i]`'th permutation for `i` in [0, `count`) at once.
+   *
+   * The `i`th permutation is written to [`out + i * N`, `out + (i + 1) * N`).
+   * The results are the same as `GetInto()` for each index, and so is the
+   * speed. Similarly to `IndexBatch()`, the indices are processed block by
+   * block. The digits of all the rows in a block are decoded by each
+   * `ICs::Size()` in turn, and then each row is placed as `GetInto()` does.
+   */
+  constexpr void GetBatch(const I* idx, std::size_t count,
+                          T* out) const {
+    for (std::size_t offset = 0; offset < count; offset += kBatchBlockSize) {
+      const std::size_t len = BlockLength(count - offset);
+      I indices[kBatchBlockSize]{};
+      for (std::size_t r = 0; r < len; ++r) {
+        if (idx[offset + r] >= Size()) {
+          KOMOPERM_THROW(std::runtime_error("Index out of range"));
+        }
+        indices[r] = idx[offset + r];
+      }
+
+      I digits[kBatchBlockSize][kLevels]{};
+      std::size_t k = 0;
+      // The last `ItemCount` fills all the remaining slots without its digit.
+      ConsumeValues(
+          {(k + 1 < kLevels ? DivideBlock<ICs>(indices, len, k, digits)
+                            : void(),
+            ++k)...});
+
+      for (std::size_t r = 0; r < len; ++r) {
+        GetDigitsImpl(digits[r], out + (offset + r) * N);
+      }
+    }
+  }
+
+  /**
+   * @brief Get a uniformly random permutation.
+   *
+   * `urbg` is a uniform random bit generator, e.g. `std::mt19937_64`. The
+   * permutation is drawn by shuffling the input sequence, so it involves
+   * neither an index nor the `Choose` table, and is unbiased for any `I`.
+   */
+  template <typename Urbg>
+  Array<T, N> Sample(Urbg& urbg) const {
+    Array<T, N> ret = Grouped();
+    Shuffle<N>(ret.data(), urbg);
+    return ret;
+  }
+
+  /**
+   * @brief Get `count` uniformly random permutations at once.
+   *
+   * The `i`th permutation is written to [`out + i * N`, `out + (i + 1) * N`).
+   * Each row is shuffled from the previous one, which is as uniform as the
+   * input sequence because Fisher-Yates does not depend on the initial order.
+   */
+  template <typename Urbg>
+  void SampleBatch(Urbg& urbg, std::size_t count, T* out) const {
+    Array<T, N> perm = Grouped();
+    for (std::size_t r = 0; r < count; ++r) {
+      Shuffle<N>(perm.data(), urbg);
+      Copy(perm.begin(), perm.end(), out + r * N);
+    }
+  }
+
+  /**
+   * @brief An iterator to the first permutation (`Get(0)`)
+   */
+  constexpr Iterator begin() const noexcept { return Iterator{}; }
+
+  /**
+   * @brief A past-the-end iterator. (`Get(Size())`)
+   */
+  constexpr Iterator end() const noexcept {
+    return Iterator{typename Iterator::EndTag{}};
+  }
+
+  /**
+   * @brief An iterator to `index`'th permutation
+   *
+   * It is useful to start iteration from the middle of the permutations. The
+   * cost of the construction is similar to `Get()`. If `index == Size()`, it
+   * returns `end()`.
+   */
+  constexpr Iterator At(I index) const {
+    if (index == Size()) {
+      return end();
+    }
+    return Iterator{index, Get(index)};
+  }
+
+  /**
+   * @brief A range of permutations whose indices are in [`first`, `last`)
+   */
+  class SubRange {
+   public:
+    constexpr SubRange(Iterator first, Iterator last) noexcept
+        : first_{first}, last_{last} {}
+
+    constexpr Iterator begin() const noexcept { return first_; }
+    constexpr Iterator end() const noexcept { return last_; }
+    constexpr I size() const noexcept {
+      return last_.Index() - first_.Index();
+    }
+    constexpr bool empty() const noexcept { return size() == 0; }
+
+   private:
+    Iterator first_;
+    Iterator last_;
+  };
+
+  /**
+   * @brief Permutations whose indices are in [`first`, `last`)
+   */
+  constexpr SubRange Slice(I first, I last) const {
+    if (first > last || last > Size()) {
+      KOMOPERM_THROW(std::runtime_error("Index out of range"));
+    }
+    return SubRange{At(first), At(last)};
+  }
+
+  /**
+   * @brief The `i`th range when all permutations are split into `parts`
+   * ranges.
+   *
+   * The ranges are disjoint, cover [0, `Size()`), and their sizes differ by at
+   * most one. As each range has its own iterators, the ranges can be
+   * enumerated independently in any executors. (e.g. one range per thread)
+   */
+  constexpr SubRange Split(std::size_t parts, std::size_t i) const {
+    if (parts == 0 || i >= parts) {
+      KOMOPERM_THROW(std::runtime_error("Index out of range"));
+    }
+
+    const I quot = Size() / parts;
+    const I rem = Size() % parts;
+    const I first = static_cast<I>(i) * quot + (i < rem ? i : rem);
+    const I last = first + quot + (i < rem ? 1 : 0);
+    return Slice(first, last);
+  }
+
+  /**
+   * @brief Get `index`'th permutation in the minimal change order.
+   *
+   * In the minimal change order, any two consecutive permutations differ by
+   * one swap of two slots. The digit of each `ItemCount` is enumerated by the
+   * Eades-McKay sequence (see `MinimalChangeCombination()`), and the digits
+   * are combined by the reflected mixed-radix Gray code. Note that this order
+   * is different from the order of `Get()`.
+   */
+  constexpr Array<T, N> GrayGet(I index) const {
+    if (index >= Size()) {
+      KOMOPERM_THROW(std::runtime_error("Index out of range"));
+    }
+
+    I digits[kLevels]{};
+    for (std::size_t k = 0; k < kLevels; ++k) {
+      const I digit = index % LevelSize(k);
+      index /= LevelSize(k);
+      digits[k] = (index % 2 == 0) ? digit : LevelSize(k) - 1 - digit;
+    }
+
+    return GrayBuild(digits);
+  }
+
+  /**
+   * @brief Get `index` for the given permutation in the minimal change order.
+   */
+  constexpr I GrayIndex(const T (&vals)[N]) const {
+    T tmp_vals[N]{};
+    Copy(std::begin(vals), std::end(vals), std::begin(tmp_vals));
+    return GrayIndexImpl(tmp_vals);
+  }
+
+  /**
+   * @brief Get `index` for the given permutation in the minimal change order.
+   */
+  template <typename Container>
+  constexpr I GrayIndex(const Container& vals) const {
+    if (vals.size() != N) {
+      KOMOPERM_THROW(std::runtime_error("The size of `vals` is illegal"));
+    }
+
+    T tmp_vals[N]{};
+    Copy(vals.begin(), vals.end(), std::begin(tmp_vals));
+    return GrayIndexImpl(tmp_vals);
+  }
+
+  /**
+   * @brief A forward iterator which visits permutations in the minimal change
+   * order.
+   *
+   * `Swapped()` tells the two slots swapped by the last increment.
+   *
+   * For each `ItemCount`, the iterator keeps the path of its combination in
+   * the recursion of the Eades-McKay sequence and the positions of its
+   * remaining slots. An increment steps the path to the adjacent leaf, which
+   * takes O(1) steps amortized and tells the swap directly, and then updates
+   * the positions in O(K) steps. So it never rescans the N slots.
+   */
+  class GrayIterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Array<T, N>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const Array<T, N>*;
+    using reference = const Array<T, N>&;
+
+    constexpr reference operator*() const noexcept { return perm_; }
+    constexpr pointer operator->() const noexcept { return &perm_; }
+
+    constexpr GrayIterator& operator++() {
+      if (++index_ >= SizeImpl()) {
+        return *this;
+      }
+
+      // Loopless reflected mixed-radix Gray code. The levels at the boundary
+      // just turn around.
+      std::size_t k = 0;
+      while (forward_[k] ? digits_[k] + 1 == LevelSize(k) : digits_[k] == 0) {
+        forward_[k] = !forward_[k];
+        ++k;
+      }
+      digits_[k] = forward_[k] ? digits_[k] + 1 : digits_[k] - 1;
+
+      const Transposition local = Step(k, !forward_[k]);
+      const std::size_t a = pos_[k][local.first];
+      const std::size_t b = pos_[k][local.second];
+
+      // The value of a higher level moves across the slots of `LevelValue(k)`
+      // only, so it keeps its order among the slots of each higher level.
+      const bool a_moves = perm_[a] != LevelValue(k);
+      const std::size_t from = a_moves ? a : b;
+      const std::size_t to = a_moves ? b : a;
+      const std::size_t level = Levels::Of(perm_[from]);
+      for (std::size_t j = k + 1; j <= level; ++j) {
+        const Slot t = local_[j][from];
+        pos_[j][t] = static_cast<Slot>(to);
+        local_[j][to] = t;
+      }
+
+      const T tmp = perm_[a];
+      perm_[a] = perm_[b];
+      perm_[b] = tmp;
+      swapped_ = {a, b};
+      return *this;
+    }
+
+    constexpr GrayIterator operator++(int) {
+      GrayIterator ret = *this;
+      ++*this;
+      return ret;
+    }
+
+    /// The index of the current permutation in the minimal change order
+    constexpr I Index() const noexcept { return index_; }
+
+    /**
+     * @brief The two slots swapped by the last increment.
+     *
+     * For the first permutation, it returns a pair of the same positions.
+     */
+    constexpr Transposition Swapped() const noexcept { return swapped_; }
+
+    constexpr bool operator==(const GrayIterator& rhs) const noexcept {
+      return index_ == rhs.index_;
+    }
+    constexpr bool operator!=(const GrayIterator& rhs) const noexcept {
+      return !(*this == rhs);
+    }
+
+   private:
+    friend class PermutationsImpl;
+
+    /// The position of a slot
+    using Slot = NarrowestUnsigned<std::size_t, N>;
+
+    /**
+     * @brief A node (`n`, `z`) of the recursion of `MinimalChangeCombination()`
+     * with `0 < z < n`, and the child on the current path
+     *
+     * The children are E(n-1, z-1)0, reverse(E(n-2, z-1))01 and E(n-2, z)11,
+     * and the last one is empty if `z == n - 1`. The first and the last bit
+     * strings of E(n, z) are 1^(n-z) 0^z and 0^z 1^(n-z) from the lowest
+     * slot. Hence, the step from the child 0 to 1 swaps the slots `n - 2`
+     * and `n - 1`, and the step from the child 1 to 2 swaps the slots
+     * `n - z - 2` and `n - 2`.
+     */
+    struct Frame {
+      Slot n;
+      Slot z;
+      std::uint8_t child;
+      /// `true` iff the node is enumerated in reverse
+      bool reversed;
+    };
+
+    explicit constexpr GrayIterator(I index) : index_{index} {
+      for (std::size_t k = 0; k < kLevels; ++k) {
+        forward_[k] = true;
+      }
+      if (index_ >= SizeImpl()) {
+        return;
+      }
+
+      perm_ = GrayBuild(digits_);
+      for (std::size_t k = 0; k < kLevels; ++k) {
+        Descend(k, LevelSpaces(k), LevelCount(k), false, false);
+        std::size_t n = 0;
+        for (std::size_t i = 0; i < N; ++i) {
+          if (Levels::Of(perm_[i]) >= k) {
+            pos_[k][n] = static_cast<Slot>(i);
+            local_[k][i] = static_cast<Slot>(n);
+            ++n;
+          }
+        }
+      }
+    }
+
+    /// The last nonempty child of `frame`
+    static constexpr std::size_t LastChild(const Frame& frame) noexcept {
+      return frame.z + 2 <= frame.n ? 2 : 1;
+    }
+
+    /**
+     * @brief Push the path from the node (`n`, `z`) to its first leaf in the
+     * direction `backward` onto the path of `ICs[k]`.
+     */
+    constexpr void Descend(std::size_t k, std::size_t n, std::size_t z,
+                           bool reversed, bool backward) noexcept {
+      while (0 < z && z < n) {
+        Frame frame{static_cast<Slot>(n), static_cast<Slot>(z), 0, reversed};
+        if (reversed != backward) {
+          frame.child = static_cast<std::uint8_t>(LastChild(frame));
+        }
+        frames_[k][depth_[k]++] = frame;
+
+        if (frame.child == 0) {
+          n -= 1;
+          z -= 1;
+        } else if (frame.child == 1) {
+          n -= 2;
+          z -= 1;
+          reversed = !reversed;
+        } else {
+          n -= 2;
+        }
+      }
+    }
+
+    /**
+     * @brief Step the combination of `ICs[k]` to the adjacent one in the
+     * direction `backward`, and return the swapped slots in its remaining
+     * slots.
+     */
+    constexpr Transposition Step(std::size_t k, bool backward) noexcept {
+      for (;;) {
+        assert(depth_[k] > 0);
+        Frame& frame = frames_[k][depth_[k] - 1];
+        const bool down = frame.reversed != backward;
+        if (down ? frame.child > 0 : frame.child < LastChild(frame)) {
+          const std::size_t lower = down ? frame.child - 1 : frame.child;
+          frame.child = static_cast<std::uint8_t>(down ? lower : lower + 1);
+
+          const std::size_t n = frame.n;
+          const std::size_t z = frame.z;
+          if (frame.child == 0) {
+            Descend(k, n - 1, z - 1, frame.reversed, backward);
+          } else if (frame.child == 1) {
+            Descend(k, n - 2, z - 1, !frame.reversed, backward);
+          } else {
+            Descend(k, n - 2, z, frame.reversed, backward);
+          }
+          return lower == 0 ? Transposition{n - 2, n - 1}
+                            : Transposition{n - z - 2, n - 2};
+        }
+        --depth_[k];
+      }
+    }
+
+    I index_;
+    Array<T, N> perm_{};
+    /// The path of the combination of `ICs[k]` from the root
+    Frame frames_[kLevels][N]{};
+    /// The length of `frames_[k]`
+    std::size_t depth_[kLevels]{};
+    /// pos_[k][i] = The position of the `i`th remaining slot of `ICs[k]`
+    Slot pos_[kLevels][N]{};
+    /// local_[k][pos_[k][i]] = i
+    Slot local_[kLevels][N]{};
+    /// The (reflected) digit of each `ItemCount`
+    I digits_[kLevels]{};
+    /// `true` iff `digits_[k]` is increasing
+    bool forward_[kLevels]{};
+    Transposition swapped_{0, 0};
+  };
+
+  /**
+   * @brief An iterator to the first permutation in the minimal change order
+   */
+  constexpr GrayIterator GrayBegin() const { return GrayIterator{0}; }
+
+  /**
+   * @brief A past-the-end iterator in the minimal change order
+   */
+  constexpr GrayIterator GrayEnd() const {
+    return GrayIterator{SizeImpl()};
+  }
+
+  /**
+   * @brief Get `index`'th permutation in the lexicographic order.
+   *
+   * In the lexicographic order, permutations are compared slot by slot from
+   * the first one, so the permutations sharing a prefix occupy a contiguous
+   * range of indices. Note that this order is different from the order of
+   * `Get()`.
+   */
+  constexpr Array<T, N> LexGet(I index) const {
+    if (index >= Size()) {
+      KOMOPERM_THROW(std::runtime_error("Index out of range"));
+    }
+
+    return LexGetImpl(index);
+  }
+
+  /**
+   * @brief Get `index` for the given permutation in the lexicographic order.
+   */
+  constexpr I LexIndex(const T (&vals)[N]) const {
+    if (!IsValid(vals)) {
+      KOMOPERM_THROW(std::runtime_error("Input is illegal"));
+    }
+
+    return LexIndexImpl(vals);
+  }
+
+  /**
+   * @brief Get `index` for the given permutation in the lexicographic order.
+   */
+  template <typename Container>
+  constexpr I LexIndex(const Container& vals) const {
+    if (vals.size() != N) {
+      KOMOPERM_THROW(std::runtime_error("The size of `vals` is illegal"));
+    }
+
+    T tmp_vals[N]{};
+    Copy(vals.begin(), vals.end(), std::begin(tmp_vals));
+    return LexIndex(tmp_vals);
+  }
+
+  /**
+   * @brief A ranker which places values slot by slot from the first one, and
+   * tells the range of the lexicographic indices (`LexIndex()`) which are
+   * still reachable.
+   *
+   * The permutations sharing a prefix occupy the contiguous range [`Low()`,
+   * `High()`), so a branch-and-bound search can prune a subtree by its range
+   * without ranking its leaves. `Push()` updates the range by the multinomial
+   * recurrence of `LexIndex()` in O(K) steps, and `Pop()` restores the
+   * previous range in O(1) steps. When all slots are placed, `Low()` is the
+   * index of the permutation.
+   */
+  class PrefixRanker {
+   public:
+    constexpr PrefixRanker() noexcept {
+      for (std::size_t k = 0; k < kLevels; ++k) {
+        counts_[Levels::kRanks.levels[k]] = LevelCount(k);
+      }
+      perms_[0] = SizeImpl();
+    }
+
+    /// The number of the placed slots
+    constexpr std::size_t Depth() const noexcept { return depth_; }
+    /// The first index of the permutations with the current prefix
+    constexpr I Low() const noexcept { return lows_[depth_]; }
+    /// The past-the-end index of the permutations with the current prefix
+    constexpr I High() const noexcept { return lows_[depth_] + perms_[depth_]; }
+    /// The number of the permutations with the current prefix
+    constexpr I Count() const noexcept { return perms_[depth_]; }
+
+    /**
+     * @brief The number of `val` which can be placed in the remaining slots
+     */
+    constexpr std::size_t Remaining(T val) const noexcept {
+      const std::size_t level = Levels::Of(val);
+      return level == Levels::kNone ? 0
+                                    : counts_[Levels::kRanks.levels[level]];
+    }
+
+    /**
+     * @brief Place `val` at the next slot.
+     *
+     * It throws if no `val` remains.
+     */
+    constexpr void Push(T val) {
+      if (!TryPush(val)) {
+        KOMOPERM_THROW(std::runtime_error("Input is illegal"));
+      }
+    }
+
+    /**
+     * @brief Place `val` at the next slot, or return `false` and do nothing if
+     * no `val` remains.
+     */
+    constexpr bool TryPush(T val) noexcept {
+      const std::size_t level = Levels::Of(val);
+      if (level == Levels::kNone) {
+        return false;
+      }
+      const std::size_t r = Levels::kRanks.levels[level];
+      if (counts_[r] == 0) {
+        return false;
+      }
+
+      std::size_t smaller = 0;
+      for (std::size_t j = 0; j < r; ++j) {
+        smaller += counts_[j];
+      }
+
+      const std::size_t n = N - depth_;
+      const I perms = perms_[depth_];
+      if (IsLexProductSafe()) {
+        lows_[depth_ + 1] =
+            lows_[depth_] + perms * static_cast<I>(smaller) / static_cast<I>(n);
+        perms_[depth_ + 1] =
+            perms * static_cast<I>(counts_[r]) / static_cast<I>(n);
+      } else {
+        const std::size_t g = LexGcd(perms, n);
+        lows_[depth_ + 1] =
+            lows_[depth_] + perms / g * static_cast<I>(smaller / (n / g));
+        perms_[depth_ + 1] = perms / g * static_cast<I>(counts_[r] / (n / g));
+      }
+      counts_[r]--;
+      ranks_[depth_++] = r;
+      return true;
+    }
+
+    /**
+     * @brief Remove the value at the last placed slot. precondition:
+     * `Depth() > 0`
+     */
+    constexpr void Pop() noexcept {
+      assert(depth_ > 0);
+      counts_[ranks_[--depth_]]++;
+    }
+
+   private:
+    /// `lows_[d]` is `Low()` when `d` slots are placed.
+    I lows_[N + 1]{};
+    /// `perms_[d]` is `Count()` when `d` slots are placed.
+    I perms_[N + 1]{};
+    /// `ranks_[d]` is the rank of the value at the `d`th slot.
+    std::size_t ranks_[N]{};
+    /// The remaining count of each value, in ascending order of the values
+    std::size_t counts_[kLevels]{};
+    std::size_t depth_{0};
+  };
+
+  /**
+   * @brief A `PrefixRanker` with no slots placed
+   */
+  constexpr PrefixRanker Ranker() const noexcept { return PrefixRanker{}; }
+
+  /**
+   * @brief Get `index` of the permutation after swapping the `i`th and `j`th
+   * slots of `vals`, where `index` is the index of `vals`.
+   *
+   * Only the digits of the `ItemCount`s from the value at `i` to the value at
+   * `j` change, so they are recalculated from the slot masks and the others
+   * are kept. It costs O(N) to build the masks, and O(1) popcounts per slot
+   * of the changed digits. If `N > 64`, it falls back to `Index()`.
+   */
+  constexpr I IndexAfterSwap(I index, const T (&vals)[N], std::size_t i,
+                             std::size_t j) const {
+    if (i >= N || j >= N) {
+      KOMOPERM_THROW(std::runtime_error("Index out of range"));
+    }
+
+    if (N > 64) {
+      T tmp_vals[N]{};
+      Copy(std::begin(vals), std::end(vals), std::begin(tmp_vals));
+      const T tmp = tmp_vals[i];
+      tmp_vals[i] = tmp_vals[j];
+      tmp_vals[j] = tmp;
+      return Index(tmp_vals);
+    }
+
+    std::uint64_t before[kLevels]{};
+    if (!SlotMasks(vals, before)) {
+      KOMOPERM_THROW(std::runtime_error("Input is illegal"));
+    }
+
+    const std::size_t li = Levels::Of(vals[i]);
+    const std::size_t lj = Levels::Of(vals[j]);
+    std::uint64_t after[kLevels]{};
+    Copy(std::begin(before), std::end(before), std::begin(after));
+    const std::uint64_t bits =
+        (std::uint64_t{1} << i) | (std::uint64_t{1} << j);
+    after[li] ^= bits;
+    after[lj] ^= bits;
+    return li < lj ? ReindexLevels(index, before, after, li, lj)
+                   : ReindexLevels(index, before, after, lj, li);
+  }
+
+  /**
+   * @brief Get `index` of the permutation after swapping the `i`th and `j`th
+   * slots of `vals`, where `index` is the index of `vals`.
+   */
+  template <typename Container>
+  constexpr I IndexAfterSwap(I index, const Container& vals, std::size_t i,
+                             std::size_t j) const {
+    if (vals.size() != N) {
+      KOMOPERM_THROW(std::runtime_error("The size of `vals` is illegal"));
+    }
+
+    T tmp_vals[N]{};
+    Copy(vals.begin(), vals.end(), std::begin(tmp_vals));
+    return IndexAfterSwap(index, tmp_vals, i, j);
+  }
+
+  /**
+   * @brief Get `index` of the permutation after moving the `from`th slot of
+   * `vals` to the `to`th slot, where `index` is the index of `vals`.
+   *
+   * The slots between `from` and `to` are shifted by one, as
+   * `std::rotate()`. Like `IndexAfterSwap()`, only the digits of the
+   * `ItemCount`s whose slots change are recalculated. (To move a value to an
+   * empty slot, use `IndexAfterSwap()` with the empty slot.)
+   */
+  constexpr I IndexAfterMove(I index, const T (&vals)[N], std::size_t from,
+                             std::size_t to) const {
+    if (from >= N || to >= N) {
+      KOMOPERM_THROW(std::runtime_error("Index out of range"));
+    }
+
+    if (N > 64) {
+      T tmp_vals[N]{};
+      for (std::size_t i = 0, j = 0; i < N; ++i) {
+        if (i == to) {
+          tmp_vals[i] = vals[from];
+          continue;
+        }
+        j += j == from ? 1 : 0;
+        tmp_vals[i] = vals[j++];
+      }
+      return Index(tmp_vals);
+    }
+
+    std::uint64_t before[kLevels]{};
+    if (!SlotMasks(vals, before)) {
+      KOMOPERM_THROW(std::runtime_error("Input is illegal"));
+    }
+
+    std::uint64_t after[kLevels]{};
+    std::size_t first = kLevels;
+    std::size_t last = 0;
+    for (std::size_t k = 0; k < kLevels; ++k) {
+      after[k] = MoveBits(before[k], from, to);
+      if (after[k] != before[k]) {
+        first = first < k ? first : k;
+        last = k;
+      }
+    }
+    return first < kLevels ? ReindexLevels(index, before, after, first, last)
+                           : index;
+  }
+
+  /**
+   * @brief Get `index` of the permutation after moving the `from`th slot of
+   * `vals` to the `to`th slot, where `index` is the index of `vals`.
+   */
+  template <typename Container>
+  constexpr I IndexAfterMove(I index, const Container& vals, std::size_t from,
+                             std::size_t to) const {
+    if (vals.size() != N) {
+      KOMOPERM_THROW(std::runtime_error("The size of `vals` is illegal"));
+    }
+
+    T tmp_vals[N]{};
+    Copy(vals.begin(), vals.end(), std::begin(tmp_vals));
+    return IndexAfterMove(index, tmp_vals, from, to);
+  }
+
+ private:
+  /**
+   * @brief The `Choose` table for this class
+   *
+   * The table is a static member shared by all instances, so that
+   * `PermutationsImpl` itself is an empty class. Small permutations share
+   * `SharedChoose<I, ChooseEntry>`, and the others share the table of the same
+   * shape.
+   */
+  static constexpr const auto& Table() noexcept {
+    return std::conditional_t<(N - 1 <= kSharedChooseMaxN),
+                              SharedChoose<I, ChooseEntry>,
+                              ShapedChoose<I, N - 1, M - 1>>::kTable;
+  }
+
+  /**
+   * @brief The narrowest type of the entries of `Table()` if it is shared
+   *
+   * `MaskCombinationIndex()` looks up (n' choose m') for n' < N and m' <= M.
+   */
+  using ChooseEntry = NarrowestUnsigned<I, SaturatedMaxChoose<I, N - 1, M>()>;
+  static_assert(N - 1 > kSharedChooseMaxN ||
+                    FittedChoose<I, ChooseEntry, kSharedChooseMaxN>::Covers(
+                        N - 1, M),
+                "The shared Choose table must hold all lookups");
+
+  /// The divider by `IC::Size()`
+  template <typename IC>
+  using Divider = ConstantDivider<I, IC::Size()>;
+
+  /// Count a call of `Index()` in `Counters()`, which failed if `!ok`
+  static constexpr void CountIndex(bool ok) noexcept {
+#if defined(KOMOPERM_ENABLE_STATS)
+    if (!__builtin_is_constant_evaluated()) {
+      Counters().index_calls++;
+      Counters().index_failures += ok ? 0 : 1;
+    }
+#else   // defined(KOMOPERM_ENABLE_STATS)
+    static_cast<void>(ok);
+#endif  // defined(KOMOPERM_ENABLE_STATS)
+  }
+
+  /// Count a call of `Get()` in `Counters()`, which failed if `!ok`
+  static constexpr void CountGet(bool ok) noexcept {
+#if defined(KOMOPERM_ENABLE_STATS)
+    if (!__builtin_is_constant_evaluated()) {
+      Counters().get_calls++;
+      Counters().get_failures += ok ? 0 : 1;
+    }
+#else   // defined(KOMOPERM_ENABLE_STATS)
+    static_cast<void>(ok);
+#endif  // defined(KOMOPERM_ENABLE_STATS)
+  }
+
+  /// The `LoopCounters` of the calling thread, or zeros if not collected
+  static constexpr LoopCounters Snapshot() noexcept {
+#if defined(KOMOPERM_ENABLE_STATS)
+    if (!__builtin_is_constant_evaluated()) {
+      return ThreadLoopCounters();
+    }
+#endif  // defined(KOMOPERM_ENABLE_STATS)
+    return LoopCounters{0, 0};
+  }
+
+  /// Attribute the `LoopCounters` since `before` to `ICs[k]`
+  static constexpr void CountLevel(std::size_t k,
+                                   LoopCounters before) noexcept {
+#if defined(KOMOPERM_ENABLE_STATS)
+    if (!__builtin_is_constant_evaluated()) {
+      const LoopCounters now = ThreadLoopCounters();
+      Counters().levels[k].iterations += now.iterations - before.iterations;
+      Counters().levels[k].lookups += now.lookups - before.lookups;
+    }
+#else   // defined(KOMOPERM_ENABLE_STATS)
+    static_cast<void>(k);
+    static_cast<void>(before);
+#endif  // defined(KOMOPERM_ENABLE_STATS)
+  }
+
+  /// `ICs[k]::Value()`
+  static constexpr T LevelValue(std::size_t k) noexcept {
+    const T vals[] = {ICs::Value()...};
+    return vals[k];
+  }
+
+  /// `ICs[k]::Spaces()`
+  static constexpr std::size_t LevelSpaces(std::size_t k) noexcept {
+    const std::size_t spaces[] = {ICs::Spaces()...};
+    return spaces[k];
+  }
+
+  /// `ICs[k]::Count()`
+  static constexpr std::size_t LevelCount(std::size_t k) noexcept {
+    const std::size_t counts[] = {ICs::Count()...};
+    return counts[k];
+  }
+
+  /// `ICs[k]::Size()`
+  static constexpr I LevelSize(std::size_t k) noexcept {
+    const I sizes[] = {ICs::Size()...};
+    return sizes[k];
+  }
+
+  /// The mapping from values to levels
+  using Levels = ValueLevels<T, ICs...>;
+
+  /**
+   * @brief Check if `vals` is a possible permutation.
+   *
+   * It counts the values of all `ItemCount`s in a single pass by mapping each
+   * value to its level, instead of scanning `vals` once per `ItemCount`.
+   */
+  static constexpr bool IsValid(const T (&vals)[N]) noexcept {
+    std::size_t counts[kLevels]{};
+    for (auto v : vals) {  // NOLINT
+      const std::size_t level = Levels::Of(v);
+      if (level == Levels::kNone) {
+        return false;
+      }
+      counts[level]++;
+    }
+
+    for (std::size_t k = 0; k < kLevels; ++k) {
+      if (counts[k] != LevelCount(k)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * @brief Build a permutation from the digits in the minimal change order.
+   */
+  static constexpr Array<T, N> GrayBuild(const I (&digits)[kLevels]) {
+    // Build the remaining sequences from the last `ItemCount`.
+    Array<T, N> ret{};
+    Array<T, N> rest{};
+    for (std::size_t k = kLevels; k-- > 0;) {
+      Array<bool, N> bits{};
+      MinimalChangeCombination(Table(), LevelSpaces(k), LevelCount(k),
+                               digits[k], bits);
+      for (std::size_t i = 0, j = 0; i < LevelSpaces(k); ++i) {
+        ret[i] = bits[i] ? rest[j++] : LevelValue(k);
+      }
+      rest = ret;
+    }
+    return ret;
+  }
+
+  constexpr I GrayIndexImpl(T (&tmp_vals)[N]) const {
+    if (!IsValid(tmp_vals)) {
+      KOMOPERM_THROW(std::runtime_error("Input is illegal"));
+    }
+
+    I digits[kLevels]{};
+    for (std::size_t k = 0; k < kLevels; ++k) {
+      Array<bool, N> bits{};
+      std::size_t j = 0;
+      for (std::size_t i = 0; i < LevelSpaces(k); ++i) {
+        bits[i] = tmp_vals[i] != LevelValue(k);
+        if (bits[i]) {
+          tmp_vals[j++] = tmp_vals[i];
+        }
+      }
+      digits[k] =
+          MinimalChangeCombinationRank(Table(), LevelSpaces(k), LevelCount(k),
+                                       bits);
+    }
+
+    // Undo the reflection from the most significant digit.
+    I index = 0;
+    for (std::size_t k = kLevels; k-- > 0;) {
+      const I digit =
+          (index % 2 == 0) ? digits[k] : LevelSize(k) - 1 - digits[k];
+      index = index * LevelSize(k) + digit;
+    }
+    return index;
+  }
+
+  /**
+   * @brief `true` iff `perms * c` never overflows in `LexIndexImpl()` and
+   * `LexGetImpl()`, where `perms <= Size()` and `c <= N`.
+   */
+  static constexpr bool IsLexProductSafe() noexcept {
+    return SizeImpl() <= std::numeric_limits<I>::max() / N;
+  }
+
+  /**
+   * @brief gcd(`perms`, `n`)
+   *
+   * If `perms` is the number of permutations of the `n` remaining slots,
+   * `perms * c / n` permutations start with a value of count `c`. Hence
+   * `n / gcd(perms, n)` divides all the counts, and the products can be
+   * calculated as `perms / g * (c / (n / g))` without overflow.
+   */
+  static constexpr std::size_t LexGcd(I perms, std::size_t n) noexcept {
+    I a = perms;
+    I b = static_cast<I>(n);
+    while (b != 0) {
+      const I t = a % b;
+      a = b;
+      b = t;
+    }
+    return static_cast<std::size_t>(a);
+  }
+
+  /**
+   * @brief Count the permutations lexicographically smaller than `vals`.
+   *
+   * For each slot, the permutations which have the same prefix and a smaller
+   * value at the slot are added. The loop stops as soon as the rest of the
+   * slots is determined, i.e. only one value remains.
+   */
+  constexpr I LexIndexImpl(const T (&vals)[N]) const noexcept {
+    std::size_t counts[kLevels]{};
+    for (std::size_t k = 0; k < kLevels; ++k) {
+      counts[Levels::kRanks.levels[k]] = LevelCount(k);
+    }
+
+    I perms = SizeImpl();
+    I ret = 0;
+    for (std::size_t i = 0; i < N && perms > 1; ++i) {
+      const std::size_t n = N - i;
+      const std::size_t r = Levels::kRanks.levels[Levels::Of(vals[i])];
+      std::size_t smaller = 0;
+      for (std::size_t j = 0; j < r; ++j) {
+        smaller += counts[j];
+      }
+
+      if (IsLexProductSafe()) {
+        ret += perms * static_cast<I>(smaller) / static_cast<I>(n);
+        perms = perms * static_cast<I>(counts[r]) / static_cast<I>(n);
+      } else {
+        const std::size_t g = LexGcd(perms, n);
+        ret += perms / g * static_cast<I>(smaller / (n / g));
+        perms = perms / g * static_cast<I>(counts[r] / (n / g));
+      }
+      counts[r]--;
+    }
+    return ret;
+  }
+
+  constexpr Array<T, N> LexGetImpl(I index) const noexcept {
+    T vals[kLevels]{};
+    std::size_t counts[kLevels]{};
+    for (std::size_t k = 0; k < kLevels; ++k) {
+      vals[Levels::kRanks.levels[k]] = LevelValue(k);
+      counts[Levels::kRanks.levels[k]] = LevelCount(k);
+    }
+
+    Array<T, N> ret{};
+    I perms = SizeImpl();
+    for (std::size_t i = 0; i < N; ++i) {
+      const std::size_t n = N - i;
+      std::size_t j = 0;
+      if (IsLexProductSafe()) {
+        // Find the first `j` with `index < perms * (counts[0] + ... +
+        // counts[j]) / n` by comparing the numerators, which saves the
+        // divisions.
+        const I scaled = index * static_cast<I>(n);
+        I bound = perms * static_cast<I>(counts[0]);
+        while (scaled >= bound) {
+          bound += perms * static_cast<I>(counts[++j]);
+        }
+        const I block = perms * static_cast<I>(counts[j]);
+        index -= (bound - block) / static_cast<I>(n);
+        perms = block / static_cast<I>(n);
+      } else {
+        // The permutations are divided into `g` blocks of `unit`, and each
+        // value of count `c` covers `c / (n / g)` blocks.
+        const std::size_t g = LexGcd(perms, n);
+        const I unit = perms / g;
+        const std::size_t scaled =
+            static_cast<std::size_t>(index / unit) * (n / g);
+        std::size_t bound = counts[0];
+        while (scaled >= bound) {
+          bound += counts[++j];
+        }
+        index -= unit * static_cast<I>((bound - counts[j]) / (n / g));
+        perms = unit * static_cast<I>(counts[j] / (n / g));
+      }
+      ret[i] = vals[j];
+      counts[j]--;
+    }
+    return ret;
+  }
+
+  /// The number of rows processed at once in `IndexBatch()` and `GetBatch()`
+  static constexpr std::size_t kBatchBlockSize = 16;
+
+  /**
+   * @brief min(`remain`, `kBatchBlockSize`)
+   *
+   * `std::min()` takes its arguments by reference, which requires the
+   * out-of-class definition of `kBatchBlockSize` in C++14.
+   */
+  static constexpr std::size_t BlockLength(std::size_t remain) noexcept {
+    return remain < kBatchBlockSize ? remain : kBatchBlockSize;
+  }
+
+  /// The integer representation of `LevelValue(k)` in the packed layout
+  static constexpr std::uint64_t Code(std::size_t k) noexcept {
+    return static_cast<std::uint64_t>(
+        static_cast<typename Levels::Integer>(LevelValue(k)));
+  }
+
+  /**
+   * @brief `true` iff all values are in [0, 2^`B`).
+   *
+   * Negative values are also rejected because they are converted to large
+   * codes.
+   */
+  template <std::size_t B>
+  static constexpr bool AreCodesPackable() noexcept {
+    for (std::size_t k = 0; k < kLevels; ++k) {
+      if (Code(k) > LowMask(B)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * @brief Get the index from the slots of each value. `eq[k]` is the slots of
+   * `LevelValue(k)`.
+   */
+  constexpr I MaskIndexImpl(const std::uint64_t (&eq)[kLevels]) const noexcept {
+    I index = 0;
+    I base = 1;
+    std::uint64_t rest = LowMask(N);
+    // The last `ItemCount` is always 0.
+    for (std::size_t k = 0; k + 1 < kLevels; ++k) {
+      const LoopCounters before = Snapshot();
+      index += base * MaskCombinationIndex(Table(), LevelSpaces(k),
+                                           LevelCount(k), LevelSize(k),
+                                           ParallelExtract(eq[k], rest));
+      CountLevel(k, before);
+      base *= LevelSize(k);
+      rest &= ~eq[k];
+    }
+    return index;
+  }
+
+  /**
+   * @brief Replace the digits of `ICs[first]`, ..., `ICs[last]` in `index`
+   * from the slot masks `before` to `after`.
+   *
+   * The masks of the other `ItemCount`s must be the same in `before` and
+   * `after`. Hence the remaining slots of `ICs[first]` are also the same.
+   */
+  constexpr I ReindexLevels(I index, const std::uint64_t (&before)[kLevels],
+                            const std::uint64_t (&after)[kLevels],
+                            std::size_t first,
+                            std::size_t last) const noexcept {
+    I base = 1;
+    std::uint64_t rest = LowMask(N);
+    for (std::size_t k = 0; k < first; ++k) {
+      base *= LevelSize(k);
+      rest &= ~before[k];
+    }
+
+    std::uint64_t rest_before = rest;
+    std::uint64_t rest_after = rest;
+    // The last `ItemCount` is always 0.
+    for (std::size_t k = first; k <= last && k + 1 < kLevels; ++k) {
+      const I digit_before = MaskCombinationIndex(
+          Table(), LevelSpaces(k), LevelCount(k), LevelSize(k),
+          ParallelExtract(before[k], rest_before));
+      const I digit_after = MaskCombinationIndex(
+          Table(), LevelSpaces(k), LevelCount(k), LevelSize(k),
+          ParallelExtract(after[k], rest_after));
+      // It may wrap around temporarily, but the result is in range.
+      index = index - base * digit_before + base * digit_after;
+      base *= LevelSize(k);
+      rest_before &= ~before[k];
+      rest_after &= ~after[k];
+    }
+    return index;
+  }
+
+  /**
+   * @brief Move the `from`th bit of `mask` to the `to`th bit, and shift the
+   * bits between them by one.
+   */
+  static constexpr std::uint64_t MoveBits(std::uint64_t mask, std::size_t from,
+                                          std::size_t to) noexcept {
+    const std::uint64_t bit = (mask >> from) & 1;
+    if (from < to) {
+      const std::uint64_t range = LowMask(to + 1) & ~LowMask(from);
+      return (mask & ~range) | (((mask & range) >> 1) & range) | (bit << to);
+    }
+    const std::uint64_t range = LowMask(from + 1) & ~LowMask(to);
+    return (mask & ~range) | (((mask & range) << 1) & range) | (bit << to);
+  }
+
+  /**
+   * @brief Place `LevelValue(k)` at the slots `local` in the remaining slots
+   * `rest`, and remove them from `rest`.
+   */
+  template <std::size_t B>
+  static constexpr void PlacePacked(
+      std::size_t k, std::uint64_t local, std::uint64_t& rest,
+      std::uint64_t (&words)[PackedLayout<B>::Words(N)]) noexcept {
+    constexpr std::size_t kSlots = PackedLayout<B>::SlotsPerWord();
+    const std::uint64_t eq = ParallelDeposit(local, rest);
+    rest &= ~eq;
+    for (std::size_t w = 0; w < PackedLayout<B>::Words(N); ++w) {
+      const std::uint64_t slots = (eq >> (w * kSlots)) & LowMask(kSlots);
+      words[w] |= PackedLayout<B>::Fill(slots, Code(k));
+    }
+  }
+
+  /**
+   * @brief `MaskIndexImpl()` for `len` rows. `eq[r]` is the slot masks of the
+   * `r`th row, and its index is written to `out[r]`.
+   */
+  constexpr void MaskIndexBlock(
+      const std::uint64_t (&eq)[kBatchBlockSize][kLevels], std::size_t len,
+      I* out) const noexcept {
+    std::uint64_t rest[kBatchBlockSize]{};
+    for (std::size_t r = 0; r < len; ++r) {
+      out[r] = 0;
+      rest[r] = LowMask(N);
+    }
+
+    I base = 1;
+    // The last `ItemCount` is always 0.
+    for (std::size_t k = 0; k + 1 < kLevels; ++k) {
+      for (std::size_t r = 0; r < len; ++r) {
+        out[r] += base * MaskCombinationIndex(Table(), LevelSpaces(k),
+                                              LevelCount(k), LevelSize(k),
+                                              ParallelExtract(eq[r][k],
+                                                              rest[r]));
+        rest[r] &= ~eq[r][k];
+      }
+      base *= LevelSize(k);
+    }
+  }
+
+  /**
+   * @brief Set `digits[r][k]` to the digit of `IC`, which is the `k`th
+   * `ItemCount`, for `len` rows, and consume it from `indices`.
+   */
+  template <typename IC>
+  static constexpr void DivideBlock(
+      I (&indices)[kBatchBlockSize], std::size_t len, std::size_t k,
+      I (&digits)[kBatchBlockSize][kLevels]) noexcept {
+    for (std::size_t r = 0; r < len; ++r) {
+      digits[r][k] = Divider<IC>::Mod(indices[r]);
+      indices[r] = Divider<IC>::Div(indices[r]);
+    }
+  }
+
+  /**
+   * @brief `GetIntoImpl()` from the digit of each `ItemCount`, where
+   * `digits[k]` is the digit of the `k`th one.
+   */
+  constexpr void GetDigitsImpl(const I (&digits)[kLevels],
+                               T* out) const noexcept {
+    std::size_t k = 0;
+    if (N <= 64) {
+      std::uint64_t rest = LowMask(N);
+      ConsumeValues(
+          {(k + 1 < kLevels
+                ? UseMaskBackend()
+                      ? PlaceMask<ICs>(MaskCombinationGet(Table(),
+                                                          ICs::Spaces(),
+                                                          ICs::Count(),
+                                                          digits[k]),
+                                       rest, out)
+                      : CombinationGetMask(Table(), ICs::Value(),
+                                           ICs::Spaces(), ICs::Count(),
+                                           digits[k], out, rest)
+                : FillMask(ICs::Value(), rest, out),
+            ++k)...});
+      return;
+    }
+
+    Array<bool, N> filled{};
+    ConsumeValues(
+        {(k + 1 < kLevels
+              ? CombinationGet(Table(), ICs::Value(), ICs::Spaces(),
+                               ICs::Count(), digits[k], out, filled, N)
+              : FillUnfilled(ICs::Value(), filled, out),
+          ++k)...});
+  }
+
+  static constexpr I SizeImpl() noexcept {
+    I ret = 1;
+
+    // Calculate all multiplication of ICs::Size().
+    //
+    // [Notes]
+    // - As fold expression (ICs::Size() * ...) is not available in C++14, we
+    //   adopts `ConsumeValues()` to realize a loop without recursion.
+    // - Overflow is checked by `IsSizeRepresentable()` at compile time.
+    ConsumeValues({(ret *= ICs::Size())...});
+    return ret;
+  }
+
+  /**
+   * @brief `true` iff the multiplication of ICs::Size() never overflows `I`.
+   */
+  static constexpr bool IsSizeRepresentable() noexcept {
+    I ret = 1;
+    bool ok = true;
+    ConsumeValues(
+        {(ok = ok && ICs::Size() <= std::numeric_limits<I>::max() / ret,
+          ret *= ICs::Size())...});
+    return ok;
+  }
+
+  constexpr I PaddedIndexImpl(T (&tmp_vals)[N]) const {
+    if (!IsValid(tmp_vals)) {
+      KOMOPERM_THROW(std::runtime_error("Input is illegal"));
+    }
+
+    I index = 0;
+    std::size_t shift = 0;
+    ConsumeValues(
+        {(index |= ICs::IndexImpl(Table(), std::begin(tmp_vals)) << shift,
+          shift += ICs::Bits())...});
+    return index;
+  }
+
+  /**
+   * @brief Place the values of `IC` from the lowest `IC::Bits()` bits of
+   * `padded`.
+   */
+  template <typename IC>
+  constexpr void PaddedGetField(I padded, Array<T, N>& ret,
+                                Array<bool, N>& filled) const {
+    const I mask = (static_cast<I>(1) << IC::Bits()) - 1;
+    const I digit = padded & mask;
+    if (digit >= IC::Size()) {
+      KOMOPERM_THROW(std::runtime_error("Illegal padded index"));
+    }
+    IC::Get(Table(), digit, ret, filled);
+  }
+
+  constexpr I IndexImpl(T (&tmp_vals)[N]) const {
+    const Result<I> ret = TryIndexImpl(tmp_vals);
+    if (!ret.ok()) {
+      KOMOPERM_THROW(std::runtime_error("Input is illegal"));
+    }
+    return ret.value;
+  }
+
+  constexpr Result<I> TryIndexImpl(T (&tmp_vals)[N]) const noexcept {
+    if (UseMaskBackend() || UseSimdIndex()) {
+      std::uint64_t eq[kLevels]{};
+      const bool ok = SlotMasks(tmp_vals, eq);
+      CountIndex(ok);
+      return ok ? Result<I>{MaskIndexImpl(eq), Error::kOk}
+                : Result<I>{0, Error::kIllegalInput};
+    }
+
+    const bool ok = IsValid(tmp_vals);
+    CountIndex(ok);
+    return ok ? Result<I>{IndexUncheckedImpl(tmp_vals), Error::kOk}
+              : Result<I>{0, Error::kIllegalInput};
+  }
+
+  constexpr I IndexUncheckedImpl(T (&tmp_vals)[N]) const noexcept {
+    assert(IsValid(tmp_vals));
+
+    if (UseMaskBackend() || UseSimdIndex()) {
+      std::uint64_t eq[kLevels]{};
+      SlotMasks(tmp_vals, eq);
+      return MaskIndexImpl(eq);
+    }
+
+    // The output index can be splitted as follows.
+    //
+    //     index = (index of ICs[0]) x (index of ICs[1]) x ...
+    //                   ∈                   ∈             ...
+    //             [0, ICs[0]::Size())  [0, ICs[1]::Size())   ...
+    //       x: Cartesian Product
+    I index = 0;
+    I base = 1;
+    std::size_t k = 0;
+    LoopCounters before{};
+    // The last `ItemCount` is always 0.
+    ConsumeValues(
+        {(before = Snapshot(),
+          index += k + 1 < kLevels
+                       ? base * ICs::IndexImpl(Table(), std::begin(tmp_vals))
+                       : 0,
+          CountLevel(k++, before), base *= ICs::Size())...});
+    return index;
+  }
+
+  /**
+   * @brief Set `eq[k]` to the slots of `LevelValue(k)` in [`vals`,
+   * `vals + N`), and check if they are a possible permutation.
+   *
+   * It is the bitmask version of `IsValid()`, and only used if `N <= 64`.
+   */
+  static constexpr bool SlotMasks(const T* vals,
+                                  std::uint64_t (&eq)[kLevels]) noexcept {
+#if defined(KOMOPERM_SIMD_BYTES)
+    if (UseSimdIndex() && !__builtin_is_constant_evaluated()) {
+      return SimdSlotMasks(vals, eq,
+                           std::integral_constant<bool, UseSimdIndex()>{});
+    }
+#endif  // defined(KOMOPERM_SIMD_BYTES)
+
+    bool ok = true;
+    for (std::size_t i = 0; i < N; ++i) {
+      const std::size_t level = Levels::Of(vals[i]);
+      if (level == Levels::kNone) {
+        ok = false;
+      } else {
+        eq[level] |= std::uint64_t{1} << (i % 64);
+      }
+    }
+
+    for (std::size_t k = 0; k < kLevels; ++k) {
+      ok = ok && PopCount(eq[k]) == LevelCount(k);
+    }
+    return ok;
+  }
+
+#if defined(KOMOPERM_SIMD_BYTES)
+  /**
+   * @brief `SlotMasks()` by `SimdEqualMasks()`
+   *
+   * `vals` is copied into zero-padded vectors. The padding may match a value,
+   * so the slots out of [0, `N`) are dropped before checking the counts.
+   */
+  static bool SimdSlotMasks(const T* vals, std::uint64_t (&eq)[kLevels],
+                            std::true_type) noexcept {
+    constexpr std::size_t S = sizeof(T);
+    constexpr std::size_t kBytes = KOMOPERM_SIMD_BYTES;
+    constexpr std::size_t kBlocks = (N * S + kBytes - 1) / kBytes;
+    alignas(kBytes) unsigned char blocks[kBlocks * kBytes]{};
+    std::memcpy(blocks, vals, N * S);
+
+    SimdWord<S> codes[kLevels]{};
+    for (std::size_t k = 0; k < kLevels; ++k) {
+      const T val = LevelValue(k);
+      std::memcpy(&codes[k], &val, S);
+    }
+    SimdEqualMasks<S>(blocks, kBlocks, codes, kLevels, eq);
+
+    // As the values are distinct, `eq[k]` are disjoint. So if all counts are
+    // correct, every slot has a value.
+    bool ok = true;
+    for (std::size_t k = 0; k < kLevels; ++k) {
+      eq[k] &= LowMask(N);
+      ok = ok && PopCount(eq[k]) == LevelCount(k);
+    }
+    return ok;
+  }
+
+  /// Never called because `UseSimdIndex()` is `false`.
+  static bool SimdSlotMasks(const T*, std::uint64_t (&)[kLevels],
+                            std::false_type) noexcept {
+    return false;
+  }
+#endif  // defined(KOMOPERM_SIMD_BYTES)
+
+  /// The permutation in which the same values are adjacent in level order
+  static constexpr Array<T, N> Grouped() noexcept {
+    Array<T, N> ret{};
+    std::size_t i = 0;
+    for (std::size_t k = 0; k < kLevels; ++k) {
+      for (std::size_t j = 0; j < LevelCount(k); ++j) {
+        ret[i++] = LevelValue(k);
+      }
+    }
+    return ret;
+  }
+
+  /// `GetInto()` for a random access iterator
+  template <typename OutputIt>
+  constexpr OutputIt GetIntoIterator(I index, OutputIt out,
+                                     std::true_type) const noexcept {
+    using Difference =
+        typename std::iterator_traits<OutputIt>::difference_type;
+    GetIntoImpl(index, out);
+    return out + static_cast<Difference>(N);
+  }
+
+  /// `GetInto()` for the other output iterators
+  template <typename OutputIt>
+  constexpr OutputIt GetIntoIterator(I index, OutputIt out,
+                                     std::false_type) const noexcept {
+    T vals[N]{};
+    GetIntoImpl(index, vals);
+    for (const T& val : vals) {  // NOLINT
+      *out = val;
+      ++out;
+    }
+    return out;
+  }
+
+  /// `GetImpl()` into `Array<T, N>`
+  constexpr Array<T, N> GetImpl(I& index) const noexcept {
+    Array<T, N> ret{};
+    GetImpl(index, ret);
+    return ret;
+  }
+
+  /// `MaskGetImpl()` into `Array<T, N>`
+  constexpr Array<T, N> MaskGetImpl(I& index) const noexcept {
+    Array<T, N> ret{};
+    MaskGetImpl(index, ret);
+    return ret;
+  }
+
+  /// `GetImpl()` or `MaskGetImpl()` into `out`, which is indexed by `out[j]`
+  template <typename Out>
+  constexpr void GetIntoImpl(I& index, Out& out) const noexcept {
+    if (UseMaskBackend()) {
+      MaskGetImpl(index, out);
+    } else {
+      GetImpl(index, out);
+    }
+  }
+
+  /**
+   * @brief `Get()` by `ItemCount`s into `out`. `index` is divided by `Size()`.
+   *
+   * If `N <= 64`, the filled slots are a bitmask, and each `ItemCount` only
+   * visits the remaining slots. Otherwise, they are an `Array<bool, N>`. The
+   * last `ItemCount` fills all the remaining slots.
+   */
+  template <typename Out>
+  constexpr void GetImpl(I& index, Out& out) const noexcept {
+    std::size_t k = 0;
+    LoopCounters before{};
+    if (N <= 64) {
+      std::uint64_t rest = LowMask(N);
+      ConsumeValues(
+          {(before = Snapshot(),
+            k + 1 < kLevels
+                ? CombinationGetMask(Table(), ICs::Value(), ICs::Spaces(),
+                                     ICs::Count(), Divider<ICs>::Mod(index),
+                                     out, rest)
+                : FillMask(ICs::Value(), rest, out),
+            CountLevel(k++, before), index = Divider<ICs>::Div(index))...});
+      return;
+    }
+
+    Array<bool, N> filled{};
+    ConsumeValues(
+        {(before = Snapshot(),
+          k + 1 < kLevels
+              ? CombinationGet(Table(), ICs::Value(), ICs::Spaces(),
+                               ICs::Count(), Divider<ICs>::Mod(index), out,
+                               filled, N)
+              : FillUnfilled(ICs::Value(), filled, out),
+          CountLevel(k++, before), index = Divider<ICs>::Div(index))...});
+  }
+
+  /// `Get()` by bitmasks into `out`. `index` is divided by `Size()`.
+  template <typename Out>
+  constexpr void MaskGetImpl(I& index, Out& out) const noexcept {
+    std::uint64_t rest = LowMask(N);
+    std::size_t k = 0;
+    LoopCounters before{};
+    // The last `ItemCount` fills all the remaining slots.
+    ConsumeValues(
+        {(before = Snapshot(),
+          k + 1 < kLevels
+              ? PlaceMask<ICs>(MaskCombinationGet(Table(), ICs::Spaces(),
+                                                  ICs::Count(),
+                                                  Divider<ICs>::Mod(index)),
+                               rest, out)
+              : FillMask(ICs::Value(), rest, out),
+          CountLevel(k++, before), index = Divider<ICs>::Div(index))...});
+  }
+
+  /// Place `val` at the remaining slots `rest` of `out`.
+  template <typename Out>
+  static constexpr void FillMask(T val, std::uint64_t rest, Out& out) noexcept {
+    for (std::uint64_t m = rest; m != 0; m &= m - 1) {
+      out[LowestBit(m)] = val;
+    }
+  }
+
+  /// Place `val` at the slots of `out` which are not `filled`.
+  template <typename Out>
+  static constexpr void FillUnfilled(T val, const Array<bool, N>& filled,
+                                     Out& out) noexcept {
+    for (std::size_t i = 0; i < N; ++i) {
+      if (!filled[i]) {
+        out[i] = val;
       }
-      ret.remains[max_idx] = remains;
-      ret.counts[max_idx] = count;
+    }
+  }
+
+  /**
+   * @brief Place `IC::Value()` at the slots `local` in the remaining slots
+   * `rest`, and remove them from `rest`.
+   */
+  template <typename IC, typename Out>
+  static constexpr void PlaceMask(std::uint64_t local, std::uint64_t& rest,
+                                  Out& ret) noexcept {
+    const std::uint64_t eq = ParallelDeposit(local, rest);
+    rest &= ~eq;
+    for (std::uint64_t m = eq; m != 0; m &= m - 1) {
+      ret[LowestBit(m)] = IC::Value();
+    }
+  }
+
+  static_assert(IsIndexType<I>::value,
+                "I must be an unsigned integer type not narrower than "
+                "unsigned");
+  static_assert(IsSizeRepresentable(),
+                "The number of permutations must be representable by I. Use a "
+                "wider index type such as unsigned __int128");
+};
+
+/**
+ * @brief An array that summarize the input sequence `Vals...`
+ *
+ * Only the first `size` entries of each array are used.
+ */
+template <typename T, std::size_t N>
+struct ItemArray {
+  T values[N];
+  std::size_t remains[N];
+  std::size_t counts[N];
+  /// The number of unique values
+  std::size_t size;
+  /// The maximum in `counts`
+  std::size_t max_count;
+};
+
+/**
+ * @brief A value and its position in the input sequence
+ *
+ * They are ordered by the value, and then by the position.
+ */
+template <typename T>
+struct ValuePosition {
+  T value;
+  std::size_t pos;
+
+  constexpr bool operator<(const ValuePosition& rhs) const noexcept {
+    return value < rhs.value || (!(rhs.value < value) && pos < rhs.pos);
+  }
+};
+
+/**
+ * @brief Summarize the input sequence `Vals...`
+ *
+ * The values are grouped by sorting them with their positions, and the groups
+ * are sorted again by `order`. It takes O(N log N) steps in total.
+ *
+ * # Example
+ *
+ * MakeItemCountsImplCalc<int, 3, 3, 4, 2, 6, 4>
+ * => ItemArray{
+ *   values[] = {3, 4, 2, 6, ...},
+ *   remains[] = {6, 4, 2, 1, ...},   // The sum of counts[i]..counts[size-1]
+ *   counts[] = {2, 2, 1, 1, ...},    // The number of values[i]
+ *   size = 4,
+ *   max_count = 2,
+ * }
+ */
+template <typename T, T... Vals>
+inline constexpr auto MakeItemCountsImplCalc(
+    ItemOrder order = ItemOrder::kFirstOccurrence) noexcept {
+  constexpr std::size_t kN = sizeof...(Vals);
+  ItemArray<T, kN> ret{};
+  const T vals[kN]{Vals...};
 
-      remains -= count;
-      max_idx++;
+  ValuePosition<T> items[kN]{};
+  ValuePosition<T> tmp[kN]{};
+  for (std::size_t i = 0; i < kN; ++i) {
+    items[i] = ValuePosition<T>{vals[i], i};
+  }
+  MergeSort(std::begin(items), std::end(items), std::begin(tmp));
+
+  // Group the same values. starts[g] is the position of the first item of the
+  // g-th group in `items`.
+  std::size_t starts[kN]{};
+  std::size_t counts[kN]{};
+  std::size_t size = 0;
+  for (std::size_t i = 0; i < kN; ++i) {
+    if (i == 0 || items[i - 1].value != items[i].value) {
+      starts[size++] = i;
     }
+    counts[size - 1]++;
+  }
+
+  // Sort the groups by `order`, and then by their first occurrences in
+  // `Vals...`. keys[k] = (the sort key of the group, the group index)
+  ValuePosition<std::size_t> keys[kN]{};
+  ValuePosition<std::size_t> tmp_keys[kN]{};
+  for (std::size_t g = 0; g < size; ++g) {
+    const std::size_t rank =
+        order == ItemOrder::kDescendingCount ? kN - counts[g] : 0;
+    keys[g] = ValuePosition<std::size_t>{rank * kN + items[starts[g]].pos, g};
   }
+  MergeSort(std::begin(keys), std::begin(keys) + size, std::begin(tmp_keys));
+
+  std::size_t remains = kN;
+  for (std::size_t k = 0; k < size; ++k) {
+    const std::size_t g = keys[k].pos;
+    ret.values[k] = items[starts[g]].value;
+    ret.remains[k] = remains;
+    ret.counts[k] = counts[g];
+    ret.max_count = counts[g] > ret.max_count ? counts[g] : ret.max_count;
+    remains -= counts[g];
+  }
+  ret.size = size;
 
-  assert(max_idx == (UniqueCount<T, Vals...>()));
   assert(remains == 0);
 
   return ret;
@@ -552,10 +4234,31 @@ inline constexpr auto MakeItemCountsImplCalc() noexcept {
 template <typename T, T... Vals>
 struct ValueSet {};
 
+/**
+ * @brief The summary of `Vals...` in `O`
+ *
+ * The summary is calculated only once for each `Vals...`, and shared by the
+ * deduction of the number of `ItemCount`s and their parameters.
+ */
+template <typename V, ItemOrder O = ItemOrder::kFirstOccurrence>
+struct ValueSummary;
+
+template <typename T, T... Vals, ItemOrder O>
+struct ValueSummary<ValueSet<T, Vals...>, O> {
+  static constexpr ItemArray<T, sizeof...(Vals)> kValue =
+      MakeItemCountsImplCalc<T, Vals...>(O);
+};
+
+// The out-of-class definition is required if `kValue` is odr-used in C++14.
+template <typename T, T... Vals, ItemOrder O>
+constexpr ItemArray<T, sizeof...(Vals)>
+    ValueSummary<ValueSet<T, Vals...>, O>::kValue;
+
 /**
  * @brief Create a proper permutation implementation at compile time (See below)
  */
-template <typename V, typename I>
+template <typename V, typename I, typename S,
+          ItemOrder O = ItemOrder::kFirstOccurrence>
 struct MakePermutationsImpl;
 
 /**
@@ -566,43 +4269,32 @@ struct MakePermutationsImpl;
  *
  * # Example
  *
- * MakePermutationsImpl<ValueSet<int, 3, 3, 4, 2, 6, 4>,
- *                     std::index_sequence<0, 1, 2, 3, 4, 5, 6>>::type
+ * MakePermutationsImpl<ValueSet<int, 3, 3, 4, 2, 6, 4>, std::size_t,
+ *                     std::index_sequence<0, 1, 2, 3>>::type
  * => PermutationsImpl<int, // The type of `Vals...`
+ *        std::size_t,  // The index type
  *        6,   // The number of `Vals...`
  *        2,   // The maximum number of symbols for `Vals...`
- *        //       <type, symbol, remain, count>
- *        ItemCount<int, 3, 4, 2>,
- *        ItemCount<int, 4, 2, 2>,
- *        ItemCount<int, 2, 1, 1>,
- *        ItemCount<int, 6, 0, 1>
+ *        //       <type, symbol, remain, count, index type>
+ *        ItemCount<int, 3, 6, 2, std::size_t>,
+ *        ItemCount<int, 4, 4, 2, std::size_t>,
+ *        ItemCount<int, 2, 2, 1, std::size_t>,
+ *        ItemCount<int, 6, 1, 1, std::size_t>
  * >
  */
-template <typename T, T... Vals, std::size_t... Indices>
-struct MakePermutationsImpl<ValueSet<T, Vals...>,
-                            std::index_sequence<Indices...>> {
+template <typename T, T... Vals, typename I, std::size_t... Indices,
+          ItemOrder O>
+struct MakePermutationsImpl<ValueSet<T, Vals...>, I,
+                            std::index_sequence<Indices...>, O> {
  private:
-  /**
-   * @brief An implementation method for type deduction. This function is never
-   * called at runtime.
-   */
-  static constexpr auto Impl() noexcept {
-    // In C++14, `static constexpr` member might need to be defined in .cpp
-    // file. Therefore, it is not suitable for us, header only template
-    // libraries.
-    //
-    // So we hide the constexpr instance into static method, deduce the proper
-    // type, and extract it by `decltype()`.
-    constexpr auto kValue = MakeItemCountsImplCalc<T, Vals...>();
-    using type = PermutationsImpl<
-        T, sizeof...(Vals), std::max({kValue.counts[Indices]...}),
-        ItemCount<T, kValue.values[Indices], kValue.remains[Indices],
-                  kValue.counts[Indices]>...>;
-    return type{};
-  }
+  using Summary = ValueSummary<ValueSet<T, Vals...>, O>;
 
  public:
-  using type = decltype(Impl());
+  using type = PermutationsImpl<
+      T, I, sizeof...(Vals), Summary::kValue.max_count,
+      ItemCount<T, Summary::kValue.values[Indices],
+                Summary::kValue.remains[Indices],
+                Summary::kValue.counts[Indices], I>...>;
 };
 }  // namespace detail
 
@@ -639,8 +4331,65 @@ struct MakePermutationsImpl<ValueSet<T, Vals...>,
  */
 template <typename T, T... Vals>
 using Permutations = typename detail::MakePermutationsImpl<
-    detail::ValueSet<T, Vals...>,
-    std::make_index_sequence<detail::UniqueCount<T, Vals...>()>>::type;
+    detail::ValueSet<T, Vals...>, std::size_t,
+    std::make_index_sequence<
+        detail::ValueSummary<detail::ValueSet<T, Vals...>>::kValue.size>>::type;
+
+/**
+ * @brief A class that handles permutation of duplicates with the index type
+ * `I`
+ *
+ * `Size()`, `Index()`, and `Get()` use `I` instead of `std::size_t`. A wider
+ * type such as `unsigned __int128` enables permutations over 2^64, and a
+ * narrower type such as `std::uint32_t` makes the `Choose` table smaller and
+ * the divisions in `Get()` faster. For more detail, see the description of
+ * `Permutations`.
+ *
+ * # Example
+ *
+ * ```
+ * constexpr PermutationsWithIndex<std::uint32_t, Kind, A, A, A, B, B, C> p;
+ * ```
+ *
+ * @tparam I     An unsigned integer type. (See `detail::IsIndexType`)
+ * @tparam T     An integer or enum
+ * @tparam Vals  A sequence of type `T`. (duplication of values are permitted)
+ */
+template <typename I, typename T, T... Vals>
+using PermutationsWithIndex = typename detail::MakePermutationsImpl<
+    detail::ValueSet<T, Vals...>, I,
+    std::make_index_sequence<
+        detail::ValueSummary<detail::ValueSet<T, Vals...>>::kValue.size>>::type;
+
+/**
+ * @brief A class that handles permutation of duplicates whose `ItemCount`s,
+ * i.e. the digits of the index, are ordered by `O`
+ *
+ * `ItemOrder::kDescendingCount` reduces the work of `Index()` and `Get()` when
+ * the input sequence has a frequent value, such as the blank of a board. The
+ * indices differ from `Permutations` with the same input sequence, and
+ * `DigitValues()` tells the order. For more detail, see the description of
+ * `Permutations`.
+ *
+ * # Example
+ *
+ * ```
+ * constexpr PermutationsWithOrder<ItemOrder::kDescendingCount, std::size_t,
+ *                                 Kind, C, B, B, A, A, A> p;
+ * p.DigitValues();  // {A, B, C}
+ * ```
+ *
+ * @tparam O     The order of `ItemCount`s
+ * @tparam I     An unsigned integer type. (See `detail::IsIndexType`)
+ * @tparam T     An integer or enum
+ * @tparam Vals  A sequence of type `T`. (duplication of values are permitted)
+ */
+template <ItemOrder O, typename I, typename T, T... Vals>
+using PermutationsWithOrder = typename detail::MakePermutationsImpl<
+    detail::ValueSet<T, Vals...>, I,
+    std::make_index_sequence<
+        detail::ValueSummary<detail::ValueSet<T, Vals...>, O>::kValue.size>,
+    O>::type;
 
 #if __cplusplus >= 201703L
 /**
@@ -651,9 +4400,10 @@ using Permutations = typename detail::MakePermutationsImpl<
  */
 template <auto Val, decltype(Val)... Vals>
 using PermutationsAuto = typename detail::MakePermutationsImpl<
-    detail::ValueSet<decltype(Val), Val, Vals...>,
+    detail::ValueSet<decltype(Val), Val, Vals...>, std::size_t,
     std::make_index_sequence<
-        detail::UniqueCount<decltype(Val), Val, Vals...>()>>::type;
+        detail::ValueSummary<detail::ValueSet<decltype(Val), Val, Vals...>>::
+            kValue.size>>::type;
 #endif  // __cplusplus >= 201703L
 }  // namespace komoperm
 
@@ -0,0 +1,239 @@
+// MIT License
+//
+// Copyright (c) 2022 komori-n(Toshinori Tsuboi)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef KOMORI_PARALLEL_HPP_
+#define KOMORI_PARALLEL_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "komoperm.hpp"
+
+namespace komoperm {
+namespace detail {
+/**
+ * @brief The smallest chunk size that splits `range` permutations into chunks
+ * numbered by `std::size_t`
+ *
+ * Each of `num_threads` threads increments the chunk counter once more after
+ * the last chunk, so the number of chunks is at most `SIZE_MAX - num_threads`
+ * to keep the counter from wrapping around. It matters only if `I` is wider
+ * than `std::size_t`.
+ */
+template <typename I>
+inline I MinChunkSize(I range, std::size_t num_threads) noexcept {
+  const I max_chunks =
+      static_cast<I>(std::numeric_limits<std::size_t>::max() - num_threads);
+  return range / max_chunks + (range % max_chunks != 0 ? 1 : 0);
+}
+}  // namespace detail
+
+/**
+ * @brief Call `fn(index, perm)` for all permutations whose indices are in
+ * [`first`, `last`) by `num_threads` threads.
+ *
+ * The range is split into small chunks, and each thread repeatedly takes the
+ * next unprocessed chunk. Therefore, even if the cost of `fn` is skewed, idle
+ * threads keep taking the remaining work. Each chunk seeds its own iterator
+ * via `Permutations::At()`, and then steps it sequentially.
+ *
+ * `fn` may be called concurrently from multiple threads. If `fn` throws an
+ * exception, the remaining chunks are abandoned and the first exception is
+ * rethrown after all threads are joined.
+ *
+ * # Example
+ *
+ * ```
+ * constexpr Permutations<int, 0, 0, 1, 1, 2> p;
+ * std::vector<int> table(p.Size());
+ * ForEachParallel(p, 0, p.Size(), [&](std::size_t index, const auto& perm) {
+ *   table[index] = Evaluate(perm);
+ * });
+ * ```
+ *
+ * @param num_threads  The number of threads. If it is 0, the number of the
+ *                     hardware threads is used.
+ * @param chunk_size   The number of permutations in a chunk. If it is 0, a
+ *                     proper size is chosen from the range and `num_threads`.
+ *                     It is raised to `detail::MinChunkSize()` if the chunks
+ *                     are too many to be counted by `std::size_t`.
+ */
+template <typename Perms, typename Fn, typename I = typename Perms::index_type>
+inline void ForEachParallel(const Perms& perms,
+                            typename Perms::index_type first,
+                            typename Perms::index_type last, Fn&& fn,
+                            std::size_t num_threads = 0,
+                            typename Perms::index_type chunk_size = 0) {
+  if (first > last || last > perms.Size()) {
+    throw std::runtime_error("Index out of range");
+  }
+
+  if (num_threads == 0) {
+    num_threads = std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+  }
+  if (chunk_size == 0) {
+    // Create enough chunks per thread to balance skewed workloads
+    constexpr std::size_t kChunksPerThread = 16;
+    chunk_size = std::max<I>(
+        (last - first) / static_cast<I>(num_threads * kChunksPerThread), 1);
+  }
+  // The chunks are numbered from `first` by `std::size_t`, which may be
+  // narrower than `I`.
+  chunk_size =
+      std::max(chunk_size, detail::MinChunkSize<I>(last - first, num_threads));
+
+  const I num_chunks = (last - first + chunk_size - 1) / chunk_size;
+  std::atomic<std::size_t> next_chunk{0};
+  std::exception_ptr error = nullptr;
+  std::mutex error_mutex;
+  auto worker = [&]() {
+    try {
+      for (;;) {
+        const I chunk = next_chunk.fetch_add(1);
+        if (chunk >= num_chunks) {
+          break;
+        }
+
+        const I begin = first + chunk * chunk_size;
+        const I end = std::min(last - begin, chunk_size) + begin;
+        auto itr = perms.At(begin);
+        for (I i = begin; i < end; ++i, ++itr) {
+          fn(i, *itr);
+        }
+      }
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(error_mutex);
+      if (!error) {
+        error = std::current_exception();
+      }
+      next_chunk.store(static_cast<std::size_t>(num_chunks));
+    }
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads - 1);
+  try {
+    for (std::size_t i = 1; i < num_threads; ++i) {
+      threads.emplace_back(worker);
+    }
+  } catch (const std::system_error&) {
+    // Continue with the threads which have been already created.
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+/**
+ * @brief The options of `BuildTable()`
+ */
+struct BuildTableOptions {
+  /// The number of threads. If it is 0, the number of the hardware threads is
+  /// used.
+  std::size_t num_threads{0};
+  /// The number of values in a chunk. If it is 0, a proper size is chosen. It
+  /// is rounded up to a multiple of `TableChunkGranularity<V>()`.
+  std::size_t chunk_size{0};
+};
+
+/// The bytes of a page, which each chunk of `BuildTable()` fills entirely
+constexpr std::size_t kTablePageBytes = 4096;
+
+/**
+ * @brief The smallest number of `V`s whose bytes are a multiple of
+ * `kTablePageBytes`
+ */
+template <typename V>
+constexpr std::size_t TableChunkGranularity() noexcept {
+  constexpr std::size_t kLowestBit = sizeof(V) & (~sizeof(V) + 1);
+  return kTablePageBytes /
+         (kLowestBit < kTablePageBytes ? kLowestBit : kTablePageBytes);
+}
+
+/**
+ * @brief Set `out[index]` to `fn(perm)` for all permutations in parallel.
+ *
+ * The table is built by `ForEachParallel()`, so each chunk unranks its first
+ * permutation once and steps the rest by the successor. The chunk size is a
+ * multiple of `TableChunkGranularity<V>()`. Therefore, if `out` is aligned to
+ * `kTablePageBytes` and not touched yet, e.g. allocated by `mmap()`, each page
+ * is first touched by the single thread which writes it, and it is placed on
+ * the NUMA node of that thread.
+ *
+ * # Example
+ *
+ * ```
+ * constexpr Permutations<int, 0, 0, 1, 1, 2> p;
+ * std::vector<float> table(p.Size());
+ * BuildTable(p, [](const auto& perm) { return Evaluate(perm); },
+ *            table.data(), table.size());
+ * ```
+ *
+ * @param out   The output region of `size` values
+ * @param size  It must be `perms.Size()`.
+ */
+template <typename Perms, typename Fn, typename V>
+inline void BuildTable(const Perms& perms, Fn&& fn, V* out,
+                       typename Perms::index_type size,
+                       const BuildTableOptions& options = {}) {
+  using I = typename Perms::index_type;
+  if (size != perms.Size()) {
+    throw std::runtime_error("The size of `out` is illegal");
+  }
+
+  std::size_t num_threads = options.num_threads;
+  if (num_threads == 0) {
+    num_threads = std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+  }
+  I chunk_size = options.chunk_size;
+  if (chunk_size == 0) {
+    // The same number of chunks per thread as `ForEachParallel()`
+    constexpr std::size_t kChunksPerThread = 16;
+    chunk_size = size / static_cast<I>(num_threads * kChunksPerThread);
+  }
+  constexpr I kGranularity = TableChunkGranularity<V>();
+  chunk_size = std::max<I>((chunk_size + kGranularity - 1) / kGranularity, 1) *
+               kGranularity;
+
+  ForEachParallel(
+      perms, 0, size,
+      [&](I index, const auto& perm) { out[index] = fn(perm); }, num_threads,
+      chunk_size);
+}
+}  // namespace komoperm
+
+#endif  // KOMORI_PARALLEL_HPP_
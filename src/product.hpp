@@ -0,0 +1,329 @@
+// MIT License
+//
+// Copyright (c) 2022 komori-n(Toshinori Tsuboi)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef KOMORI_PRODUCT_HPP_
+#define KOMORI_PRODUCT_HPP_
+
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "komoperm.hpp"
+
+namespace komoperm {
+namespace detail {
+/**
+ * @brief `true` iff all types in `Is...` are `I`.
+ */
+template <typename I, typename... Is>
+inline constexpr bool AllSame() noexcept {
+  bool ret = true;
+  ConsumeValues({(ret = ret && std::is_same<I, Is>::value)...});
+  return ret;
+}
+
+/**
+ * @brief `true` iff the product of `sizes...` is representable by `I`.
+ */
+template <typename I, typename... Is>
+inline constexpr bool IsProductRepresentable(Is... sizes) noexcept {
+  I product = 1;
+  bool ok = true;
+  ConsumeValues({(ok = ok && std::numeric_limits<I>::max() / product >= sizes,
+                  product *= sizes)...});
+  return ok;
+}
+}  // namespace detail
+
+/**
+ * @brief The Cartesian product of several permutations, e.g. the placement of
+ * pieces, the pieces in hand, and the side to move
+ *
+ * An element is a tuple of one permutation per component. The index is a
+ * mixed radix number whose lowest digit is the index of `Ps[0]`:
+ *
+ *     index = i_0 + Size_0 * (i_1 + Size_1 * (i_2 + ...))
+ *
+ * The digits of all `ItemCount`s of all components are decoded by one chain
+ * of constant divisions (`GetAndDivide()`), instead of dividing the index by
+ * each `Size_k` before decoding each component.
+ *
+ * # Example
+ *
+ * ```
+ * using Board = Permutations<int, 0, 0, 0, 1, 1, 2>;
+ * using Hand = Permutations<int, 0, 0, 1>;
+ * constexpr ProductPermutations<Board, Hand> p;
+ *
+ * const auto index = p.Index({0, 1, 0, 2, 0, 1}, {1, 0, 0});
+ * const auto state = p.Get(index);  // {{0, 1, 0, 2, 0, 1}, {1, 0, 0}}
+ * ```
+ *
+ * @tparam Ps  The permutations of the components. They must have the same
+ *             index type.
+ */
+template <typename... Ps>
+class ProductPermutations {
+  static_assert(sizeof...(Ps) >= 1, "At least one component is required");
+
+  using First = std::tuple_element_t<0, std::tuple<Ps...>>;
+  using Indices = std::make_index_sequence<sizeof...(Ps)>;
+  template <typename P>
+  using PermOf = decltype(std::declval<const P&>().Get(0));
+  template <typename P>
+  using ValueOf = std::decay_t<decltype(std::declval<const PermOf<P>&>()[0])>;
+  template <std::size_t C>
+  using Component = std::tuple_element_t<C, std::tuple<Ps...>>;
+
+ public:
+  /// The index type
+  using index_type = typename First::index_type;
+  /// The tuple of the permutations of the components
+  using value_type = std::tuple<PermOf<Ps>...>;
+
+  static_assert(detail::AllSame<index_type, typename Ps::index_type...>(),
+                "All components must have the same index type");
+  static_assert(detail::IsProductRepresentable<index_type>(Ps{}.Size()...),
+                "The number of elements must be representable by index_type");
+
+  /// The number of components
+  static constexpr std::size_t Components() noexcept { return sizeof...(Ps); }
+
+  /**
+   * @brief The number of elements, i.e. the product of the sizes of the
+   * components
+   */
+  constexpr index_type Size() const noexcept { return SizeImpl(); }
+
+  /**
+   * @brief Get the index for the permutations of all components.
+   *
+   * `vals` are passed to `Ps::Index()` respectively, and it throws if any of
+   * them is illegal.
+   */
+  template <typename... Containers,
+            detail::Constraints<std::enable_if_t<sizeof...(Containers) ==
+                                                 sizeof...(Ps)>> = nullptr>
+  constexpr index_type Index(const Containers&... vals) const {
+    return IndexParts(vals...);
+  }
+
+  /**
+   * @brief Get the index for the permutations of all components.
+   */
+  constexpr index_type Index(const PermOf<Ps>&... vals) const {
+    return IndexParts(vals...);
+  }
+
+  /**
+   * @brief Get the index for an element, e.g. a result of `Get()`.
+   */
+  constexpr index_type Index(const value_type& vals) const {
+    return IndexTuple(vals, Indices{});
+  }
+
+  /**
+   * @brief Get `index`'th element.
+   */
+  constexpr value_type Get(index_type index) const {
+    if (index >= Size()) {
+      KOMOPERM_THROW(std::runtime_error("Index out of range"));
+    }
+    return GetUnchecked(index);
+  }
+
+  /**
+   * @brief Get `index`'th element without validation. precondition:
+   * `index < Size()`
+   */
+  constexpr value_type GetUnchecked(index_type index) const noexcept {
+    // The arguments of a braced initializer are evaluated in order, so the
+    // components are decoded from the lowest digits.
+    return value_type{Ps{}.GetAndDivide(index)...};
+  }
+
+  /**
+   * @brief Get indices for `count` elements at once.
+   *
+   * `in[k]` is the input of `Ps[k]::IndexBatch()`, i.e. the `i`th permutation
+   * of the `k`th component is stored contiguously from `in[k] + i * N_k`.
+   * Each component ranks its rows by blocks, and the digits are combined.
+   */
+  void IndexBatch(const ValueOf<Ps>*... in, std::size_t count,
+                  index_type* out) const {
+    constexpr std::size_t kBlock = 64;
+    for (std::size_t offset = 0; offset < count; offset += kBlock) {
+      const std::size_t len =
+          count - offset < kBlock ? count - offset : kBlock;
+      index_type digits[kBlock]{};
+      index_type base = 1;
+      for (std::size_t r = 0; r < len; ++r) {
+        out[offset + r] = 0;
+      }
+      detail::ConsumeValues(
+          {(Ps{}.IndexBatch(in + offset * Ps::Spaces(), len, digits),
+            AddDigits(digits, len, base, out + offset),
+            base *= Ps{}.Size())...});
+    }
+  }
+
+  /**
+   * @brief Get `idx[i]`'th element for `i` in [0, `count`) at once.
+   *
+   * The permutation of the `k`th component of the `i`th element is written
+   * from `out[k] + i * N_k`. Each index is decoded by one division chain.
+   */
+  void GetBatch(const index_type* idx, std::size_t count,
+                ValueOf<Ps>*... out) const {
+    for (std::size_t r = 0; r < count; ++r) {
+      index_type index = idx[r];
+      if (index >= Size()) {
+        KOMOPERM_THROW(std::runtime_error("Index out of range"));
+      }
+      detail::ConsumeValues({(WriteRow(Ps{}.GetAndDivide(index),
+                                       out + r * Ps::Spaces()),
+                              0)...});
+    }
+  }
+
+  /**
+   * @brief A forward iterator which visits the elements in index order
+   *
+   * The components are advanced like an odometer by their own iterators, so
+   * that the permutations of the higher components are rebuilt only on
+   * carries.
+   */
+  class Iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = ProductPermutations::value_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const value_type*;
+    using reference = const value_type&;
+
+    /// Construct an iterator that points to the first element.
+    constexpr Iterator() noexcept : Iterator(0) {}
+
+    constexpr reference operator*() const noexcept { return value_; }
+    constexpr pointer operator->() const noexcept { return &value_; }
+
+    constexpr Iterator& operator++() noexcept {
+      ++index_;
+      Advance(std::integral_constant<std::size_t, 0>{});
+      return *this;
+    }
+
+    constexpr Iterator operator++(int) noexcept {
+      Iterator tmp = *this;
+      ++*this;
+      return tmp;
+    }
+
+    constexpr bool operator==(const Iterator& rhs) const noexcept {
+      return index_ == rhs.index_;
+    }
+    constexpr bool operator!=(const Iterator& rhs) const noexcept {
+      return !(*this == rhs);
+    }
+
+   private:
+    friend class ProductPermutations;
+
+    explicit constexpr Iterator(index_type index) noexcept
+        : index_(index), value_(ProductPermutations{}.GetUnchecked(0)) {}
+
+    /// Advance the `C`th component, and the next one if it wraps around.
+    template <std::size_t C>
+    constexpr void Advance(std::integral_constant<std::size_t, C>) noexcept {
+      auto& it = std::get<C>(iters_);
+      if (++it == Component<C>{}.end()) {
+        it = Component<C>{}.begin();
+        std::get<C>(value_) = *it;
+        Advance(std::integral_constant<std::size_t, C + 1>{});
+      } else {
+        std::get<C>(value_) = *it;
+      }
+    }
+
+    /// All components wrapped around, i.e. `index_ == Size()`.
+    constexpr void Advance(
+        std::integral_constant<std::size_t, sizeof...(Ps)>) noexcept {}
+
+    index_type index_;
+    std::tuple<typename Ps::Iterator...> iters_{};
+    value_type value_;
+  };
+
+  /**
+   * @brief An iterator to the first element (`Get(0)`)
+   */
+  constexpr Iterator begin() const noexcept { return Iterator{}; }
+
+  /**
+   * @brief A past-the-end iterator
+   */
+  constexpr Iterator end() const noexcept { return Iterator{SizeImpl()}; }
+
+ private:
+  static constexpr index_type SizeImpl() noexcept {
+    index_type ret = 1;
+    detail::ConsumeValues({ret *= Ps{}.Size()...});
+    return ret;
+  }
+
+  template <typename... Containers>
+  constexpr index_type IndexParts(const Containers&... vals) const {
+    index_type index = 0;
+    index_type base = 1;
+    detail::ConsumeValues(
+        {(index += base * Ps{}.Index(vals), base *= Ps{}.Size())...});
+    return index;
+  }
+
+  template <std::size_t... Is>
+  constexpr index_type IndexTuple(const value_type& vals,
+                                  std::index_sequence<Is...>) const {
+    return Index(std::get<Is>(vals)...);
+  }
+
+  /// `out[r] += base * digits[r]` for `r` in [0, `len`)
+  static void AddDigits(const index_type* digits, std::size_t len,
+                        index_type base, index_type* out) noexcept {
+    for (std::size_t r = 0; r < len; ++r) {
+      out[r] += base * digits[r];
+    }
+  }
+
+  template <typename Perm, typename V>
+  static void WriteRow(const Perm& perm, V* out) noexcept {
+    for (std::size_t i = 0; i < perm.size(); ++i) {
+      out[i] = perm[i];
+    }
+  }
+};
+}  // namespace komoperm
+
+#endif  // KOMORI_PRODUCT_HPP_
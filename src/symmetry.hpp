@@ -0,0 +1,389 @@
+// MIT License
+//
+// Copyright (c) 2022 komori-n(Toshinori Tsuboi)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef KOMORI_SYMMETRY_HPP_
+#define KOMORI_SYMMETRY_HPP_
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <initializer_list>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "komoperm.hpp"
+
+namespace komoperm {
+/**
+ * @brief A dense index over the orbits of permutations under a group of slot
+ * transforms
+ *
+ * A transform `t` maps a permutation `perm` to `perm'` with
+ * `perm'[i] == perm[t[i]]`, e.g. reversal, rotation or mirroring of a board.
+ * The group is generated by the given transforms. Each orbit is represented
+ * by its permutation of the smallest `Perms::Index()`, and the
+ * representatives are numbered in ascending order of it. So a table indexed
+ * by `Index()` needs about `perms.Size() / GroupSize()` entries.
+ *
+ * The orbits are not ranked combinatorially. Instead, the constructor sweeps
+ * all `perms.Size()` permutations by the iterator, and only each
+ * representative applies the group to mark the rest of its orbit. So the setup
+ * takes about `perms.Size()` iterator steps plus `perms.Size()` calls of
+ * `IndexUnchecked()`, i.e. about the cost of building the unreduced table
+ * once, and `perms.Size()` must not exceed `kMaxSize`. The object keeps one
+ * bit per permutation and a rank per 512 bits, i.e. about `perms.Size() / 7`
+ * bytes whatever the group is. The saving by the symmetry factor is in the
+ * tables indexed by `Index()`, not in this object.
+ *
+ * `Index()` applies all `GroupSize()` transforms and ranks the representative
+ * in O(1) steps. `Get()` selects the representative by a binary search over
+ * the ranks.
+ *
+ * # Example
+ *
+ * ```
+ * constexpr Permutations<int, 0, 0, 1, 1, 2> p;
+ * using Symmetric = SymmetricPermutations<decltype(p)>;
+ * const Symmetric s(p, {Symmetric::Reversal()});
+ *
+ * const auto canonical = s.Index({2, 1, 1, 0, 0});
+ * const auto perm = s.Get(canonical.index);  // {0, 0, 1, 1, 2}
+ * // s.Apply(canonical.transform, {2, 1, 1, 0, 0}) == perm
+ * ```
+ *
+ * @tparam Perms  The permutations, e.g. `Permutations<T, Vals...>`
+ */
+template <typename Perms>
+class SymmetricPermutations {
+ public:
+  /// The index type
+  using index_type = typename Perms::index_type;
+  /// The type of a permutation
+  using Perm = decltype(std::declval<const Perms&>().Get(0));
+  /// `perm'[i] == perm[t[i]]` for transform `t`
+  using Transform = std::array<std::size_t, Perms::Spaces()>;
+
+  /// The maximum `Size()` of `Perms`, whose bitmap takes 512 MiB
+  static constexpr std::uint64_t kMaxSize = std::uint64_t{1} << 32;
+
+  /**
+   * @brief A dense index of an orbit and the transform to its representative
+   *
+   * `Apply(transform, perm) == Get(index)` holds for the input `perm`.
+   */
+  struct CanonicalIndex {
+    index_type index;
+    std::size_t transform;
+  };
+
+  /**
+   * @brief Construct the orbits of `perms` under the group generated by
+   * `generators`
+   *
+   * It throws if any of `generators` is not a permutation of the slots, or
+   * `perms.Size()` exceeds `kMaxSize`.
+   */
+  SymmetricPermutations(const Perms& perms, std::vector<Transform> generators)
+      : perms_(perms) {
+    if (perms_.Size() > kMaxSize) {
+      KOMOPERM_THROW(
+          std::runtime_error("Too many permutations to enumerate the orbits"));
+    }
+    MakeGroup(std::move(generators));
+    MakeRepresentatives();
+  }
+
+  /**
+   * @brief The reversal of the slots
+   */
+  static Transform Reversal() noexcept {
+    Transform ret{};
+    for (std::size_t i = 0; i < Perms::Spaces(); ++i) {
+      ret[i] = Perms::Spaces() - 1 - i;
+    }
+    return ret;
+  }
+
+  /**
+   * @brief The cyclic rotation of the slots by `shift` to the left
+   */
+  static Transform Rotation(std::size_t shift) noexcept {
+    Transform ret{};
+    for (std::size_t i = 0; i < Perms::Spaces(); ++i) {
+      ret[i] = (i + shift) % Perms::Spaces();
+    }
+    return ret;
+  }
+
+  /**
+   * @brief Apply `Transforms()[transform]` to `perm`.
+   */
+  template <typename Container>
+  Perm Apply(std::size_t transform, const Container& perm) const {
+    if (transform >= group_.size()) {
+      KOMOPERM_THROW(std::runtime_error("Index out of range"));
+    }
+    if (perm.size() != Perms::Spaces()) {
+      KOMOPERM_THROW(std::runtime_error("The size of `vals` is illegal"));
+    }
+
+    return ApplyImpl(group_[transform], perm.begin());
+  }
+
+  /**
+   * @brief Apply `Transforms()[transform]` to `perm`.
+   */
+  template <typename T>
+  Perm Apply(std::size_t transform, std::initializer_list<T> perm) const {
+    return Apply<std::initializer_list<T>>(transform, perm);
+  }
+
+  /**
+   * @brief The number of orbits
+   */
+  index_type Size() const noexcept { return size_; }
+
+  /**
+   * @brief The number of transforms in the group, including the identity
+   */
+  std::size_t GroupSize() const noexcept { return group_.size(); }
+
+  /**
+   * @brief All transforms in the group. `Transforms()[0]` is the identity.
+   */
+  const std::vector<Transform>& Transforms() const noexcept { return group_; }
+
+  /**
+   * @brief Get the orbit index of `perm` and the transform to its
+   * representative.
+   */
+  template <typename Container>
+  CanonicalIndex Index(const Container& perm) const {
+    CanonicalIndex ret{perms_.Index(perm), 0};
+    ret.index = Rank(Canonicalize(perm.begin(), ret.index, ret.transform));
+    return ret;
+  }
+
+  /**
+   * @brief Get the orbit index of `perm` and the transform to its
+   * representative.
+   */
+  template <typename T>
+  CanonicalIndex Index(std::initializer_list<T> perm) const {
+    return Index<std::initializer_list<T>>(perm);
+  }
+
+  /**
+   * @brief Get the representative of `index`'th orbit.
+   */
+  Perm Get(index_type index) const {
+    if (index >= Size()) {
+      KOMOPERM_THROW(std::runtime_error("Index out of range"));
+    }
+
+    return perms_.Get(Select(index));
+  }
+
+  /**
+   * @brief Get the representative of `index`'th orbit.
+   */
+  Perm operator[](index_type index) const { return Get(index); }
+
+  /**
+   * @brief The index in `Perms` of the representative of `index`'th orbit
+   */
+  index_type RepresentativeIndex(index_type index) const {
+    if (index >= Size()) {
+      KOMOPERM_THROW(std::runtime_error("Index out of range"));
+    }
+
+    return Select(index);
+  }
+
+ private:
+  template <typename Iterator>
+  static Perm ApplyImpl(const Transform& t, Iterator perm) {
+    Perm ret{};
+    for (std::size_t i = 0; i < Perms::Spaces(); ++i) {
+      ret[i] = perm[t[i]];
+    }
+    return ret;
+  }
+
+  /**
+   * @brief The composition of the group and `generators`
+   *
+   * The products are added until no new transform appears. As the group is
+   * finite, the inverse of each transform is also reached.
+   */
+  void MakeGroup(std::vector<Transform> generators) {
+    Transform identity{};
+    for (std::size_t i = 0; i < Perms::Spaces(); ++i) {
+      identity[i] = i;
+    }
+
+    for (const auto& g : generators) {
+      Transform sorted = g;
+      std::sort(sorted.begin(), sorted.end());
+      if (sorted != identity) {
+        KOMOPERM_THROW(std::runtime_error("Transform is illegal"));
+      }
+    }
+
+    group_.push_back(identity);
+    for (std::size_t k = 0; k < group_.size(); ++k) {
+      for (const auto& g : generators) {
+        // Apply `group_[k]` after `g`.
+        Transform product{};
+        for (std::size_t i = 0; i < Perms::Spaces(); ++i) {
+          product[i] = g[group_[k][i]];
+        }
+        if (std::find(group_.begin(), group_.end(), product) == group_.end()) {
+          group_.push_back(product);
+        }
+      }
+    }
+  }
+
+  /**
+   * @brief The smallest index in the orbit of `perm`, where `index` is the
+   * index of `perm`. The transform to it is written to `transform`.
+   */
+  template <typename Iterator>
+  index_type Canonicalize(Iterator perm, index_type index,
+                          std::size_t& transform) const noexcept {
+    transform = 0;
+    for (std::size_t k = 1; k < group_.size(); ++k) {
+      const index_type image =
+          perms_.IndexUnchecked(ApplyImpl(group_[k], perm));
+      if (image < index) {
+        index = image;
+        transform = k;
+      }
+    }
+    return index;
+  }
+
+  /// The number of words in a block of `ranks_`
+  static constexpr std::size_t kBlockWords = 8;
+
+  /// `true` iff the `index`th permutation is not a representative
+  bool Marked(std::size_t index) const noexcept {
+    return (marked_[index / 64] >> (index % 64)) & 1;
+  }
+
+  /**
+   * @brief Mark all permutations but the representatives.
+   *
+   * If the `index`th permutation is not marked when it is visited, it has the
+   * smallest index in its orbit, because the representatives of the smaller
+   * indices have marked their whole orbits. Then it marks the rest of its
+   * orbit, all of whose indices are larger.
+   */
+  void MakeRepresentatives() {
+    const std::size_t size = static_cast<std::size_t>(perms_.Size());
+    const std::size_t num_words = size / 64 + 1;
+    marked_.assign(num_words, 0);
+    // The bits past the last permutation are never representatives.
+    marked_[size / 64] = ~detail::LowMask(size % 64);
+
+    std::size_t index = 0;
+    for (const auto& perm : perms_) {
+      if (!Marked(index)) {
+        for (std::size_t k = 1; k < group_.size(); ++k) {
+          const auto image = static_cast<std::size_t>(
+              perms_.IndexUnchecked(ApplyImpl(group_[k], perm.begin())));
+          marked_[image / 64] |= std::uint64_t{1} << (image % 64);
+        }
+        // A transform in the stabilizer maps it to itself.
+        marked_[index / 64] &= ~(std::uint64_t{1} << (index % 64));
+      }
+      ++index;
+    }
+
+    ranks_.assign(num_words / kBlockWords + 1, 0);
+    index_type rank = 0;
+    for (std::size_t w = 0; w < num_words; ++w) {
+      if (w % kBlockWords == 0) {
+        ranks_[w / kBlockWords] = rank;
+      }
+      rank += static_cast<index_type>(detail::PopCount(~marked_[w]));
+    }
+    size_ = rank;
+  }
+
+  /// The number of representatives whose indices are less than `index`
+  index_type Rank(index_type index) const noexcept {
+    const std::size_t i = static_cast<std::size_t>(index);
+    const std::size_t word = i / 64;
+    index_type ret = ranks_[word / kBlockWords];
+    for (std::size_t w = word - word % kBlockWords; w < word; ++w) {
+      ret += static_cast<index_type>(detail::PopCount(~marked_[w]));
+    }
+    return ret + static_cast<index_type>(detail::PopCount(
+                     ~marked_[word] & detail::LowMask(i % 64)));
+  }
+
+  /// The index of the `rank`th representative
+  index_type Select(index_type rank) const noexcept {
+    // The last block whose first rank is not greater than `rank`
+    const auto block =
+        std::upper_bound(ranks_.begin(), ranks_.end(), rank) - ranks_.begin() -
+        1;
+    rank -= ranks_[static_cast<std::size_t>(block)];
+    for (std::size_t w = static_cast<std::size_t>(block) * kBlockWords;;
+         ++w) {
+      std::uint64_t free = ~marked_[w];
+      const index_type count = static_cast<index_type>(detail::PopCount(free));
+      if (rank < count) {
+        for (; rank > 0; --rank) {
+          free &= free - 1;
+        }
+        return static_cast<index_type>(w * 64 + detail::LowestBit(free));
+      }
+      rank -= count;
+    }
+  }
+
+  Perms perms_;
+  /// The transforms in the group. `group_[0]` is the identity.
+  std::vector<Transform> group_;
+  /// The `i`th bit is set iff the `i`th permutation is not a representative
+  std::vector<std::uint64_t> marked_;
+  /// ranks_[b] = The number of representatives before the `b`th block
+  std::vector<index_type> ranks_;
+  /// The number of representatives
+  index_type size_{0};
+};
+
+// The out-of-class definition is required if `kMaxSize` is odr-used in C++14.
+template <typename Perms>
+constexpr std::uint64_t SymmetricPermutations<Perms>::kMaxSize;
+
+// The out-of-class definition is required if `kBlockWords` is odr-used in
+// C++14.
+template <typename Perms>
+constexpr std::size_t SymmetricPermutations<Perms>::kBlockWords;
+}  // namespace komoperm
+
+#endif  // KOMORI_SYMMETRY_HPP_
@@ -0,0 +1,484 @@
+// MIT License
+//
+// Copyright (c) 2022 komori-n(Toshinori Tsuboi)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef KOMORI_TABLE_HPP_
+#define KOMORI_TABLE_HPP_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "komoperm.hpp"
+#include "parallel.hpp"
+
+namespace komoperm {
+namespace detail {
+/// The magic number at the beginning of a table file
+constexpr char kTableMagic[8] = {'K', 'O', 'M', 'O', 'P', 'E', 'R', 'M'};
+/// The version of the table file format
+constexpr std::uint32_t kTableVersion = 2;
+/**
+ * @brief The offset of the values in a table file
+ *
+ * The header is padded to `kTablePageBytes`, so the values start at a page
+ * boundary of the mapping, and each chunk of `BuildTable()` covers whole
+ * pages of the file.
+ */
+constexpr std::uint64_t kTableDataOffset = kTablePageBytes;
+
+/**
+ * @brief The header of a table file
+ *
+ * The values start at `data_offset` bytes from the beginning of the file in
+ * index order, and the bytes between the header and them are zero. All fields
+ * are in the native byte order.
+ */
+struct TableHeader {
+  char magic[8];
+  std::uint32_t version;
+  /// `sizeof` the value type
+  std::uint32_t value_size;
+  /// The signature of the input sequence. See `TableSignature`.
+  std::uint64_t signature;
+  /// The number of spaces
+  std::uint64_t spaces;
+  /// The number of values, i.e. `Size()` of the permutations
+  std::uint64_t size;
+  /// The offset of the values, i.e. `kTableDataOffset`
+  std::uint64_t data_offset;
+  std::uint8_t reserved[16];
+};
+
+static_assert(sizeof(TableHeader) == 64, "TableHeader must be 64 bytes");
+
+/**
+ * @brief The FNV-1a hash of `x` in little endian, following `hash`
+ */
+inline constexpr std::uint64_t Fnv1a(std::uint64_t hash,
+                                     std::uint64_t x) noexcept {
+  for (std::size_t i = 0; i < 8; ++i) {
+    hash = (hash ^ ((x >> (i * 8)) & 0xff)) * 0x100'0000'01b3ULL;
+  }
+  return hash;
+}
+
+/**
+ * @brief The signature of the input sequence of `Perms`
+ *
+ * It hashes `sizeof(T)` and the value and the count of each `ItemCount` in
+ * order, so it differs if the multiset or the index order differs.
+ */
+template <typename Perms>
+struct TableSignature;
+
+template <typename T, typename I, std::size_t N, std::size_t M,
+          typename... ICs>
+struct TableSignature<PermutationsImpl<T, I, N, M, ICs...>> {
+  static constexpr std::uint64_t Calc() noexcept {
+    using Integer = typename IntegerOf<T>::type;
+    const Integer vals[] = {static_cast<Integer>(ICs::Value())...};
+    const std::size_t counts[] = {ICs::Count()...};
+    std::uint64_t ret = Fnv1a(0xcbf2'9ce4'8422'2325ULL, sizeof(T));
+    for (std::size_t k = 0; k < sizeof...(ICs); ++k) {
+      ret = Fnv1a(ret, static_cast<std::uint64_t>(vals[k]));
+      ret = Fnv1a(ret, counts[k]);
+    }
+    return ret;
+  }
+};
+
+/**
+ * @brief Whether `Size()` of `Perms` fits in `TableHeader::size`
+ *
+ * It may be false if the index type is wider than 64 bits, e.g.
+ * `unsigned __int128`.
+ */
+template <typename Perms>
+constexpr bool IsTableSizeRepresentable() noexcept {
+  return Perms{}.Size() <= std::numeric_limits<std::uint64_t>::max();
+}
+
+/**
+ * @brief The header of the table of `V` for `Perms`
+ */
+template <typename Perms, typename V>
+inline TableHeader MakeTableHeader() noexcept {
+  static_assert(IsTableSizeRepresentable<Perms>(),
+                "The number of values of a table must fit in 64 bits");
+
+  TableHeader ret{};
+  std::memcpy(ret.magic, kTableMagic, sizeof(kTableMagic));
+  ret.version = kTableVersion;
+  ret.value_size = sizeof(V);
+  ret.signature = TableSignature<Perms>::Calc();
+  ret.spaces = Perms::Spaces();
+  ret.size = static_cast<std::uint64_t>(Perms{}.Size());
+  ret.data_offset = kTableDataOffset;
+  return ret;
+}
+
+/**
+ * @brief The length of the table file of `V` described by `header`
+ */
+template <typename V>
+inline std::size_t TableLength(const TableHeader& header) {
+  constexpr std::uint64_t kMaxLength = std::numeric_limits<std::size_t>::max();
+  if (header.size > (kMaxLength - header.data_offset) / sizeof(V)) {
+    throw std::runtime_error("The table is too large");
+  }
+  return static_cast<std::size_t>(header.data_offset + header.size * sizeof(V));
+}
+}  // namespace detail
+
+/**
+ * @brief A streaming writer of the table of `V` for `Perms`
+ *
+ * The values are pushed in index order and written through a buffer of
+ * `buffer_size` values. `Close()` must be called after pushing all
+ * `Size()` values. Otherwise, the table is rejected by `TableReader`.
+ *
+ * # Example
+ *
+ * ```
+ * constexpr Permutations<int, 0, 0, 1, 1, 2> p;
+ * TableWriter<decltype(p), float> writer("table.bin");
+ * for (const auto& perm : p) {
+ *   writer.Push(Evaluate(perm));
+ * }
+ * writer.Close();
+ * ```
+ *
+ * @tparam Perms  The permutations, e.g. `Permutations<T, Vals...>`
+ * @tparam V      The value type. It must be trivially copyable.
+ */
+template <typename Perms, typename V>
+class TableWriter {
+  static_assert(std::is_trivially_copyable<V>::value,
+                "V must be trivially copyable");
+
+ public:
+  /// The index type
+  using index_type = typename Perms::index_type;
+
+  /**
+   * @brief Create the table file at `path` and write the padded header.
+   */
+  explicit TableWriter(const std::string& path,
+                       std::size_t buffer_size = std::size_t{1} << 16)
+      : file_(std::fopen(path.c_str(), "wb")),
+        buffer_(buffer_size > 0 ? buffer_size : 1) {
+    if (file_ == nullptr) {
+      throw std::system_error(errno, std::generic_category(), path);
+    }
+
+    const auto header = detail::MakeTableHeader<Perms, V>();
+    std::vector<char> head(detail::kTableDataOffset);
+    std::memcpy(head.data(), &header, sizeof(header));
+    if (std::fwrite(head.data(), head.size(), 1, file_) != 1) {
+      std::fclose(file_);
+      throw std::runtime_error("Failed to write the table");
+    }
+  }
+
+  TableWriter(const TableWriter&) = delete;
+  TableWriter& operator=(const TableWriter&) = delete;
+
+  /**
+   * @brief Close the file without checking the number of pushed values.
+   */
+  ~TableWriter() {
+    if (file_ != nullptr) {
+      std::fclose(file_);
+    }
+  }
+
+  /**
+   * @brief The number of values pushed so far, i.e. the index of the next
+   * value
+   */
+  index_type Written() const noexcept { return written_; }
+
+  /**
+   * @brief Push the value of the next index.
+   */
+  void Push(const V& value) {
+    if (file_ == nullptr || written_ >= Perms{}.Size()) {
+      throw std::runtime_error("Index out of range");
+    }
+
+    buffer_[len_++] = value;
+    ++written_;
+    if (len_ == buffer_.size()) {
+      Flush();
+    }
+  }
+
+  /**
+   * @brief Flush the buffer and close the file.
+   *
+   * It throws if the number of pushed values is not `Size()`.
+   */
+  void Close() {
+    if (file_ == nullptr) {
+      return;
+    }
+
+    Flush();
+    const bool ok = std::fclose(file_) == 0;
+    file_ = nullptr;
+    if (!ok) {
+      throw std::runtime_error("Failed to write the table");
+    }
+    if (written_ != Perms{}.Size()) {
+      throw std::runtime_error("The table is incomplete");
+    }
+  }
+
+ private:
+  void Flush() {
+    if (len_ > 0 && std::fwrite(buffer_.data(), sizeof(V), len_, file_) !=
+                        len_) {
+      throw std::runtime_error("Failed to write the table");
+    }
+    len_ = 0;
+  }
+
+  std::FILE* file_;
+  std::vector<V> buffer_;
+  /// The number of values in `buffer_`
+  std::size_t len_{0};
+  index_type written_{0};
+};
+
+/**
+ * @brief A memory-mapped reader of the table of `V` for `Perms`
+ *
+ * The file written by `TableWriter` is mapped read-only, and the values are
+ * accessed without copying. They start at a page boundary, so `data()` is
+ * aligned to `kTablePageBytes`. The header is validated at open time, so a
+ * table for a different input sequence, value type or size is rejected.
+ *
+ * # Example
+ *
+ * ```
+ * constexpr Permutations<int, 0, 0, 1, 1, 2> p;
+ * const TableReader<decltype(p), float> table("table.bin");
+ * const float value = table[{1, 0, 2, 0, 1}];
+ * ```
+ *
+ * @tparam Perms  The permutations, e.g. `Permutations<T, Vals...>`
+ * @tparam V      The value type. It must be trivially copyable.
+ */
+template <typename Perms, typename V>
+class TableReader {
+  static_assert(std::is_trivially_copyable<V>::value,
+                "V must be trivially copyable");
+  static_assert(alignof(V) <= detail::kTableDataOffset,
+                "The values must be aligned after the header");
+
+ public:
+  /// The index type
+  using index_type = typename Perms::index_type;
+
+  /**
+   * @brief Map the table file at `path`.
+   */
+  explicit TableReader(const std::string& path) {
+    const auto expected = detail::MakeTableHeader<Perms, V>();
+    const std::size_t length = detail::TableLength<V>(expected);
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::system_error(errno, std::generic_category(), path);
+    }
+
+    struct stat st {};
+    if (::fstat(fd, &st) != 0) {
+      const int err = errno;
+      ::close(fd);
+      throw std::system_error(err, std::generic_category(), path);
+    }
+
+    if (static_cast<std::uint64_t>(st.st_size) != length) {
+      ::close(fd);
+      throw std::runtime_error("The table does not match");
+    }
+
+    length_ = length;
+    void* addr = ::mmap(nullptr, length_, PROT_READ, MAP_SHARED, fd, 0);
+    const int err = errno;
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+      throw std::system_error(err, std::generic_category(), path);
+    }
+    addr_ = addr;
+
+    if (std::memcmp(addr_, &expected, sizeof(expected)) != 0) {
+      Unmap();
+      throw std::runtime_error("The table does not match");
+    }
+  }
+
+  TableReader(TableReader&& rhs) noexcept
+      : addr_(std::exchange(rhs.addr_, nullptr)),
+        length_(std::exchange(rhs.length_, 0)) {}
+
+  TableReader& operator=(TableReader&& rhs) noexcept {
+    if (this != &rhs) {
+      Unmap();
+      addr_ = std::exchange(rhs.addr_, nullptr);
+      length_ = std::exchange(rhs.length_, 0);
+    }
+    return *this;
+  }
+
+  ~TableReader() { Unmap(); }
+
+  /**
+   * @brief The number of values
+   */
+  index_type Size() const noexcept { return Perms{}.Size(); }
+
+  /**
+   * @brief The values in index order
+   */
+  const V* data() const noexcept {
+    return reinterpret_cast<const V*>(static_cast<const char*>(addr_) +
+                                      detail::kTableDataOffset);
+  }
+
+  /**
+   * @brief The value of `index`
+   */
+  const V& At(index_type index) const {
+    if (index >= Size()) {
+      throw std::runtime_error("Index out of range");
+    }
+
+    return data()[index];
+  }
+
+  /**
+   * @brief The value of the given permutation
+   */
+  template <typename Container>
+  const V& operator[](const Container& perm) const {
+    return data()[Perms{}.Index(perm)];
+  }
+
+  /**
+   * @brief The value of the given permutation
+   */
+  template <typename T>
+  const V& operator[](std::initializer_list<T> perm) const {
+    return data()[Perms{}.Index(perm)];
+  }
+
+ private:
+  void Unmap() noexcept {
+    if (addr_ != nullptr) {
+      ::munmap(addr_, length_);
+      addr_ = nullptr;
+    }
+  }
+
+  void* addr_{nullptr};
+  std::size_t length_{0};
+};
+
+/**
+ * @brief Build the table file of `V` for `Perms` at `path` by `BuildTable()`.
+ *
+ * The file is mapped writable, and `fn(perm)` of each index is written into
+ * the mapping in place. The values start at a page boundary, so each chunk
+ * of `BuildTable()` first touches its own pages. The header is written last,
+ * so if `fn` throws, the incomplete table is rejected by `TableReader`.
+ *
+ * # Example
+ *
+ * ```
+ * constexpr Permutations<int, 0, 0, 1, 1, 2> p;
+ * BuildTableFile<float>(p, [](const auto& perm) { return Evaluate(perm); },
+ *                       "table.bin");
+ * const TableReader<decltype(p), float> table("table.bin");
+ * ```
+ */
+template <typename V, typename Perms, typename Fn>
+inline void BuildTableFile(const Perms& perms, Fn&& fn, const std::string& path,
+                           const BuildTableOptions& options = {}) {
+  static_assert(std::is_trivially_copyable<V>::value,
+                "V must be trivially copyable");
+
+  const auto header = detail::MakeTableHeader<Perms, V>();
+  const std::size_t length = detail::TableLength<V>(header);
+  const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(), path);
+  }
+
+  if (::ftruncate(fd, static_cast<off_t>(length)) != 0) {
+    const int err = errno;
+    ::close(fd);
+    throw std::system_error(err, std::generic_category(), path);
+  }
+
+  void* addr =
+      ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  const int err = errno;
+  ::close(fd);
+  if (addr == MAP_FAILED) {
+    throw std::system_error(err, std::generic_category(), path);
+  }
+
+  char* bytes = static_cast<char*>(addr);
+  try {
+    BuildTable(perms, std::forward<Fn>(fn),
+               reinterpret_cast<V*>(bytes + header.data_offset), perms.Size(),
+               options);
+  } catch (...) {
+    ::munmap(addr, length);
+    throw;
+  }
+  std::memcpy(bytes, &header, sizeof(header));
+
+  const bool ok = ::msync(addr, length, MS_SYNC) == 0;
+  ::munmap(addr, length);
+  if (!ok) {
+    throw std::runtime_error("Failed to write the table");
+  }
+}
+}  // namespace komoperm
+
+#endif  // KOMORI_TABLE_HPP_
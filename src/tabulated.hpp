@@ -0,0 +1,360 @@
+// MIT License
+//
+// Copyright (c) 2022 komori-n(Toshinori Tsuboi)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef KOMORI_TABULATED_HPP_
+#define KOMORI_TABULATED_HPP_
+
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+
+#include "komoperm.hpp"
+
+namespace komoperm {
+namespace detail {
+/// The maximum `Size()` of `TabulatedPermutations`
+constexpr std::size_t kMaxTabulatedSize = std::size_t{1} << 16;
+
+/**
+ * @brief A fixed size table for `TabulatedPermutations`
+ */
+template <typename V, std::size_t S>
+struct FlatTable {
+  V vals[S];
+};
+
+/**
+ * @brief The compile time calculations for `TabulatedPermutations`
+ *
+ * Each permutation is encoded in a row, where the `i`th slot occupies bits
+ * [`i * kBits`, `(i + 1) * kBits`) and holds the rank of the value in
+ * ascending order.
+ */
+template <typename Perms>
+struct TabulatedBase;
+
+template <typename T, typename I, std::size_t N, std::size_t M,
+          typename... ICs>
+struct TabulatedBase<PermutationsImpl<T, I, N, M, ICs...>> {
+  using Perms = PermutationsImpl<T, I, N, M, ICs...>;
+  using Levels = ValueLevels<T, ICs...>;
+
+  /// The number of distinct values
+  static constexpr std::size_t kLevels = sizeof...(ICs);
+  /// The number of bits per slot in a row
+  static constexpr std::size_t kBits = kLevels == 1 ? 1 : CeilLog2(kLevels);
+  /// The number of permutations
+  static constexpr std::size_t kSize = static_cast<std::size_t>(Perms{}.Size());
+  /// The number of bits of the hash values. The load factor is at most 1/2.
+  static constexpr std::size_t kHashBits = CeilLog2(2 * kSize);
+
+  static_assert(kSize <= kMaxTabulatedSize,
+                "TabulatedPermutations supports Size() <= 2^16");
+  static_assert(N * kBits <= 64, "A row must fit in 64 bits");
+
+  /// The type of a row
+  using Row = NarrowestUnsigned<std::uint64_t, LowMask(N * kBits)>;
+  /// The type of an entry of the hash table. 0 means an empty entry.
+  using Slot = NarrowestUnsigned<std::size_t, kSize>;
+
+  /// The code in a row of each value, i.e. the rank in ascending order
+  static constexpr Row Code(T val) noexcept {
+    return static_cast<Row>(Levels::kRanks.levels[Levels::Of(val)]);
+  }
+
+  static constexpr std::size_t Hash(Row row) noexcept {
+    return static_cast<std::size_t>(
+        (static_cast<std::uint64_t>(row) * 0x9e37'79b9'7f4a'7c15ULL) >>
+        (64 - kHashBits));
+  }
+
+  static constexpr FlatTable<T, kLevels> MakeValues() noexcept {
+    FlatTable<T, kLevels> ret{};
+    const T vals[] = {ICs::Value()...};
+    for (std::size_t k = 0; k < kLevels; ++k) {
+      ret.vals[Levels::kRanks.levels[k]] = vals[k];
+    }
+    return ret;
+  }
+
+  /**
+   * @brief Encode all permutations.
+   *
+   * As `ICs[0]` is the lowest digit of the index, the rows of `ICs[k]`, ...,
+   * `ICs[kLevels - 1]` are built from those of `ICs[k + 1]`, ... by placing
+   * each combination of `ICs[k]` around them. It costs O(`kSize * N`) steps
+   * in the constant evaluation, which is much cheaper than calling `Get()`
+   * or stepping `Perms::Iterator` for each row.
+   */
+  static constexpr FlatTable<Row, kSize> MakeRows() noexcept {
+    const std::size_t spaces[] = {ICs::Spaces()...};
+    const std::size_t counts[] = {ICs::Count()...};
+    const std::size_t sizes[] = {static_cast<std::size_t>(ICs::Size())...};
+    const auto& choose = SharedChoose<std::size_t>::kTable;
+
+    FlatTable<Row, kSize> ret{};
+    FlatTable<Row, kSize> rest{};
+    // The last `ItemCount` fills all the remaining slots.
+    for (std::size_t i = 0; i < spaces[kLevels - 1]; ++i) {
+      ret.vals[0] |= static_cast<Row>(
+          std::uint64_t{Levels::kRanks.levels[kLevels - 1]} << (i * kBits));
+    }
+
+    std::size_t len = 1;
+    for (std::size_t k = kLevels - 1; k-- > 0;) {
+      for (std::size_t j = 0; j < len; ++j) {
+        rest.vals[j] = ret.vals[j];
+      }
+
+      const std::uint64_t code = Levels::kRanks.levels[k];
+      for (std::size_t d = 0; d < sizes[k]; ++d) {
+        const std::uint64_t mask =
+            MaskCombinationGet(choose, spaces[k], counts[k], d);
+        for (std::size_t j = 0; j < len; ++j) {
+          std::uint64_t row = 0;
+          std::uint64_t sub = rest.vals[j];
+          for (std::size_t i = 0; i < spaces[k]; ++i) {
+            if ((mask >> i) & 1) {
+              row |= code << (i * kBits);
+            } else {
+              row |= (sub & LowMask(kBits)) << (i * kBits);
+              sub >>= kBits;
+            }
+          }
+          ret.vals[d + sizes[k] * j] = static_cast<Row>(row);
+        }
+      }
+      len *= sizes[k];
+    }
+    return ret;
+  }
+
+  /**
+   * @brief Build the hash table from rows to indices by linear probing.
+   *
+   * An entry holds `index + 1` of the row, and the row itself is compared
+   * with `rows.vals[index]`, so that the table stores no keys.
+   */
+  static constexpr FlatTable<Slot, std::size_t{1} << kHashBits> MakeSlots(
+      const FlatTable<Row, kSize>& rows) noexcept {
+    constexpr std::size_t kMask = (std::size_t{1} << kHashBits) - 1;
+    FlatTable<Slot, std::size_t{1} << kHashBits> ret{};
+    for (std::size_t index = 0; index < kSize; ++index) {
+      std::size_t h = Hash(rows.vals[index]);
+      while (ret.vals[h] != 0) {
+        h = (h + 1) & kMask;
+      }
+      ret.vals[h] = static_cast<Slot>(index + 1);
+    }
+    return ret;
+  }
+};
+
+/**
+ * @brief The tables of `TabulatedPermutations`
+ */
+template <typename Perms>
+struct TabulatedTables : TabulatedBase<Perms> {
+  using Base = TabulatedBase<Perms>;
+  using typename Base::Row;
+  using typename Base::Slot;
+  using Values = decltype(Base::MakeValues());
+  using Rows = FlatTable<Row, Base::kSize>;
+  using Slots = FlatTable<Slot, std::size_t{1} << Base::kHashBits>;
+
+  /// `kValues.vals[code]` is the value of `code`.
+  static constexpr Values kValues = Base::MakeValues();
+  /// `kRows.vals[index]` is the row of `index`'th permutation.
+  static constexpr Rows kRows = Base::MakeRows();
+};
+
+// The out-of-class definition is required if `kValues` is odr-used in C++14.
+template <typename Perms>
+constexpr typename TabulatedTables<Perms>::Values
+    TabulatedTables<Perms>::kValues;
+
+// The out-of-class definition is required if `kRows` is odr-used in C++14.
+template <typename Perms>
+constexpr typename TabulatedTables<Perms>::Rows TabulatedTables<Perms>::kRows;
+
+/**
+ * @brief The hash table of `TabulatedPermutations`
+ */
+template <typename Perms>
+struct TabulatedIndexTable : TabulatedTables<Perms> {
+  using Tables = TabulatedTables<Perms>;
+
+  /// The hash table from rows to `index + 1`
+  static constexpr typename Tables::Slots kSlots =
+      Tables::MakeSlots(Tables::kRows);
+};
+
+// The out-of-class definition is required if `kSlots` is odr-used in C++14.
+template <typename Perms>
+constexpr typename TabulatedTables<Perms>::Slots
+    TabulatedIndexTable<Perms>::kSlots;
+
+/**
+ * @brief A class that looks up permutations from the precomputed tables
+ *
+ * See `TabulatedPermutations` for details.
+ */
+template <typename Perms>
+class TabulatedImpl;
+
+template <typename T, typename I, std::size_t N, std::size_t M,
+          typename... ICs>
+class TabulatedImpl<PermutationsImpl<T, I, N, M, ICs...>> {
+  using Tables = TabulatedIndexTable<PermutationsImpl<T, I, N, M, ICs...>>;
+
+ public:
+  /// The index type
+  using index_type = I;
+  /// The type of a row. See `GetRow()`.
+  using Row = typename Tables::Row;
+
+  /**
+   * @brief The number of spaces
+   */
+  static constexpr std::size_t Spaces() noexcept { return N; }
+
+  /**
+   * @brief The number of bits per slot in a row
+   */
+  static constexpr std::size_t RowBits() noexcept { return Tables::kBits; }
+
+  /**
+   * @brief The number of possible permutations
+   */
+  constexpr I Size() const noexcept { return Tables::kSize; }
+
+  /**
+   * @brief Get `index` for the given permutation
+   */
+  constexpr I Index(const T (&vals)[N]) const {
+    return IndexImpl(std::begin(vals));
+  }
+
+  /**
+   * @brief Get `index` for the given permutation
+   */
+  template <typename Container>
+  constexpr I Index(const Container& vals) const {
+    if (vals.size() != N) {
+      KOMOPERM_THROW(std::runtime_error("The size of `vals` is illegal"));
+    }
+
+    return IndexImpl(vals.begin());
+  }
+
+  /**
+   * @brief Get `index` for the permutation encoded in `row`. See `GetRow()`.
+   */
+  constexpr I IndexRow(Row row) const {
+    constexpr std::size_t kMask = (std::size_t{1} << Tables::kHashBits) - 1;
+    for (std::size_t h = Tables::Hash(row);; h = (h + 1) & kMask) {
+      const std::size_t slot = Tables::kSlots.vals[h];
+      if (slot == 0) {
+        KOMOPERM_THROW(std::runtime_error("Input is illegal"));
+      }
+      if (Tables::kRows.vals[slot - 1] == row) {
+        return static_cast<I>(slot - 1);
+      }
+    }
+  }
+
+  /**
+   * @brief Get `index`'th permutation.
+   */
+  constexpr Array<T, N> Get(I index) const {
+    const Row row = GetRow(index);
+    Array<T, N> ret{};
+    for (std::size_t i = 0; i < N; ++i) {
+      const auto code = (row >> (i * Tables::kBits)) & LowMask(Tables::kBits);
+      ret[i] = Tables::kValues.vals[code];
+    }
+    return ret;
+  }
+
+  /**
+   * @brief Get `index`'th permutation.
+   */
+  constexpr auto operator[](I index) const { return Get(index); }
+
+  /**
+   * @brief Get `index`'th permutation encoded in a row.
+   *
+   * The `i`th slot occupies bits [`i * RowBits()`, `(i + 1) * RowBits()`)
+   * and holds the rank of the value in ascending order, e.g. 0 for the
+   * smallest value.
+   */
+  constexpr Row GetRow(I index) const {
+    if (index >= Size()) {
+      KOMOPERM_THROW(std::runtime_error("Index out of range"));
+    }
+
+    return Tables::kRows.vals[index];
+  }
+
+ private:
+  template <typename Iterator>
+  constexpr I IndexImpl(Iterator vals) const {
+    Row row = 0;
+    for (std::size_t i = 0; i < N; ++i, ++vals) {
+      if (Tables::Levels::Of(*vals) == Tables::Levels::kNone) {
+        KOMOPERM_THROW(std::runtime_error("Input is illegal"));
+      }
+      row |= static_cast<Row>(std::uint64_t{Tables::Code(*vals)}
+                              << (i * Tables::kBits));
+    }
+    return IndexRow(row);
+  }
+};
+}  // namespace detail
+
+/**
+ * @brief Permutations with precomputed tables for `Get()` and `Index()`
+ *
+ * The same as `Permutations<T, Vals...>` including the index order, but all
+ * permutations are materialized in a constexpr table at compile time. Each
+ * permutation is packed in an unsigned integer of `Spaces() * RowBits()`
+ * bits, so `GetRow()` is a single load. `Index()` looks up a hash table
+ * from rows to indices, which typically costs one more load.
+ *
+ * It is opt-in because the tables cost compile time and binary size. Only
+ * the small sets with `Size() <= 2^16` are supported. Large tables may need
+ * a larger constexpr evaluation limit, e.g. `-fconstexpr-steps` in clang.
+ *
+ * # Example
+ *
+ * ```
+ * constexpr TabulatedPermutations<int, 0, 0, 1, 1, 2> p;
+ * const auto perm = p.Get(10);  // {0, 0, 1, 2, 1}
+ * const auto index = p.Index(perm);  // 10
+ * ```
+ */
+template <typename T, T... Vals>
+using TabulatedPermutations =
+    detail::TabulatedImpl<Permutations<T, Vals...>>;
+}  // namespace komoperm
+
+#endif  // KOMORI_TABULATED_HPP_
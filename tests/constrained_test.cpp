@@ -0,0 +1,116 @@
+#include "komoperm/constrained.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+using namespace komoperm;
+
+namespace {
+using Perms = Permutations<int, 3, 1, 3, 0, 1, 3, 2>;
+
+/// Check `c` against the filtered permutations in the lexicographic order.
+template <typename Pred>
+void ExpectSameAsFilter(const ConstrainedPermutations<Perms>& c, Pred pred) {
+  constexpr Perms p;
+  std::vector<decltype(p.LexGet(0))> expected;
+  for (std::size_t i = 0; i < p.Size(); ++i) {
+    const auto perm = p.LexGet(i);
+    if (pred(perm)) {
+      expected.push_back(perm);
+    }
+  }
+
+  ASSERT_EQ(c.Size(), expected.size());
+  for (std::size_t i = 0; i < expected.size(); ++i) {
+    const auto perm = c.Get(i);
+    EXPECT_TRUE(std::equal(perm.begin(), perm.end(), expected[i].begin()))
+        << i;
+    EXPECT_EQ(c.Index(expected[i]), i);
+  }
+
+  std::size_t i = 0;
+  c.ForEach([&](const auto& perm) {
+    ASSERT_LT(i, expected.size());
+    EXPECT_TRUE(std::equal(perm.begin(), perm.end(), expected[i].begin()))
+        << i;
+    ++i;
+  });
+  EXPECT_EQ(i, expected.size());
+}
+}  // namespace
+
+TEST(Constrained, no_constraint) {
+  constexpr Perms p;
+  ConstrainedPermutations<Perms> c(p);
+  EXPECT_EQ(c.Size(), p.Size());
+  ExpectSameAsFilter(c, [](const auto&) { return true; });
+}
+
+TEST(Constrained, prefix) {
+  constexpr Perms p;
+  ConstrainedPermutations<Perms> c(p);
+  c.FixPrefix({3, 1});
+  ExpectSameAsFilter(
+      c, [](const auto& perm) { return perm[0] == 3 && perm[1] == 1; });
+
+  // The prefix maps to a contiguous range of `LexIndex()`.
+  EXPECT_EQ(p.LexIndex(c.Get(c.Size() - 1)) - p.LexIndex(c.Get(0)) + 1,
+            c.Size());
+}
+
+TEST(Constrained, restrict) {
+  constexpr Perms p;
+  ConstrainedPermutations<Perms> c(p);
+  c.Restrict(3, {0, 2, 4, 6}).Fix(1, 0).Restrict(2, std::vector<int>{5, 6});
+  ExpectSameAsFilter(c, [](const auto& perm) {
+    return perm[1] == 0 && perm[1] != 3 && perm[3] != 3 && perm[5] != 3 &&
+           (perm[5] == 2 || perm[6] == 2);
+  });
+}
+
+TEST(Constrained, empty) {
+  constexpr Perms p;
+  ConstrainedPermutations<Perms> c(p);
+  c.Restrict(3, {0, 1});
+  EXPECT_EQ(c.Size(), 0);
+  c.ForEach([](const auto&) { FAIL(); });
+  EXPECT_THROW(c.Get(0), std::runtime_error);
+}
+
+TEST(Constrained, illegal) {
+  constexpr Perms p;
+  ConstrainedPermutations<Perms> c(p);
+  EXPECT_THROW(c.Fix(7, 3), std::runtime_error);
+  EXPECT_THROW(c.Fix(0, 4), std::runtime_error);
+  EXPECT_THROW(c.Restrict(3, {7}), std::runtime_error);
+
+  c.Fix(0, 3);
+  EXPECT_THROW(c.Index({0, 1, 1, 2, 3, 3, 3}), std::runtime_error);
+  EXPECT_THROW(c.Index({3, 3, 3, 3, 1, 1, 0}), std::runtime_error);
+  EXPECT_THROW(c.Index({3, 1}), std::runtime_error);
+}
+
+TEST(Constrained, incremental) {
+  constexpr Perms p;
+  ConstrainedPermutations<Perms> c(p);
+  // Each constraint either extends or stays within the constrained slots.
+  c.Fix(2, 3);
+  ExpectSameAsFilter(c, [](const auto& perm) { return perm[2] == 3; });
+  c.Fix(0, 1);
+  ExpectSameAsFilter(
+      c, [](const auto& perm) { return perm[2] == 3 && perm[0] == 1; });
+  c.Restrict(2, {0, 1, 2, 3, 4, 5, 6});
+  ExpectSameAsFilter(
+      c, [](const auto& perm) { return perm[2] == 3 && perm[0] == 1; });
+  c.Restrict(0, {1, 3, 5});
+  ExpectSameAsFilter(c, [](const auto& perm) {
+    return perm[2] == 3 && perm[0] == 1 && perm[4] != 0 && perm[6] != 0;
+  });
+
+  // The shared counts do not leak the constraints to other objects.
+  const ConstrainedPermutations<Perms> d(p);
+  EXPECT_EQ(d.Size(), p.Size());
+}
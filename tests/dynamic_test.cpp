@@ -0,0 +1,89 @@
+#include "komoperm/dynamic.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+using namespace komoperm;
+
+namespace {
+enum class Piyo {
+  kA,
+  kB,
+  kC,
+};
+}  // namespace
+
+TEST(DynamicPermutations, same_as_static_test) {
+  constexpr Permutations<Piyo, Piyo::kB, Piyo::kA, Piyo::kB, Piyo::kC,
+                         Piyo::kA, Piyo::kB>
+      p;
+  const std::vector<Piyo> vals{Piyo::kB, Piyo::kA, Piyo::kB,
+                               Piyo::kC, Piyo::kA, Piyo::kB};
+  const DynamicPermutations<Piyo> dp(vals.begin(), vals.end());
+
+  ASSERT_EQ(dp.Size(), p.Size());
+  EXPECT_EQ(dp.Spaces(), 6);
+  for (std::size_t i = 0; i < p.Size(); ++i) {
+    const auto perm = p.Get(i);
+    const auto dperm = dp.Get(i);
+    ASSERT_EQ(dperm.size(), perm.size());
+    for (std::size_t j = 0; j < perm.size(); ++j) {
+      EXPECT_EQ(dperm[j], perm[j]);
+    }
+    EXPECT_EQ(dp.Index(dperm), i);
+    EXPECT_EQ(dp.IndexUnchecked(perm), i);
+  }
+}
+
+TEST(DynamicPermutations, long_sequence_test) {
+  // Longer than the local buffers
+  std::vector<int> vals;
+  for (int i = 0; i < 70; ++i) {
+    vals.push_back(i < 67 ? 0 : i);
+  }
+  const DynamicPermutations<int> dp(vals.begin(), vals.end());
+
+  // 70 * 69 * 68
+  EXPECT_EQ(dp.Size(), 328440);
+  for (std::size_t i : {std::size_t{0}, std::size_t{12345}, dp.Size() - 1}) {
+    EXPECT_EQ(dp.Index(dp.Get(i)), i);
+    EXPECT_EQ(dp.IndexUnchecked(dp.Get(i)), i);
+  }
+  // The heap buffer for a long sequence may throw.
+  static_assert(!noexcept(dp.IndexUnchecked(vals)), "");
+}
+
+TEST(DynamicPermutations, illegal_test) {
+  const DynamicPermutations<int> dp{3, 3, 4, 2, 6, 4};
+  EXPECT_EQ(dp.Size(), 180);
+  EXPECT_EQ(dp.Index({3, 3, 4, 4, 2, 6}), 0);
+
+  EXPECT_THROW(dp.Get(dp.Size()), std::runtime_error);
+  EXPECT_THROW(dp.Index({3, 3, 4, 2, 6}), std::runtime_error);
+  EXPECT_THROW(dp.Index({3, 3, 4, 2, 6, 6}), std::runtime_error);
+  EXPECT_THROW(dp.Index({3, 3, 4, 2, 6, 5}), std::runtime_error);
+
+  const std::vector<int> empty;
+  EXPECT_THROW(DynamicPermutations<int>(empty.begin(), empty.end()),
+               std::runtime_error);
+
+  // 13! > 2^32
+  EXPECT_THROW((DynamicPermutations<int, std::uint32_t>{
+                   0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12}),
+               std::runtime_error);
+  EXPECT_NO_THROW((DynamicPermutations<int, std::uint32_t>{
+      0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11}));
+
+  // 23! / (6! 8! 9!) is more than a half of 2^32, but still representable.
+  std::vector<int> half(6, 0);
+  half.resize(14, 1);
+  half.resize(23, 2);
+  const DynamicPermutations<int, std::uint32_t> dp_half(half.begin(),
+                                                        half.end());
+  EXPECT_EQ(dp_half.Size(), 2454021570U);
+  EXPECT_EQ(dp_half.Index(dp_half.Get(dp_half.Size() - 1)),
+            dp_half.Size() - 1);
+}
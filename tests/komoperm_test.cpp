@@ -2,7 +2,13 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <iostream>
+#include <iterator>
+#include <list>
+#include <random>
+#include <sstream>
+#include <vector>
 
 using namespace komoperm::detail;
 using namespace komoperm;
@@ -36,6 +42,68 @@ TEST(Komoperm, choose_test) {
   EXPECT_EQ((ChooseMetaFunc<1, 2>::value), 0);
 }
 
+TEST(Komoperm, packed_choose_test) {
+  constexpr Choose<std::size_t, 40, 20> kDense;
+  constexpr PackedChoose<std::size_t, 40, 20> kPacked;
+  static_assert(kPacked.Get(4, 2) == 6, "4 choose 2 == 6");
+  static_assert(kPacked.GetUnchecked(0, 0) == 1, "0 choose 0 == 1");
+
+  for (std::size_t n = 1; n <= 40; ++n) {
+    for (std::size_t m = 0; m <= 20; ++m) {
+      EXPECT_EQ(kPacked.Get(n, m), kDense.Get(n, m)) << "n=" << n << " m=" << m;
+    }
+  }
+  EXPECT_EQ(kPacked.Get(1, 2), 0);
+  EXPECT_THROW(kPacked.Get(41, 2), std::runtime_error);
+  EXPECT_THROW(kPacked.Get(40, 21), std::runtime_error);
+
+  // The narrowest type which holds (40 choose 20) = 137846528820
+  ::testing::StaticAssertTypeEq<decltype(kPacked)::value_type, std::uint64_t>();
+  ::testing::StaticAssertTypeEq<PackedChoose<std::size_t, 4, 2>::value_type,
+                                std::uint8_t>();
+  ::testing::StaticAssertTypeEq<PackedChoose<std::size_t, 16, 8>::value_type,
+                                std::uint16_t>();
+  ::testing::StaticAssertTypeEq<PackedChoose<std::size_t, 30, 8>::value_type,
+                                std::uint32_t>();
+  EXPECT_EQ(sizeof(PackedChoose<std::size_t, 4, 2>), 12);
+  EXPECT_LT(sizeof(kPacked), sizeof(kDense));
+  EXPECT_LT(sizeof(PackedChoose<std::size_t, 39, 7>),
+            sizeof(Choose<std::size_t, 40, 8>) / 2);
+}
+
+TEST(Komoperm, fitted_choose_test) {
+  constexpr PackedChoose<std::size_t, 64, 64> kFull;
+  constexpr FittedChoose<std::size_t, std::uint8_t, 64> kNarrow;
+  static_assert(kNarrow.Get(10, 5) == 252, "10 choose 5 == 252");
+  static_assert(kNarrow.GetUnchecked(0, 0) == 1, "0 choose 0 == 1");
+
+  // (10 choose 5) = 252 fits in 8 bits, but (11 choose 4) = 330 does not.
+  EXPECT_EQ(kNarrow.RowMax(10), 10);
+  EXPECT_EQ(kNarrow.RowMax(11), 3);
+  EXPECT_EQ(kNarrow.RowMax(40), 1);
+  EXPECT_EQ((FittedChoose<std::size_t, std::uint64_t, 64>::RowMax(64)), 64);
+  for (std::size_t n = 0; n <= 64; ++n) {
+    for (std::size_t m = 0; m <= kNarrow.RowMax(n); ++m) {
+      EXPECT_EQ(kNarrow.Get(n, m), kFull.Get(n, m)) << "n=" << n << " m=" << m;
+    }
+  }
+  EXPECT_EQ(kNarrow.Get(1, 2), 0);
+  EXPECT_THROW(kNarrow.Get(40, 2), std::runtime_error);
+  EXPECT_THROW(kNarrow.Get(65, 1), std::runtime_error);
+
+  EXPECT_TRUE(kNarrow.Covers(10, 10));
+  EXPECT_TRUE(kNarrow.Covers(23, 2));  // (23 choose 2) = 253
+  EXPECT_FALSE(kNarrow.Covers(24, 2));
+  EXPECT_FALSE(kNarrow.Covers(65, 0));
+  EXPECT_TRUE((PackedChoose<std::size_t, 39, 7>::Covers(39, 7)));
+  EXPECT_FALSE((PackedChoose<std::size_t, 39, 7>::Covers(39, 8)));
+
+  // The shared table of a N=40, M=8 permutation has 32-bit entries.
+  EXPECT_LT(sizeof(SharedChoose<std::size_t, std::uint32_t>::kTable),
+            sizeof(SharedChoose<std::size_t>::kTable) / 4);
+  EXPECT_LT(sizeof(kNarrow), 256);
+}
+
 TEST(Komoperm, copy_test) {
   int a[3] = {2, 6, 4};
   int b[3] = {};
@@ -58,6 +126,15 @@ TEST(Komoperm, merge_sort_test) {
   EXPECT_EQ(a[4], 4);
   EXPECT_EQ(a[5], 5);
   EXPECT_EQ(a[6], 9);
+
+  // Sort by (value, pos)
+  ValuePosition<int> c[5] = {{2, 0}, {1, 1}, {2, 2}, {1, 3}, {0, 4}};
+  ValuePosition<int> d[5] = {};
+  MergeSort(std::begin(c), std::end(c), std::begin(d));
+  const std::size_t pos[] = {4, 1, 3, 0, 2};
+  for (std::size_t i = 0; i < 5; ++i) {
+    EXPECT_EQ(c[i].pos, pos[i]);
+  }
 }
 
 TEST(Komoperm, any_of_test) {
@@ -73,6 +150,114 @@ TEST(Komoperm, unique_count_test) {
             4);
 }
 
+TEST(Komoperm, make_item_counts_test) {
+  constexpr auto kValue = MakeItemCountsImplCalc<int, 3, 3, 4, 2, 6, 4>();
+  static_assert(kValue.size == 4, "");
+  static_assert(kValue.max_count == 2, "");
+
+  const int values[] = {3, 4, 2, 6};
+  const std::size_t remains[] = {6, 4, 2, 1};
+  const std::size_t counts[] = {2, 2, 1, 1};
+  for (std::size_t i = 0; i < 4; ++i) {
+    EXPECT_EQ(kValue.values[i], values[i]);
+    EXPECT_EQ(kValue.remains[i], remains[i]);
+    EXPECT_EQ(kValue.counts[i], counts[i]);
+  }
+}
+
+TEST(Komoperm, make_item_counts_order_test) {
+  constexpr auto kValue = MakeItemCountsImplCalc<int, 3, 2, 4, 6, 4, 4, 2>(
+      ItemOrder::kDescendingCount);
+  static_assert(kValue.size == 4, "");
+  static_assert(kValue.max_count == 3, "");
+
+  // Ties are broken by the first occurrences.
+  const int values[] = {4, 2, 3, 6};
+  const std::size_t remains[] = {7, 4, 2, 1};
+  const std::size_t counts[] = {3, 2, 1, 1};
+  for (std::size_t i = 0; i < 4; ++i) {
+    EXPECT_EQ(kValue.values[i], values[i]);
+    EXPECT_EQ(kValue.remains[i], remains[i]);
+    EXPECT_EQ(kValue.counts[i], counts[i]);
+  }
+}
+
+TEST(Komoperm, permutation_order_test) {
+  using P1 = Permutations<int, 3, 2, 4, 6, 4, 4, 2>;
+  using P2 = PermutationsWithOrder<ItemOrder::kFirstOccurrence, std::size_t,
+                                   int, 3, 2, 4, 6, 4, 4, 2>;
+  using P3 = PermutationsWithOrder<ItemOrder::kDescendingCount, std::size_t,
+                                   int, 3, 2, 4, 6, 4, 4, 2>;
+  static_assert(std::is_same<P1, P2>::value, "");
+  static_assert(P1::DigitValues()[0] == 3, "");
+  static_assert(P3::DigitValues()[0] == 4, "");
+  static_assert(P3::DigitValues()[1] == 2, "");
+  static_assert(P3::DigitValues()[2] == 3, "");
+  static_assert(P3::DigitValues()[3] == 6, "");
+
+  constexpr P1 p1;
+  constexpr P3 p3;
+  ASSERT_EQ(p1.Size(), p3.Size());
+  std::vector<bool> seen(p3.Size());
+  for (std::size_t i = 0; i < p3.Size(); ++i) {
+    const auto perm = p3.Get(i);
+    EXPECT_EQ(p3.Index(perm), i);
+    const std::size_t j = p1.Index(perm);
+    EXPECT_FALSE(seen[j]);
+    seen[j] = true;
+  }
+
+  const auto first = p3.Get(0);
+  const int expected[] = {4, 4, 4, 2, 2, 3, 6};
+  EXPECT_TRUE(std::equal(first.begin(), first.end(), std::begin(expected)));
+}
+
+TEST(Komoperm, permutation_large_pack_test) {
+  // (64 choose 32)
+  constexpr Permutations<int, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0,
+                         1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0,
+                         1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0,
+                         1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0>
+      p;
+  static_assert(p.Size() == 1832624140942590534ULL, "");
+  static_assert(p.Index(p.Get(p.Size() - 1)) == p.Size() - 1, "");
+
+  const auto perm = p.Get(0);
+  EXPECT_EQ(perm[0], 1);
+  EXPECT_EQ(perm[31], 1);
+  EXPECT_EQ(perm[32], 0);
+  EXPECT_EQ(perm[63], 0);
+}
+
+TEST(Komoperm, permutation_empty_test) {
+  using P1 = Permutations<Hoge, Hoge::kA, Hoge::kA, Hoge::kB, Hoge::kC>;
+  using P2 = PermutationsWithIndex<std::uint32_t, int, 0, 1, 2, 3, 4, 5>;
+  static_assert(std::is_empty<P1>::value, "");
+  static_assert(std::is_empty<P2>::value, "");
+
+  // More spaces than `SharedChoose`
+  constexpr Permutations<int, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                         0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                         0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                         0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1>
+      p;
+  static_assert(kSharedChooseMaxN + 1 < 70, "");
+  static_assert(std::is_empty<decltype(p)>::value, "");
+  // (70 choose 2)
+  EXPECT_EQ(p.Size(), 2415);
+  for (std::size_t i = 0; i < p.Size(); ++i) {
+    EXPECT_EQ(p.Index(p.Get(i)), i);
+  }
+
+  // `IndexAfterSwap()` and `IndexAfterMove()` fall back to `Index()`.
+  auto perm = p.Get(100);
+  std::rotate(perm.begin(), perm.end() - 1, perm.end());
+  EXPECT_EQ(p.IndexAfterMove(100, p.Get(100), 69, 0), p.Index(perm));
+  perm = p.Get(100);
+  std::swap(perm[0], perm[69]);
+  EXPECT_EQ(p.IndexAfterSwap(100, p.Get(100), 0, 69), p.Index(perm));
+}
+
 TEST(Komoperm, item_count_index_test) {
   ItemCount<Hoge, Hoge::kA, 5, 2> ic1;
   constexpr Choose<std::size_t, 10, 10> kChoose;
@@ -118,6 +303,26 @@ TEST(Komoperm, item_count_is_ok_test) {
   EXPECT_FALSE(ic1.IsOk(ng2.begin(), ng2.end()));
 }
 
+TEST(Komoperm, value_levels_test) {
+  using L1 = ValueLevels<Hoge, ItemCount<Hoge, Hoge::kC, 3, 1>,
+                         ItemCount<Hoge, Hoge::kA, 2, 2>>;
+  static_assert(L1::UseTable(), "");
+  static_assert(L1::Of(Hoge::kC) == 0, "");
+  EXPECT_EQ(L1::Of(Hoge::kA), 1);
+  EXPECT_EQ(L1::Of(Hoge::kB), std::size_t{L1::kNone});
+  EXPECT_EQ(L1::Of(Hoge::kD), std::size_t{L1::kNone});
+
+  // The values are too sparse to be looked up from a table.
+  using L2 = ValueLevels<int, ItemCount<int, -1000000, 3, 1>,
+                         ItemCount<int, 2000000000, 2, 1>,
+                         ItemCount<int, 5, 1, 1>>;
+  static_assert(!L2::UseTable(), "");
+  EXPECT_EQ(L2::Of(-1000000), 0);
+  EXPECT_EQ(L2::Of(2000000000), 1);
+  EXPECT_EQ(L2::Of(5), 2);
+  EXPECT_EQ(L2::Of(0), std::size_t{L2::kNone});
+}
+
 TEST(Komoperm, permutation_index_test) {
   constexpr Permutations<Hoge, Hoge::kA, Hoge::kA, Hoge::kA, Hoge::kB, Hoge::kB,
                          Hoge::kC>
@@ -133,6 +338,151 @@ TEST(Komoperm, permutation_index_test) {
   EXPECT_THROW(
       p.Index({Hoge::kA, Hoge::kA, Hoge::kA, Hoge::kA, Hoge::kB, Hoge::kC}),
       std::runtime_error);
+  EXPECT_THROW(
+      p.Index({Hoge::kA, Hoge::kA, Hoge::kA, Hoge::kB, Hoge::kB, Hoge::kD}),
+      std::runtime_error);
+}
+
+TEST(Komoperm, permutation_index_unchecked_test) {
+  constexpr Permutations<int, -3, -3, 7, 7, 7, 100> p;
+  static_assert(p.IndexUnchecked({-3, -3, 7, 7, 7, 100}) == 0, "");
+
+  for (std::size_t i = 0; i < p.Size(); ++i) {
+    EXPECT_EQ(p.IndexUnchecked(p.Get(i)), i);
+    EXPECT_EQ(p.Index(p.Get(i)), i);
+  }
+  EXPECT_THROW(p.Index({-3, -3, 7, 7, 7, 101}), std::runtime_error);
+}
+
+TEST(Komoperm, permutation_try_test) {
+  constexpr Permutations<int, -3, -3, 7, 7, 7, 100> p;
+  static_assert(p.TryIndex({-3, -3, 7, 7, 7, 100}).value == 0, "");
+  static_assert(p.TryIndex({-3, -3, 7, 7, 7, 101}).error ==
+                    Error::kIllegalInput,
+                "");
+  static_assert(p.TryGet(p.Size()).error == Error::kOutOfRange, "");
+
+  for (std::size_t i = 0; i < p.Size(); ++i) {
+    const auto perm = p.TryGet(i);
+    ASSERT_TRUE(perm);
+    const auto expected = p.Get(i);
+    const auto unchecked = p.GetUnchecked(i);
+    EXPECT_TRUE(std::equal(perm.value.begin(), perm.value.end(),
+                           expected.begin()));
+    EXPECT_TRUE(
+        std::equal(unchecked.begin(), unchecked.end(), expected.begin()));
+
+    const auto index = p.TryIndex(perm.value);
+    ASSERT_TRUE(index.ok());
+    EXPECT_EQ(index.value, i);
+  }
+
+  EXPECT_FALSE(p.TryIndex({-3, -3, 7, 7, 7, 101}).ok());
+  EXPECT_FALSE(p.TryIndex({-3, -3, -3, 7, 7, 100}).ok());
+  EXPECT_EQ(p.TryIndex(std::vector<int>{-3, -3, 7, 7, 7}).error,
+            Error::kIllegalSize);
+  EXPECT_EQ(p.TryGet(p.Size()).error, Error::kOutOfRange);
+}
+
+TEST(Komoperm, permutation_index_range_test) {
+  constexpr Permutations<Hoge, Hoge::kA, Hoge::kA, Hoge::kB, Hoge::kC> p;
+  for (std::size_t i = 0; i < p.Size(); ++i) {
+    const auto perm = p.Get(i);
+    const std::list<Hoge> list(perm.begin(), perm.end());
+    EXPECT_EQ(p.Index(list.begin(), list.end()), i);
+    EXPECT_EQ(p.TryIndex(list.begin(), list.end()).value, i);
+
+    // The 3rd column of a 4x3 board
+    Hoge board[4][3]{};
+    for (std::size_t j = 0; j < 4; ++j) {
+      board[j][2] = perm[j];
+    }
+    EXPECT_EQ(p.IndexStrided(&board[0][2], 3), i);
+  }
+
+  std::istringstream iss("2 0 1 0");
+  constexpr Permutations<int, 0, 0, 1, 2> q;
+  EXPECT_EQ(q.Index(std::istream_iterator<int>(iss),
+                    std::istream_iterator<int>()),
+            q.Index({2, 0, 1, 0}));
+
+  const std::vector<int> vals{0, 0, 1, 2, 2};
+  EXPECT_EQ(q.TryIndex(vals.begin(), vals.end()).error, Error::kIllegalSize);
+  EXPECT_EQ(q.TryIndex(vals.begin(), vals.end() - 2).error,
+            Error::kIllegalSize);
+  EXPECT_EQ(q.TryIndex(vals.begin() + 1, vals.end()).error,
+            Error::kIllegalInput);
+  EXPECT_THROW(q.Index(vals.begin(), vals.end()), std::runtime_error);
+  EXPECT_THROW(q.Index(vals.begin() + 1, vals.end()), std::runtime_error);
+
+  // More spaces than a 64-bit mask
+  constexpr Permutations<int, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                         0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                         0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                         0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1>
+      r;
+  const auto perm = r.Get(1000);
+  const std::list<int> list(perm.begin(), perm.end());
+  EXPECT_EQ(r.Index(list.begin(), list.end()), 1000);
+  EXPECT_EQ(r.IndexStrided(perm.data() + 69, -1),
+            r.Index(std::vector<int>(perm.rbegin(), perm.rend())));
+}
+
+template <typename Perms>
+void CheckIndexSamples(const Perms& p, std::size_t samples) {
+  constexpr std::size_t kLast = Perms{}.Size() - 1;
+  const std::size_t step = kLast / samples + 1;
+  // The constexpr evaluation always uses `ItemCount::IndexImpl()`.
+  static_assert(Perms{}.Index(Perms{}.Get(kLast)) == kLast, "");
+  for (std::size_t i = 0; i < p.Size(); i += step) {
+    EXPECT_EQ(p.Index(p.Get(i)), i);
+    EXPECT_EQ(p.IndexUnchecked(p.Get(i)), i);
+  }
+  EXPECT_EQ(p.Index(p.Get(kLast)), kLast);
+}
+
+TEST(Komoperm, permutation_simd_index_test) {
+  // 1, 2 and 4 bytes, and more than one vector
+  constexpr Permutations<std::int8_t, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                         0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2,
+                         -1>
+      p8;
+  constexpr Permutations<std::uint16_t, 300, 300, 300, 300, 301, 301, 301, 302,
+                         302, 302, 303, 303, 304, 305, 306, 307, 308>
+      p16;
+  constexpr Permutations<int, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+                         1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+                         2, 2, 3, 3, 4>
+      p32;
+  constexpr Permutations<Hoge, Hoge::kA, Hoge::kB, Hoge::kB, Hoge::kC, Hoge::kD>
+      p_enum;
+  constexpr Permutations<std::int64_t, 7, 7, 8, 9> p64;
+  static_assert(!decltype(p64)::UseSimdIndex(), "");
+#if defined(__AVX2__) || (defined(__aarch64__) && defined(__ARM_NEON))
+  static_assert(decltype(p8)::UseSimdIndex(), "");
+  static_assert(decltype(p16)::UseSimdIndex(), "");
+  static_assert(decltype(p32)::UseSimdIndex(), "");
+#endif  // defined(__AVX2__) || (defined(__aarch64__) && defined(__ARM_NEON))
+
+  CheckIndexSamples(p8, 1000);
+  CheckIndexSamples(p16, 1000);
+  CheckIndexSamples(p32, 1000);
+  CheckIndexSamples(p_enum, 1000);
+  CheckIndexSamples(p64, 1000);
+
+  // The slots are validated as in the scalar path.
+  auto perm = p32.Get(12345);
+  perm[39] = 5;
+  EXPECT_THROW(p32.Index(perm), std::runtime_error);
+  perm[39] = 2;
+  EXPECT_THROW(p32.Index(perm), std::runtime_error);
+
+  // The zero padding of the vectors never matches a value.
+  constexpr Permutations<int, 1, 1, 2> p_nonzero;
+  EXPECT_THROW(p_nonzero.Index({1, 0, 2}), std::runtime_error);
+  constexpr Permutations<int, 0, 0, 2> p_zero;
+  EXPECT_EQ(p_zero.Index({2, 0, 0}), 2);
+  EXPECT_THROW(p_zero.Index({0, 0, 0}), std::runtime_error);
 }
 
 TEST(Komb, permutation_get_test) {
@@ -167,6 +517,72 @@ TEST(Komb, permutation_identity_test) {
   }
 }
 
+namespace {
+struct Board {
+  int header;
+  int cells[3][6];
+};
+
+/// `GetInto()` in constant evaluations
+template <typename P>
+constexpr int SumOfGetInto(const P& p, std::size_t index) {
+  int vals[6]{};
+  p.GetInto(index, vals);
+  int sum = 0;
+  for (std::size_t i = 0; i < 6; ++i) {
+    sum = sum * 10 + vals[i];
+  }
+  return sum;
+}
+}  // namespace
+
+TEST(Komoperm, permutation_get_into_test) {
+  constexpr Permutations<int, 0, 0, 0, 1, 1, 2> p;
+  static_assert(SumOfGetInto(p, 10) == 100012, "");
+
+  for (std::size_t i = 0; i < p.Size(); ++i) {
+    const auto expected = p.Get(i);
+
+    Board board{-1, {}};
+    EXPECT_EQ(p.GetInto(i, board.cells[1]), board.cells[1] + 6);
+    EXPECT_TRUE(std::equal(expected.begin(), expected.end(), board.cells[1]));
+    EXPECT_EQ(board.header, -1);
+    EXPECT_EQ(board.cells[0][5], 0);
+    EXPECT_EQ(board.cells[2][0], 0);
+
+    std::vector<int> v(8, -1);
+    EXPECT_EQ(p.GetInto(i, v.begin() + 1), v.begin() + 7);
+    EXPECT_TRUE(std::equal(expected.begin(), expected.end(), v.begin() + 1));
+    EXPECT_EQ(v[7], -1);
+
+    std::list<int> l(6);
+    EXPECT_EQ(p.GetInto(i, l.begin()), l.end());
+    EXPECT_TRUE(std::equal(expected.begin(), expected.end(), l.begin()));
+
+    std::vector<int> pushed;
+    p.GetInto(i, std::back_inserter(pushed));
+    EXPECT_TRUE(std::equal(expected.begin(), expected.end(), pushed.begin(),
+                           pushed.end()));
+  }
+
+  int vals[6]{};
+  EXPECT_THROW(p.GetInto(p.Size(), vals), std::runtime_error);
+
+  // More than 64 slots, where the filled slots are not a bitmask
+  constexpr Permutations<int, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                         0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                         0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                         0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 2>
+      p70;
+  for (std::size_t i = 0; i < p70.Size(); i += 37) {
+    const auto expected = p70.Get(i);
+    int out[70]{};
+    p70.GetInto(i, out);
+    EXPECT_TRUE(std::equal(expected.begin(), expected.end(), out));
+    EXPECT_EQ(p70.Index(out), i);
+  }
+}
+
 #if __cplusplus >= 201703L
 TEST(Komoperm, permutation_auto_test) {
   ::testing::StaticAssertTypeEq<
@@ -174,3 +590,565 @@ TEST(Komoperm, permutation_auto_test) {
       Permutations<Hoge, Hoge::kA, Hoge::kB, Hoge::kA> >();
 }
 #endif  // __cplusplus >= 201703L
+
+TEST(Komoperm, permutation_batch_test) {
+  constexpr Permutations<Hoge, Hoge::kA, Hoge::kA, Hoge::kA, Hoge::kB, Hoge::kB,
+                         Hoge::kC>
+      p;
+
+  std::vector<std::size_t> indices(p.Size());
+  for (std::size_t i = 0; i < p.Size(); ++i) {
+    indices[i] = p.Size() - i - 1;
+  }
+
+  std::vector<Hoge> perms(p.Size() * 6);
+  p.GetBatch(indices.data(), indices.size(), perms.data());
+  for (std::size_t i = 0; i < p.Size(); ++i) {
+    const auto expected = p.Get(indices[i]);
+    for (std::size_t j = 0; j < 6; ++j) {
+      EXPECT_EQ(perms[i * 6 + j], expected[j]) << "i=" << i << " j=" << j;
+    }
+  }
+
+  std::vector<std::size_t> result(p.Size());
+  p.IndexBatch(perms.data(), p.Size(), result.data());
+  EXPECT_EQ(result, indices);
+
+  const std::size_t illegal_index = p.Size();
+  EXPECT_THROW(p.GetBatch(&illegal_index, 1, perms.data()),
+               std::runtime_error);
+  const Hoge illegal_perm[6] = {Hoge::kA, Hoge::kA, Hoge::kA,
+                                Hoge::kA, Hoge::kB, Hoge::kC};
+  EXPECT_THROW(p.IndexBatch(illegal_perm, 1, result.data()),
+               std::runtime_error);
+
+  // More than 64 slots, where the rows are not ranked by the slot masks
+  constexpr Permutations<int, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                         0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                         0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                         0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 2>
+      p70;
+  std::vector<std::size_t> indices70;
+  for (std::size_t i = 0; i < p70.Size(); i += 37) {
+    indices70.push_back(i);
+  }
+  std::vector<int> perms70(indices70.size() * 70);
+  p70.GetBatch(indices70.data(), indices70.size(), perms70.data());
+  for (std::size_t i = 0; i < indices70.size(); ++i) {
+    const auto expected = p70.Get(indices70[i]);
+    EXPECT_TRUE(std::equal(expected.begin(), expected.end(),
+                           perms70.begin() + i * 70))
+        << "i=" << i;
+  }
+
+  std::vector<std::size_t> result70(indices70.size());
+  p70.IndexBatch(perms70.data(), indices70.size(), result70.data());
+  EXPECT_EQ(result70, indices70);
+  perms70[0] = 1;
+  EXPECT_THROW(p70.IndexBatch(perms70.data(), 1, result70.data()),
+               std::runtime_error);
+}
+
+template <typename Perms, typename Urbg>
+void CheckSampleUniformity(const Perms& p, Urbg& urbg) {
+  constexpr std::size_t kSamplesPerIndex = 2000;
+  std::vector<std::size_t> counts(p.Size());
+  for (std::size_t i = 0; i < p.Size() * kSamplesPerIndex; ++i) {
+    counts[p.Index(p.Sample(urbg))]++;
+  }
+  // The standard deviation is about sqrt(2000) = 45.
+  for (auto count : counts) {
+    EXPECT_NEAR(count, kSamplesPerIndex, 300);
+  }
+}
+
+TEST(Komoperm, permutation_sample_test) {
+  constexpr Permutations<int, 0, 0, 1, 2, 2, 2> p;
+  std::mt19937_64 mt64(0x6b6f6d6f);
+  std::mt19937 mt32(0x6b6f6d6f);
+  std::minstd_rand minstd(0x6b6f6d6f);
+  CheckSampleUniformity(p, mt64);
+  CheckSampleUniformity(p, mt32);
+  CheckSampleUniformity(p, minstd);
+
+  // More steps than a random word holds
+  constexpr Permutations<int, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14,
+                         15, 16, 17, 18, 19>
+      p_distinct;
+  constexpr std::size_t kSamples = 100000;
+  std::size_t positions[20]{};
+  for (std::size_t i = 0; i < kSamples; ++i) {
+    const auto perm = p_distinct.Sample(mt64);
+    EXPECT_NO_THROW(p_distinct.Index(perm));
+    positions[std::find(perm.begin(), perm.end(), 19) - perm.begin()]++;
+  }
+  for (auto count : positions) {
+    EXPECT_NEAR(count, kSamples / 20, 300);
+  }
+}
+
+TEST(Komoperm, permutation_sample_batch_test) {
+  constexpr Permutations<Hoge, Hoge::kA, Hoge::kB, Hoge::kB, Hoge::kC> p;
+  constexpr std::size_t kSamplesPerIndex = 2000;
+  const std::size_t count = p.Size() * kSamplesPerIndex;
+  std::vector<Hoge> out(count * 4);
+  std::mt19937_64 mt(0x6b6f6d6f);
+  p.SampleBatch(mt, count, out.data());
+
+  std::vector<std::size_t> counts(p.Size());
+  for (std::size_t r = 0; r < count; ++r) {
+    counts[p.Index(std::vector<Hoge>(out.begin() + r * 4,
+                                     out.begin() + (r + 1) * 4))]++;
+  }
+  for (auto c : counts) {
+    EXPECT_NEAR(c, kSamplesPerIndex, 300);
+  }
+}
+
+TEST(Komoperm, permutation_iterator_test) {
+  constexpr Permutations<Hoge, Hoge::kA, Hoge::kA, Hoge::kA, Hoge::kB, Hoge::kB,
+                         Hoge::kC, Hoge::kD, Hoge::kD>
+      p;
+
+  std::size_t i = 0;
+  for (const auto& perm : p) {
+    const auto expected = p.Get(i);
+    for (std::size_t j = 0; j < 8; ++j) {
+      EXPECT_EQ(perm[j], expected[j]) << "i=" << i << " j=" << j;
+    }
+    ++i;
+  }
+  EXPECT_EQ(i, p.Size());
+
+  auto itr = p.end();
+  while (itr != p.begin()) {
+    --itr;
+    --i;
+    EXPECT_EQ(itr.Index(), i);
+    EXPECT_EQ(p.Index(*itr), i);
+  }
+  EXPECT_EQ(i, 0);
+}
+
+TEST(Komoperm, permutation_iterator_single_test) {
+  constexpr Permutations<Hoge, Hoge::kA, Hoge::kA> p;
+
+  auto itr = p.begin();
+  EXPECT_EQ((*itr)[0], Hoge::kA);
+  EXPECT_EQ((*itr)[1], Hoge::kA);
+  EXPECT_EQ(++itr, p.end());
+  EXPECT_EQ(--itr, p.begin());
+}
+
+TEST(Komoperm, minimal_change_combination_test) {
+  constexpr Choose<std::size_t, 10, 10> kChoose;
+
+  for (std::size_t n = 1; n <= 8; ++n) {
+    for (std::size_t z = 0; z <= n; ++z) {
+      Array<bool, 8> prev{};
+      MinimalChangeCombination(kChoose, n, z, std::size_t{0}, prev);
+      EXPECT_EQ(MinimalChangeCombinationRank(kChoose, n, z, prev), 0);
+
+      const std::size_t size = ChooseOrZero(kChoose, n, z);
+      for (std::size_t r = 1; r < size; ++r) {
+        Array<bool, 8> bits{};
+        MinimalChangeCombination(kChoose, n, z, r, bits);
+        EXPECT_EQ(MinimalChangeCombinationRank(kChoose, n, z, bits), r);
+
+        // Exactly one `true` moves across `false`s
+        std::size_t diff[2]{};
+        std::size_t cnt = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+          if (bits[i] != prev[i] && cnt++ < 2) {
+            diff[cnt - 1] = i;
+          }
+        }
+        ASSERT_EQ(cnt, 2) << "n=" << n << " z=" << z << " r=" << r;
+        for (std::size_t i = diff[0] + 1; i < diff[1]; ++i) {
+          EXPECT_FALSE(bits[i]) << "n=" << n << " z=" << z << " r=" << r;
+        }
+        prev = bits;
+      }
+    }
+  }
+}
+
+namespace {
+/// Check that `GrayBegin()` visits all permutations of `p` by single swaps
+template <typename P>
+void CheckGrayIterator(const P& p) {
+  std::vector<bool> visited(p.Size());
+  auto prev = p.GrayGet(0);
+  std::size_t i = 0;
+  for (auto itr = p.GrayBegin(); itr != p.GrayEnd(); ++itr, ++i) {
+    const auto& perm = *itr;
+    EXPECT_EQ(itr.Index(), i);
+    EXPECT_EQ(p.GrayIndex(perm), i);
+    EXPECT_EQ(p.GrayIndex(p.GrayGet(i)), i);
+
+    const std::size_t index = p.Index(perm);
+    EXPECT_FALSE(visited[index]);
+    visited[index] = true;
+
+    if (i > 0) {
+      const auto swapped = itr.Swapped();
+      EXPECT_NE(prev[swapped.first], prev[swapped.second]);
+      std::swap(prev[swapped.first], prev[swapped.second]);
+    }
+    for (std::size_t j = 0; j < p.Spaces(); ++j) {
+      EXPECT_EQ(prev[j], perm[j]) << "i=" << i << " j=" << j;
+    }
+  }
+  EXPECT_EQ(i, p.Size());
+}
+}  // namespace
+
+TEST(Komoperm, permutation_gray_test) {
+  constexpr Permutations<Hoge, Hoge::kA, Hoge::kA, Hoge::kA, Hoge::kB, Hoge::kB,
+                         Hoge::kC, Hoge::kD, Hoge::kD>
+      p;
+  CheckGrayIterator(p);
+  EXPECT_THROW(p.GrayGet(p.Size()), std::runtime_error);
+
+  CheckGrayIterator(Permutations<int, 0, 1, 1, 1, 1, 1, 1, 2, 2, 3>{});
+  CheckGrayIterator(Permutations<int, 0, 1, 2, 3, 4, 5, 6>{});
+  CheckGrayIterator(Permutations<int, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1>{});
+  CheckGrayIterator(Permutations<int, 0, 0, 0, 0, 1, 1, 1, 1>{});
+}
+
+TEST(Komoperm, permutation_lex_test) {
+  constexpr Permutations<int, 3, 1, 3, 0, 1, 3, 2> p;
+  static_assert(p.LexIndex(p.LexGet(123)) == 123, "");
+
+  std::vector<int> perm{0, 1, 1, 2, 3, 3, 3};
+  std::size_t i = 0;
+  do {
+    const auto lex = p.LexGet(i);
+    EXPECT_TRUE(std::equal(perm.begin(), perm.end(), lex.begin())) << i;
+    EXPECT_EQ(p.LexIndex(perm), i);
+    ++i;
+  } while (std::next_permutation(perm.begin(), perm.end()));
+  EXPECT_EQ(i, p.Size());
+
+  EXPECT_THROW(p.LexGet(p.Size()), std::runtime_error);
+  EXPECT_THROW(p.LexIndex({3, 3, 3, 3, 1, 1, 0}), std::runtime_error);
+
+  // (12! * 12) overflows std::uint32_t, which takes the other path.
+  constexpr PermutationsWithIndex<std::uint32_t, int, 7, 3, 11, 0, 5, 9, 1, 4,
+                                  10, 2, 8, 6>
+      q;
+  for (std::uint32_t j = 0; j + 1 < q.Size(); j += 999983) {
+    auto next = q.LexGet(j);
+    EXPECT_EQ(q.LexIndex(next), j);
+    std::next_permutation(next.begin(), next.end());
+    const auto expected = q.LexGet(j + 1);
+    EXPECT_TRUE(std::equal(next.begin(), next.end(), expected.begin())) << j;
+  }
+}
+
+template <typename Perms, typename Ranker>
+void CheckPrefixRanker(const Perms& p, Ranker& ranker, std::vector<int>& prefix,
+                       std::size_t& leaves) {
+  // All completions of `prefix` must be in [Low(), High()).
+  const std::size_t depth = prefix.size();
+  ASSERT_EQ(ranker.Depth(), depth);
+  if (ranker.Count() == 1 && depth < p.Spaces()) {
+    EXPECT_EQ(ranker.Low(), leaves);
+  }
+  if (depth == p.Spaces()) {
+    EXPECT_EQ(ranker.Low(), p.LexIndex(prefix));
+    EXPECT_EQ(ranker.High(), ranker.Low() + 1);
+    EXPECT_EQ(ranker.Low(), leaves);
+    ++leaves;
+    return;
+  }
+
+  const std::size_t first = leaves;
+  for (int val = -1; val <= 3; ++val) {
+    if (ranker.Remaining(val) == 0) {
+      EXPECT_FALSE(ranker.TryPush(val));
+      continue;
+    }
+    ranker.Push(val);
+    prefix.push_back(val);
+    CheckPrefixRanker(p, ranker, prefix, leaves);
+    prefix.pop_back();
+    ranker.Pop();
+  }
+  EXPECT_EQ(ranker.Low(), first);
+  EXPECT_EQ(ranker.High(), leaves);
+}
+
+TEST(Komoperm, prefix_ranker_test) {
+  constexpr Permutations<int, 3, 1, 3, 0, 1, 3, 2> p;
+  auto ranker = p.Ranker();
+  EXPECT_EQ(ranker.Low(), 0);
+  EXPECT_EQ(ranker.High(), p.Size());
+  EXPECT_EQ(ranker.Remaining(3), 3);
+  EXPECT_EQ(ranker.Remaining(4), 0);
+
+  std::vector<int> prefix;
+  std::size_t leaves = 0;
+  CheckPrefixRanker(p, ranker, prefix, leaves);
+  EXPECT_EQ(leaves, p.Size());
+  EXPECT_EQ(ranker.Depth(), 0);
+  EXPECT_THROW(ranker.Push(4), std::runtime_error);
+
+  // (12! * 12) overflows std::uint32_t, which takes the other path.
+  constexpr PermutationsWithIndex<std::uint32_t, int, 7, 3, 11, 0, 5, 9, 1, 4,
+                                  10, 2, 8, 6>
+      q;
+  for (std::uint32_t j = 0; j < q.Size(); j += 999983) {
+    const auto perm = q.LexGet(j);
+    auto r = q.Ranker();
+    for (auto v : perm) {
+      const std::uint32_t low = r.Low();
+      const std::uint32_t high = r.High();
+      r.Push(v);
+      EXPECT_LE(low, r.Low());
+      EXPECT_LE(r.High(), high);
+      EXPECT_LE(r.Low(), j);
+      EXPECT_LT(j, r.High());
+    }
+    EXPECT_EQ(r.Low(), j);
+  }
+}
+
+TEST(Komoperm, permutation_index_after_swap_test) {
+  constexpr Permutations<Hoge, Hoge::kA, Hoge::kA, Hoge::kB, Hoge::kC, Hoge::kC,
+                         Hoge::kD, Hoge::kA>
+      p;
+  static_assert(p.IndexAfterSwap(0, p.Get(0), 0, 6) == p.Index({
+                    Hoge::kD, Hoge::kA, Hoge::kA, Hoge::kB, Hoge::kC,
+                    Hoge::kC, Hoge::kA}),
+                "");
+
+  for (std::size_t index = 0; index < p.Size(); ++index) {
+    const auto perm = p.Get(index);
+    for (std::size_t i = 0; i < perm.size(); ++i) {
+      for (std::size_t j = 0; j < perm.size(); ++j) {
+        auto swapped = perm;
+        std::swap(swapped[i], swapped[j]);
+        EXPECT_EQ(p.IndexAfterSwap(index, perm, i, j), p.Index(swapped));
+
+        auto moved = perm;
+        if (i < j) {
+          std::rotate(moved.begin() + i, moved.begin() + i + 1,
+                      moved.begin() + j + 1);
+        } else {
+          std::rotate(moved.begin() + j, moved.begin() + i,
+                      moved.begin() + i + 1);
+        }
+        EXPECT_EQ(p.IndexAfterMove(index, perm, i, j), p.Index(moved))
+            << "index=" << index << " i=" << i << " j=" << j;
+      }
+    }
+  }
+
+  EXPECT_THROW(p.IndexAfterSwap(0, p.Get(0), 0, 7), std::runtime_error);
+  EXPECT_THROW(p.IndexAfterMove(0, p.Get(0), 7, 0), std::runtime_error);
+}
+
+TEST(Komoperm, permutation_index_type_test) {
+  constexpr PermutationsWithIndex<std::uint32_t, Hoge, Hoge::kA, Hoge::kA,
+                                  Hoge::kA, Hoge::kB, Hoge::kB, Hoge::kC>
+      p;
+  constexpr Permutations<Hoge, Hoge::kA, Hoge::kA, Hoge::kA, Hoge::kB, Hoge::kB,
+                         Hoge::kC>
+      p_ref;
+
+  ::testing::StaticAssertTypeEq<decltype(p.Size()), std::uint32_t>();
+  EXPECT_EQ(p.Size(), p_ref.Size());
+  for (std::uint32_t i = 0; i < p.Size(); ++i) {
+    EXPECT_EQ(p.Index(p.Get(i)), i);
+    EXPECT_EQ(p.Index(p_ref.Get(i)), i);
+  }
+
+  // More than a half of `UINT32_MAX` permutations are still representable.
+  constexpr PermutationsWithIndex<std::uint32_t, int, 0, 0, 0, 0, 0, 0, 1, 1,
+                                  1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2>
+      p_half;
+  static_assert(p_half.Size() == 2454021570U, "");
+  EXPECT_EQ(p_half.Index(p_half.Get(p_half.Size() - 1)), p_half.Size() - 1);
+}
+
+#ifdef __SIZEOF_INT128__
+TEST(Komoperm, permutation_index_type_128_test) {
+  __extension__ using Uint128 = unsigned __int128;
+  // 26! > 2^64
+  constexpr PermutationsWithIndex<Uint128, int, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9,
+                                  10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20,
+                                  21, 22, 23, 24, 25>
+      p;
+
+  Uint128 factorial = 1;
+  for (int i = 1; i <= 26; ++i) {
+    factorial *= i;
+  }
+  EXPECT_TRUE(p.Size() == factorial);
+  EXPECT_TRUE(p.Size() > std::numeric_limits<std::uint64_t>::max());
+
+  const Uint128 indices[] = {0, 1, factorial / 3, factorial / 2 + 12345,
+                             factorial - 1};
+  for (const auto index : indices) {
+    EXPECT_TRUE(p.Index(p.Get(index)) == index);
+  }
+
+  int descending[26]{};
+  for (int i = 0; i < 26; ++i) {
+    descending[i] = 25 - i;
+  }
+  EXPECT_TRUE(p.Index(descending) < p.Size());
+  EXPECT_TRUE(p.Index(p.Get(p.Index(descending))) == p.Index(descending));
+}
+#endif  // __SIZEOF_INT128__
+
+namespace {
+template <typename I, I D>
+void CheckConstantDivider() {
+  const I max = std::numeric_limits<I>::max();
+  const I numbers[] = {0,       1,       2,           D - 1,       D,
+                       D + 1,   2 * D,   3 * D - 1,   max,         max - 1,
+                       max / 2, max / D, max / D * D, max / 3 + 7, 1234567};
+  for (const auto n : numbers) {
+    EXPECT_TRUE((ConstantDivider<I, D>::Div(n)) == n / D);
+    EXPECT_TRUE((ConstantDivider<I, D>::Mod(n)) == n % D);
+  }
+
+  I x = 0x9E3779B9;
+  for (int i = 0; i < 1000; ++i) {
+    x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+    const I n = x ^ (x << 17) ^ (x >> 5);
+    EXPECT_TRUE((ConstantDivider<I, D>::Div(n)) == n / D);
+    EXPECT_TRUE((ConstantDivider<I, D>::Mod(n)) == n % D);
+  }
+}
+}  // namespace
+
+TEST(Komoperm, constant_divider_test) {
+  CheckConstantDivider<std::uint32_t, 1>();
+  CheckConstantDivider<std::uint32_t, 3>();
+  CheckConstantDivider<std::uint32_t, 7>();
+  CheckConstantDivider<std::uint32_t, 60>();
+  CheckConstantDivider<std::uint32_t, 64>();
+  CheckConstantDivider<std::uint32_t, 641>();
+  CheckConstantDivider<std::uint32_t, 0x80000001U>();
+  CheckConstantDivider<std::uint32_t, 0xFFFFFFFFU>();
+
+  CheckConstantDivider<std::uint64_t, 1>();
+  CheckConstantDivider<std::uint64_t, 3>();
+  CheckConstantDivider<std::uint64_t, 7>();
+  CheckConstantDivider<std::uint64_t, 1680>();
+  CheckConstantDivider<std::uint64_t, 1ULL << 40>();
+  CheckConstantDivider<std::uint64_t, 274177>();
+  CheckConstantDivider<std::uint64_t, 0x8000000000000001ULL>();
+  CheckConstantDivider<std::uint64_t, 0xFFFFFFFFFFFFFFFFULL>();
+
+#ifdef __SIZEOF_INT128__
+  __extension__ using Uint128 = unsigned __int128;
+  CheckConstantDivider<Uint128, 3>();
+  CheckConstantDivider<Uint128, 1680>();
+  CheckConstantDivider<Uint128, static_cast<Uint128>(1) << 100>();
+  CheckConstantDivider<Uint128, (static_cast<Uint128>(12345) << 64) + 789>();
+  CheckConstantDivider<Uint128, ~static_cast<Uint128>(0)>();
+#endif  // __SIZEOF_INT128__
+}
+
+TEST(Komoperm, permutation_padded_test) {
+  constexpr Permutations<Hoge, Hoge::kA, Hoge::kA, Hoge::kA, Hoge::kB, Hoge::kB,
+                         Hoge::kC>
+      p;
+
+  // (6 choose 3) = 20 -> 5 bits, (3 choose 2) = 3 -> 2 bits
+  EXPECT_EQ(p.PaddedBits(), 7);
+  EXPECT_EQ(p.PaddedSize(), 128);
+
+  std::size_t valid = 0;
+  for (std::size_t i = 0; i < p.PaddedSize(); ++i) {
+    try {
+      const auto perm = p.PaddedGet(i);
+      EXPECT_EQ(p.PaddedIndex(perm), i);
+      valid++;
+    } catch (const std::runtime_error&) {
+      EXPECT_TRUE((i & 0x1f) >= 20 || (i >> 5) >= 3) << "i=" << i;
+    }
+  }
+  EXPECT_EQ(valid, p.Size());
+
+  for (std::size_t i = 0; i < p.Size(); ++i) {
+    const auto perm = p.Get(i);
+    const auto padded = p.PaddedGet(p.PaddedIndex(perm));
+    for (std::size_t j = 0; j < 6; ++j) {
+      EXPECT_EQ(padded[j], perm[j]) << "i=" << i << " j=" << j;
+    }
+  }
+  EXPECT_THROW(p.PaddedGet(p.PaddedSize()), std::runtime_error);
+}
+
+TEST(Komoperm, packed_layout_test) {
+  using L = PackedLayout<4>;
+  EXPECT_EQ(L::SlotsPerWord(), 16);
+  EXPECT_EQ(L::Words(17), 2);
+  EXPECT_EQ(L::EqualSlots(0x0030'3f03ULL, 3), 0b10'1001);
+  EXPECT_EQ(L::Fill(0b101, 7), 0x707);
+
+  EXPECT_EQ(ParallelExtract(0b1011'0110, 0b1111'0000), 0b1011);
+  EXPECT_EQ(ParallelDeposit(0b1011, 0b1111'0000), 0b1011'0000);
+  EXPECT_EQ(ParallelDeposit(0b11, 0b1000'1000'0000), 0b1000'1000'0000);
+}
+
+TEST(Komoperm, permutation_packed_test) {
+  // 20 slots. 2 words in 4 bits, and 1 word in 3 bits
+  constexpr Permutations<int, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 7, 7, 0,
+                         5, 5, 5>
+      p;
+  static_assert(decltype(p)::PackedWords<4>() == 2, "");
+  static_assert(decltype(p)::PackedWords<3>() == 1, "");
+  static_assert(p.IndexPacked<3>(p.GetPacked<3>(12345)) == 12345, "");
+
+  for (std::size_t i = 0; i < p.Size(); i += 7) {
+    const auto perm = p.Get(i);
+    std::uint64_t words4[2]{};
+    std::uint64_t word3 = 0;
+    for (std::size_t j = 0; j < perm.size(); ++j) {
+      const auto v = static_cast<std::uint64_t>(perm[j]);
+      words4[j / 16] |= v << (j % 16 * 4);
+      word3 |= v << (j * 3);
+    }
+
+    std::uint64_t out4[2]{};
+    p.GetPacked<4>(i, out4);
+    EXPECT_EQ(out4[0], words4[0]);
+    EXPECT_EQ(out4[1], words4[1]);
+    EXPECT_EQ(p.GetPacked<3>(i), word3);
+    EXPECT_EQ(p.IndexPacked<4>(words4), i);
+    EXPECT_EQ(p.IndexPacked<3>(word3), i);
+    // The unused bits are ignored.
+    EXPECT_EQ(p.IndexPacked<3>(word3 | (1ULL << 63)), i);
+  }
+
+  EXPECT_THROW(p.IndexPacked<3>(0), std::runtime_error);
+  EXPECT_THROW(p.GetPacked<3>(p.Size()), std::runtime_error);
+}
+
+TEST(Komoperm, mask_combination_index_test) {
+  const auto& choose = SharedChoose<std::size_t>::kTable;
+  for (std::size_t n = 1; n <= 10; ++n) {
+    for (std::size_t c = 0; c <= n; ++c) {
+      const std::size_t size = choose.Get(n, c);
+      for (std::uint64_t mask = 0; mask < (1ULL << n); ++mask) {
+        if (PopCount(mask) != c) {
+          continue;
+        }
+        int buffer[10]{};
+        for (std::size_t i = 0; i < n; ++i) {
+          buffer[i] = (mask >> i) & 1 ? 0 : 1;
+        }
+        const auto index = MaskCombinationIndex(choose, n, c, size, mask);
+        EXPECT_EQ(index,
+                  CombinationIndex<std::size_t>(choose, 0, n, c, buffer));
+        EXPECT_EQ(MaskCombinationGet(choose, n, c, index), mask);
+      }
+    }
+  }
+}
@@ -0,0 +1,144 @@
+#include "komoperm/parallel.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+using namespace komoperm;
+
+namespace {
+enum class Fuga {
+  kA,
+  kB,
+  kC,
+};
+
+using FugaPermutations =
+    Permutations<Fuga, Fuga::kA, Fuga::kA, Fuga::kA, Fuga::kB, Fuga::kB,
+                 Fuga::kC, Fuga::kC>;
+}  // namespace
+
+TEST(Parallel, permutation_at_test) {
+  constexpr FugaPermutations p;
+
+  for (std::size_t i = 0; i < p.Size(); i += 7) {
+    std::size_t j = i;
+    for (auto itr = p.At(i); itr != p.end(); ++itr, ++j) {
+      EXPECT_EQ(p.Index(*itr), j);
+    }
+    EXPECT_EQ(j, p.Size());
+  }
+  EXPECT_EQ(p.At(p.Size()), p.end());
+  EXPECT_EQ(p.Index(*--p.At(p.Size())), p.Size() - 1);
+}
+
+TEST(Parallel, permutation_split_test) {
+  constexpr FugaPermutations p;
+
+  std::size_t next = 0;
+  for (std::size_t i = 0; i < 11; ++i) {
+    const auto range = p.Split(11, i);
+    EXPECT_EQ(range.begin().Index(), next);
+    for (const auto& perm : range) {
+      EXPECT_EQ(p.Index(perm), next++);
+    }
+  }
+  EXPECT_EQ(next, p.Size());
+
+  EXPECT_TRUE(p.Slice(3, 3).empty());
+  EXPECT_EQ(p.Slice(3, 8).size(), 5);
+  EXPECT_THROW(p.Slice(0, p.Size() + 1), std::runtime_error);
+  EXPECT_THROW(p.Split(0, 0), std::runtime_error);
+}
+
+TEST(Parallel, for_each_parallel_test) {
+  constexpr FugaPermutations p;
+
+  std::vector<std::atomic<int>> visited(p.Size());
+  ForEachParallel(
+      p, 1, p.Size(),
+      [&](std::size_t index, const auto& perm) {
+        EXPECT_EQ(p.Index(perm), index);
+        visited[index]++;
+      },
+      4, 3);
+
+  EXPECT_EQ(visited[0], 0);
+  for (std::size_t i = 1; i < p.Size(); ++i) {
+    EXPECT_EQ(visited[i], 1) << "i=" << i;
+  }
+}
+
+TEST(Parallel, for_each_parallel_chunk_size_test) {
+  EXPECT_EQ(detail::MinChunkSize<std::size_t>(1000, 4), 1);
+  EXPECT_EQ(detail::MinChunkSize<std::size_t>(SIZE_MAX, 4), 2);
+
+  // The chunk counter does not wrap around even if the index type is wider.
+  __extension__ using Uint128 = unsigned __int128;
+  const Uint128 range = Uint128{1} << 70;
+  const Uint128 min_chunk = detail::MinChunkSize<Uint128>(range, 4);
+  EXPECT_TRUE(min_chunk == 65);
+  EXPECT_TRUE((range + min_chunk - 1) / min_chunk <= SIZE_MAX - 4);
+
+  using Wide = PermutationsWithIndex<Uint128, Fuga, Fuga::kA, Fuga::kA,
+                                     Fuga::kB, Fuga::kC, Fuga::kC>;
+  constexpr Wide p;
+  std::vector<std::atomic<int>> visited(static_cast<std::size_t>(p.Size()));
+  ForEachParallel(
+      p, 0, p.Size(),
+      [&](Uint128 index, const auto&) {
+        visited[static_cast<std::size_t>(index)]++;
+      },
+      4, 1);
+  for (const auto& v : visited) {
+    EXPECT_EQ(v, 1);
+  }
+}
+
+TEST(Parallel, for_each_parallel_exception_test) {
+  constexpr FugaPermutations p;
+
+  EXPECT_THROW(ForEachParallel(p, 0, p.Size(),
+                               [](std::size_t index, const auto&) {
+                                 if (index == 100) {
+                                   throw std::runtime_error("error");
+                                 }
+                               }),
+               std::runtime_error);
+  EXPECT_THROW(ForEachParallel(p, 0, p.Size() + 1,
+                               [](std::size_t, const auto&) {}),
+               std::runtime_error);
+}
+
+TEST(Parallel, build_table_test) {
+  // 12600 permutations, i.e. several chunks of 1024 values
+  constexpr Permutations<int, 0, 0, 0, 0, 1, 1, 1, 2, 2, 3> p;
+  static_assert(TableChunkGranularity<std::uint32_t>() == 1024, "");
+  static_assert(TableChunkGranularity<char[3]>() == 4096, "");
+  static_assert(TableChunkGranularity<char[8192]>() == 1, "");
+
+  for (const std::size_t chunk_size : {0, 1, 5000}) {
+    std::vector<std::uint32_t> table(p.Size());
+    BuildTableOptions options;
+    options.num_threads = 4;
+    options.chunk_size = chunk_size;
+    BuildTable(
+        p,
+        [&](const auto& perm) {
+          return static_cast<std::uint32_t>(p.Index(perm) * 3);
+        },
+        table.data(), table.size(), options);
+    for (std::size_t i = 0; i < p.Size(); ++i) {
+      EXPECT_EQ(table[i], i * 3) << "i=" << i;
+    }
+  }
+
+  std::vector<int> small(p.Size() - 1);
+  EXPECT_THROW(BuildTable(
+                   p, [](const auto&) { return 0; }, small.data(),
+                   small.size()),
+               std::runtime_error);
+}
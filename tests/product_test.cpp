@@ -0,0 +1,91 @@
+#include "komoperm/product.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+using namespace komoperm;
+
+namespace {
+using Board = Permutations<int, 0, 0, 0, 1, 1, 2>;
+using Hand = Permutations<int, 0, 0, 1>;
+using Turn = Permutations<std::uint8_t, 0, 1>;
+using State = ProductPermutations<Board, Hand, Turn>;
+}  // namespace
+
+TEST(Product, index_test) {
+  constexpr State p;
+  static_assert(State::Components() == 3, "");
+  static_assert(p.Size() == Board{}.Size() * Hand{}.Size() * Turn{}.Size(),
+                "");
+  static_assert(p.Index({0, 0, 0, 1, 1, 2}, {0, 0, 1}, {0, 1}) == 0, "");
+
+  constexpr Board board;
+  constexpr Hand hand;
+  constexpr Turn turn;
+  for (std::size_t i = 0; i < p.Size(); ++i) {
+    const auto state = p.Get(i);
+    const std::size_t b = i % board.Size();
+    const std::size_t h = i / board.Size() % hand.Size();
+    const std::size_t t = i / board.Size() / hand.Size();
+    EXPECT_EQ(board.Index(std::get<0>(state)), b);
+    EXPECT_EQ(hand.Index(std::get<1>(state)), h);
+    EXPECT_EQ(turn.Index(std::get<2>(state)), t);
+
+    EXPECT_EQ(p.Index(state), i);
+    EXPECT_EQ(p.Index(board.Get(b), hand.Get(h), turn.Get(t)), i);
+  }
+
+  const std::vector<int> v{0, 1, 0, 2, 0, 1};
+  EXPECT_EQ(p.Index(v, std::vector<int>{1, 0, 0}, turn.Get(1)),
+            board.Index(v) + board.Size() * (2 + hand.Size()));
+  EXPECT_THROW(p.Get(p.Size()), std::runtime_error);
+  EXPECT_THROW(p.Index({0, 0, 0, 1, 1, 1}, {0, 0, 1}, {0, 1}),
+               std::runtime_error);
+}
+
+TEST(Product, iterator_test) {
+  constexpr State p;
+  std::size_t i = 0;
+  for (const auto& state : p) {
+    EXPECT_EQ(p.Index(state), i);
+    ++i;
+  }
+  EXPECT_EQ(i, p.Size());
+}
+
+TEST(Product, batch_test) {
+  constexpr State p;
+  std::vector<std::size_t> indices;
+  for (std::size_t i = 0; i < p.Size(); i += 3) {
+    indices.push_back(p.Size() - 1 - i);
+  }
+
+  const std::size_t count = indices.size();
+  std::vector<int> boards(count * 6);
+  std::vector<int> hands(count * 3);
+  std::vector<std::uint8_t> turns(count * 2);
+  p.GetBatch(indices.data(), count, boards.data(), hands.data(), turns.data());
+  for (std::size_t r = 0; r < count; ++r) {
+    const auto state = p.Get(indices[r]);
+    EXPECT_TRUE(std::equal(std::get<0>(state).begin(), std::get<0>(state).end(),
+                           boards.begin() + r * 6));
+    EXPECT_TRUE(std::equal(std::get<1>(state).begin(), std::get<1>(state).end(),
+                           hands.begin() + r * 3));
+    EXPECT_TRUE(std::equal(std::get<2>(state).begin(), std::get<2>(state).end(),
+                           turns.begin() + r * 2));
+  }
+
+  std::vector<std::size_t> out(count);
+  p.IndexBatch(boards.data(), hands.data(), turns.data(), count, out.data());
+  EXPECT_EQ(out, indices);
+
+  const std::size_t bad = p.Size();
+  EXPECT_THROW(
+      p.GetBatch(&bad, 1, boards.data(), hands.data(), turns.data()),
+      std::runtime_error);
+}
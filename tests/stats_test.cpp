@@ -0,0 +1,104 @@
+// This test is built with `KOMOPERM_ENABLE_STATS` in its own target, because
+// the macro must be consistent in all translation units.
+#ifndef KOMOPERM_ENABLE_STATS
+#define KOMOPERM_ENABLE_STATS
+#endif
+
+#include "komoperm/komoperm.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace komoperm;
+
+namespace {
+using Perm = Permutations<int, 0, 0, 1, 1, 2>;
+}  // namespace
+
+TEST(Stats, call_test) {
+  constexpr Perm p;
+  // The hooks are skipped in constant evaluations.
+  static_assert(p.Index({0, 0, 1, 1, 2}) == 0, "");
+  static_assert(p.Get(0)[4] == 2, "");
+
+  Perm::Counters() = {};
+  EXPECT_EQ(p.Index({2, 1, 1, 0, 0}), p.Size() - 1);
+  EXPECT_EQ(p.IndexUnchecked({0, 0, 1, 1, 2}), 0);
+  EXPECT_FALSE(p.TryIndex({0, 0, 0, 1, 2}).ok());
+  EXPECT_FALSE(p.TryIndex(std::vector<int>{0, 0, 1, 1}).ok());
+  EXPECT_THROW(p.Index({0, 0, 1, 1, 3}), std::runtime_error);
+
+  EXPECT_EQ(p.Get(1)[4], 2);
+  EXPECT_TRUE(p.TryGet(2).ok());
+  EXPECT_FALSE(p.TryGet(p.Size()).ok());
+  EXPECT_THROW(p.Get(p.Size()), std::runtime_error);
+
+  const Stats<3> stats = Perm::Counters();
+  EXPECT_EQ(stats.index_calls, 5);
+  EXPECT_EQ(stats.index_failures, 3);
+  EXPECT_EQ(stats.get_calls, 4);
+  EXPECT_EQ(stats.get_failures, 2);
+
+  // The counters are per thread.
+  std::thread([] { EXPECT_EQ(Perm::Counters().index_calls, 0); }).join();
+
+  Perm::Counters() = {};
+  EXPECT_EQ(Perm::Counters().index_calls, 0);
+  EXPECT_EQ(Perm::Counters().levels[0].iterations, 0);
+}
+
+TEST(Stats, level_test) {
+  constexpr Perm p;
+  std::vector<decltype(p.Get(0))> perms;
+  Perm::Counters() = {};
+  for (std::size_t i = 0; i < p.Size(); ++i) {
+    perms.push_back(p.Get(i));
+  }
+  const Stats<3> get_stats = Perm::Counters();
+
+  Perm::Counters() = {};
+  for (std::size_t i = 0; i < p.Size(); ++i) {
+    EXPECT_EQ(p.Index(perms[i]), i);
+  }
+  const Stats<3> index_stats = Perm::Counters();
+
+  EXPECT_GT(index_stats.levels[0].iterations, 0);
+  EXPECT_GT(index_stats.levels[0].lookups, 0);
+  EXPECT_GT(get_stats.levels[0].iterations, 0);
+  for (std::size_t k = 0; k < 3; ++k) {
+    EXPECT_LE(index_stats.levels[k].lookups, index_stats.levels[k].iterations);
+    EXPECT_LE(get_stats.levels[k].lookups, get_stats.levels[k].iterations);
+  }
+
+  const std::uint64_t size = p.Size();
+  if (!p.UseMaskBackend() && !p.UseSimdIndex()) {
+    // `Index()` scans the 5 and 3 slots left by the previous levels.
+    EXPECT_EQ(index_stats.levels[0].iterations, size * 5);
+    EXPECT_EQ(index_stats.levels[1].iterations, size * 3);
+  }
+  // `Get()` stops at the last placed slot.
+  EXPECT_LE(get_stats.levels[0].iterations, size * 5);
+
+  // The last level is skipped by `Index()`, and `Get()` fills the remaining
+  // slot without scanning.
+  EXPECT_EQ(index_stats.levels[2].iterations, 0);
+  EXPECT_EQ(index_stats.levels[2].lookups, 0);
+  EXPECT_EQ(get_stats.levels[2].iterations, 0);
+  EXPECT_EQ(get_stats.levels[2].lookups, 0);
+}
+
+TEST(Stats, last_level_test) {
+  // The blank is the last level, which owns 8 of 11 slots.
+  using Board = Permutations<int, 1, 2, 3, 0, 0, 0, 0, 0, 0, 0, 0>;
+  constexpr Board p;
+  Board::Counters() = {};
+  for (std::size_t i = 0; i < p.Size(); ++i) {
+    EXPECT_EQ(p.Index(p.Get(i)), i);
+  }
+  EXPECT_EQ(Board::Counters().levels[3].iterations, 0);
+  EXPECT_EQ(Board::Counters().levels[3].lookups, 0);
+}
@@ -0,0 +1,105 @@
+#include "komoperm/symmetry.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+using namespace komoperm;
+
+TEST(Symmetry, reversal_test) {
+  constexpr Permutations<int, 0, 0, 1, 1, 2> p;
+  using Symmetric = SymmetricPermutations<decltype(p)>;
+  const Symmetric s(p, {Symmetric::Reversal()});
+
+  // (30 + 2 palindromes) / 2
+  EXPECT_EQ(s.GroupSize(), 2);
+  EXPECT_EQ(s.Size(), 16);
+
+  std::vector<std::size_t> hits(s.Size());
+  for (const auto& perm : p) {
+    const auto canonical = s.Index(perm);
+    ASSERT_LT(canonical.index, s.Size());
+    const auto rep = s.Get(canonical.index);
+    const auto image = s.Apply(canonical.transform, perm);
+    EXPECT_TRUE(std::equal(rep.begin(), rep.end(), image.begin()));
+    EXPECT_LE(s.RepresentativeIndex(canonical.index), p.Index(perm));
+
+    const auto reversed = s.Apply(1, perm);
+    EXPECT_EQ(s.Index(reversed).index, canonical.index);
+    hits[canonical.index]++;
+  }
+  for (auto hit : hits) {
+    EXPECT_TRUE(hit == 1 || hit == 2);
+  }
+
+  const auto canonical = s.Index({2, 1, 1, 0, 0});
+  EXPECT_EQ(canonical.index, 0);
+  EXPECT_EQ(canonical.transform, 1);
+  EXPECT_EQ(s.Index({0, 0, 1, 1, 2}).transform, 0);
+}
+
+TEST(Symmetry, rotation_test) {
+  constexpr Permutations<int, 0, 0, 0, 1, 1, 1> p;
+  using Symmetric = SymmetricPermutations<decltype(p)>;
+
+  // Necklaces and bracelets of 3 black and 3 white beads
+  const Symmetric necklaces(p, {Symmetric::Rotation(1)});
+  EXPECT_EQ(necklaces.GroupSize(), 6);
+  EXPECT_EQ(necklaces.Size(), 4);
+
+  const Symmetric bracelets(p, {Symmetric::Rotation(1), Symmetric::Reversal()});
+  EXPECT_EQ(bracelets.GroupSize(), 12);
+  EXPECT_EQ(bracelets.Size(), 3);
+
+  for (std::size_t i = 0; i < bracelets.Size(); ++i) {
+    EXPECT_EQ(bracelets.Index(bracelets[i]).index, i);
+    EXPECT_EQ(bracelets.Index(bracelets[i]).transform, 0);
+  }
+}
+
+TEST(Symmetry, dense_index_test) {
+  // Several blocks of the ranks
+  constexpr Permutations<int, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2> p;
+  using Symmetric = SymmetricPermutations<decltype(p)>;
+  const Symmetric s(p, {Symmetric::Reversal()});
+
+  std::vector<std::size_t> expected;
+  for (const auto& perm : p) {
+    const auto index = p.Index(perm);
+    if (index <= p.Index(s.Apply(1, perm))) {
+      expected.push_back(index);
+    }
+  }
+  ASSERT_EQ(s.Size(), expected.size());
+  for (std::size_t i = 0; i < s.Size(); ++i) {
+    EXPECT_EQ(s.RepresentativeIndex(i), expected[i]) << "i=" << i;
+    EXPECT_EQ(s.Index(s.Get(i)).index, i);
+  }
+  for (const auto& perm : p) {
+    const auto canonical = s.Index(perm);
+    EXPECT_EQ(s.RepresentativeIndex(canonical.index),
+              std::min(p.Index(perm), p.Index(s.Apply(1, perm))));
+  }
+}
+
+TEST(Symmetry, illegal_test) {
+  constexpr Permutations<int, 0, 0, 1, 2> p;
+  using Symmetric = SymmetricPermutations<decltype(p)>;
+  EXPECT_THROW(Symmetric(p, {{0, 0, 1, 2}}), std::runtime_error);
+
+  const Symmetric s(p, {});
+  EXPECT_EQ(s.GroupSize(), 1);
+  EXPECT_EQ(s.Size(), p.Size());
+  EXPECT_THROW(s.Index({0, 1, 1, 2}), std::runtime_error);
+  EXPECT_THROW(s.Get(s.Size()), std::runtime_error);
+  EXPECT_THROW(s.Apply(1, p.Get(0)), std::runtime_error);
+
+  // 14! permutations are too many to enumerate.
+  constexpr Permutations<int, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13>
+      p_large;
+  using Large = SymmetricPermutations<decltype(p_large)>;
+  static_assert(p_large.Size() > Large::kMaxSize, "");
+  EXPECT_THROW(Large(p_large, {Large::Reversal()}), std::runtime_error);
+}
@@ -0,0 +1,141 @@
+#include "komoperm/table.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+using namespace komoperm;
+
+namespace {
+using Perms = Permutations<int, 0, 0, 1, 1, 1, 2>;
+
+std::string TablePath(const char* name) {
+  return ::testing::TempDir() + name;
+}
+
+/// Write `index * 3` for each index
+void WriteTable(const std::string& path) {
+  constexpr Perms p;
+  TableWriter<Perms, std::uint32_t> writer(path, 7);
+  for (std::uint32_t i = 0; i < p.Size(); ++i) {
+    EXPECT_EQ(writer.Written(), i);
+    writer.Push(i * 3);
+  }
+  EXPECT_THROW(writer.Push(0), std::runtime_error);
+  writer.Close();
+}
+}  // namespace
+
+TEST(Table, write_and_read) {
+  const auto path = TablePath("komoperm_table_test.bin");
+  WriteTable(path);
+
+  constexpr Perms p;
+  const TableReader<Perms, std::uint32_t> table(path);
+  ASSERT_EQ(table.Size(), p.Size());
+  for (const auto& perm : p) {
+    EXPECT_EQ(table[perm], p.Index(perm) * 3);
+  }
+  EXPECT_EQ(table.At(5), 15);
+  EXPECT_EQ((table[{2, 1, 1, 1, 0, 0}]), table.At(p.Index({2, 1, 1, 1, 0, 0})));
+  EXPECT_THROW(table.At(p.Size()), std::runtime_error);
+  EXPECT_THROW((table[{0, 0, 0, 1, 1, 2}]), std::runtime_error);
+
+  // The values start at a page boundary.
+  EXPECT_EQ(reinterpret_cast<std::uintptr_t>(table.data()) % kTablePageBytes,
+            0);
+
+  auto moved = TableReader<Perms, std::uint32_t>(path);
+  EXPECT_EQ(moved.data()[10], 30);
+  std::remove(path.c_str());
+}
+
+TEST(Table, wide_index_type) {
+  __extension__ using Uint128 = unsigned __int128;
+  using Wide = PermutationsWithIndex<Uint128, int, 0, 0, 1, 1, 1, 2>;
+  // 21! > 2^64, so the table of `Large` is rejected at compile time.
+  using Large = PermutationsWithIndex<Uint128, int, 0, 1, 2, 3, 4, 5, 6, 7, 8,
+                                      9, 10, 11, 12, 13, 14, 15, 16, 17, 18,
+                                      19, 20>;
+  static_assert(detail::IsTableSizeRepresentable<Wide>(), "");
+  static_assert(!detail::IsTableSizeRepresentable<Large>(), "");
+
+  const auto path = TablePath("komoperm_table_wide_test.bin");
+  constexpr Wide p;
+  {
+    TableWriter<Wide, std::uint32_t> writer(path);
+    for (std::uint32_t i = 0; i < p.Size(); ++i) {
+      writer.Push(i * 3);
+    }
+    writer.Close();
+  }
+
+  const TableReader<Wide, std::uint32_t> table(path);
+  EXPECT_TRUE(table.Size() == p.Size());
+  EXPECT_EQ(table.At(5), 15);
+  EXPECT_EQ((table[{2, 1, 1, 1, 0, 0}]), p.Index({2, 1, 1, 1, 0, 0}) * 3);
+  std::remove(path.c_str());
+}
+
+TEST(Table, mismatch) {
+  const auto path = TablePath("komoperm_table_mismatch_test.bin");
+  WriteTable(path);
+
+  // The same multiset in a different index order
+  using Other = Permutations<int, 1, 1, 1, 0, 0, 2>;
+  EXPECT_THROW((TableReader<Other, std::uint32_t>(path)), std::runtime_error);
+  EXPECT_THROW((TableReader<Perms, std::uint16_t>(path)), std::runtime_error);
+  EXPECT_THROW((TableReader<Perms, std::int32_t>(TablePath("no_such_file"))),
+               std::system_error);
+  std::remove(path.c_str());
+}
+
+TEST(Table, incomplete) {
+  const auto path = TablePath("komoperm_table_incomplete_test.bin");
+  {
+    TableWriter<Perms, std::uint32_t> writer(path);
+    writer.Push(0);
+    EXPECT_THROW(writer.Close(), std::runtime_error);
+  }
+  EXPECT_THROW((TableReader<Perms, std::uint32_t>(path)), std::runtime_error);
+
+  {
+    // Destroyed without `Close()`
+    TableWriter<Perms, std::uint32_t> writer(path);
+    writer.Push(0);
+  }
+  EXPECT_THROW((TableReader<Perms, std::uint32_t>(path)), std::runtime_error);
+  std::remove(path.c_str());
+}
+
+TEST(Table, build_table_file) {
+  const auto path = TablePath("komoperm_table_build_test.bin");
+  constexpr Perms p;
+  BuildTableOptions options;
+  options.num_threads = 3;
+  BuildTableFile<std::uint32_t>(
+      p, [&](const auto& perm) { return p.Index(perm) * 3; }, path, options);
+
+  const TableReader<Perms, std::uint32_t> table(path);
+  // Each chunk of `BuildTable()` covers whole pages of the mapping.
+  EXPECT_EQ(reinterpret_cast<std::uintptr_t>(table.data()) % kTablePageBytes,
+            0);
+  for (std::size_t i = 0; i < p.Size(); ++i) {
+    EXPECT_EQ(table.At(i), i * 3);
+  }
+
+  // The header is not written if `fn` throws.
+  EXPECT_THROW(BuildTableFile<std::uint32_t>(
+                   p,
+                   [](const auto&) -> std::uint32_t {
+                     throw std::runtime_error("error");
+                   },
+                   path),
+               std::runtime_error);
+  EXPECT_THROW((TableReader<Perms, std::uint32_t>(path)), std::runtime_error);
+  std::remove(path.c_str());
+}
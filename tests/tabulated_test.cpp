@@ -0,0 +1,60 @@
+#include "komoperm/tabulated.hpp"
+
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+using namespace komoperm;
+
+namespace {
+enum class Piyo {
+  kA,
+  kB,
+  kC,
+  kD,
+};
+}  // namespace
+
+TEST(Tabulated, same_as_permutations) {
+  constexpr TabulatedPermutations<Piyo, Piyo::kD, Piyo::kB, Piyo::kB, Piyo::kA,
+                                  Piyo::kD, Piyo::kC, Piyo::kA>
+      p;
+  constexpr Permutations<Piyo, Piyo::kD, Piyo::kB, Piyo::kB, Piyo::kA,
+                         Piyo::kD, Piyo::kC, Piyo::kA>
+      p_ref;
+  static_assert(p.Index(p.Get(123)) == 123, "");
+  static_assert(decltype(p)::RowBits() == 2, "");
+  ::testing::StaticAssertTypeEq<decltype(p)::Row, std::uint16_t>();
+
+  ASSERT_EQ(p.Size(), p_ref.Size());
+  for (std::size_t i = 0; i < p.Size(); ++i) {
+    const auto perm = p.Get(i);
+    const auto perm_ref = p_ref.Get(i);
+    for (std::size_t j = 0; j < p.Spaces(); ++j) {
+      EXPECT_EQ(perm[j], perm_ref[j]) << "i=" << i << " j=" << j;
+    }
+    EXPECT_EQ(p.Index(perm_ref), i);
+    EXPECT_EQ(p.IndexRow(p.GetRow(i)), i);
+
+    // kA < kB < kC < kD
+    const auto row = p.GetRow(i);
+    for (std::size_t j = 0; j < p.Spaces(); ++j) {
+      EXPECT_EQ((row >> (2 * j)) & 3, static_cast<std::size_t>(perm[j]));
+    }
+  }
+}
+
+TEST(Tabulated, illegal) {
+  constexpr TabulatedPermutations<int, 0, 0, 1, 1, 2> p;
+  const auto perm = p.Get(10);
+  EXPECT_EQ(p.Index(perm), 10);
+  EXPECT_EQ(p.Index(std::vector<int>{0, 0, 1, 2, 1}), 10);
+
+  EXPECT_THROW(p.Get(p.Size()), std::runtime_error);
+  EXPECT_THROW(p.Index({0, 0, 1, 1, 1}), std::runtime_error);
+  EXPECT_THROW(p.Index({0, 0, 1, 1, 3}), std::runtime_error);
+  EXPECT_THROW(p.Index(std::vector<int>{0, 0, 1, 1}), std::runtime_error);
+  EXPECT_THROW(p.IndexRow(0), std::runtime_error);
+}